@@ -5,7 +5,7 @@
 //  ZhaodeWang
 //
 
-#include "llm.hpp"
+#include "vector_store.hpp"
 #include <fstream>
 #include <stdlib.h>
 
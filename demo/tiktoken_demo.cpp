@@ -0,0 +1,80 @@
+//
+//  tiktoken_demo.cpp
+//
+
+#include "tokenizer.hpp"
+#include <fstream>
+#include <sstream>
+
+static std::string unescape(const std::string& str) {
+    std::string out;
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] != '\\' || i + 1 == str.size()) {
+            out.push_back(str[i]);
+            continue;
+        }
+        char c = str[++i];
+        out.push_back(c == 't' ? '\t' : c == 'n' ? '\n' : c == 'r' ? '\r' : c);
+    }
+    return out;
+}
+
+static std::vector<int> parse_ids(const std::string& line) {
+    std::istringstream is(line);
+    std::vector<int> ids;
+    int id;
+    while (is >> id) {
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+// check the rank bpe of Tiktoken against the reference ids written by python/tiktoken_cases.py
+int main(int argc, const char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " ranks.txt cases.txt" << std::endl;
+        return 0;
+    }
+    Tiktoken qwen(Tiktoken::QWEN), gpt2(Tiktoken::GPT2);
+    if (!qwen.load(argv[1]) || !gpt2.load(argv[1])) {
+        std::cerr << "Error: load " << argv[1] << " failed" << std::endl;
+        return 1;
+    }
+    std::ifstream cases_file(argv[2]);
+    std::string line, ids_line;
+    int cases = 0, mismatches = 0;
+    while (std::getline(cases_file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || !std::getline(cases_file, ids_line)) {
+            std::cerr << "Error: invalid case: " << line << std::endl;
+            return 1;
+        }
+        std::string name = line.substr(0, tab);
+        if (name != "qwen" && name != "gpt2") {
+            std::cerr << "Error: unknown pattern " << name << std::endl;
+            return 1;
+        }
+        Tiktoken& tokenizer = name == "qwen" ? qwen : gpt2;
+        std::string text = unescape(line.substr(tab + 1));
+        auto expected = parse_ids(ids_line);
+        auto ids = tokenizer.encode(text);
+        cases++;
+        if (ids != expected || tokenizer.count(text) != expected.size()) {
+            mismatches++;
+            printf("%s mismatch: %s\n  expected:", name.c_str(), line.substr(tab + 1).c_str());
+            for (int id : expected) {
+                printf(" %d", id);
+            }
+            printf("\n  encoded: ");
+            for (int id : ids) {
+                printf(" %d", id);
+            }
+            printf("\n");
+        }
+    }
+    printf("%d cases, %d mismatches\n", cases, mismatches);
+    return mismatches > 0 || cases == 0;
+}
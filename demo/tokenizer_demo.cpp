@@ -0,0 +1,70 @@
+//
+//  tokenizer_demo.cpp
+//
+
+#include "tokenizer.hpp"
+#include <chrono>
+#include <cstring>
+
+static Tokenizer* create_tokenizer(const char* type) {
+    if (!strcmp(type, "sentencepiece")) {
+        return new Sentencepiece;
+    }
+    if (!strcmp(type, "unigram")) {
+        return new Sentencepiece(Sentencepiece::UNIGRAM);
+    }
+    if (!strcmp(type, "tiktoken")) {
+        return new Tiktoken;
+    }
+    if (!strcmp(type, "wordpiece")) {
+        return new WordPiece;
+    }
+    return nullptr;
+}
+
+static std::unique_ptr<Tokenizer> load_tokenizer(const char* type, const std::string& path) {
+    std::unique_ptr<Tokenizer> tokenizer(create_tokenizer(type));
+    auto st = std::chrono::steady_clock::now();
+    if (!tokenizer->load(path)) {
+        return nullptr;
+    }
+    auto et = std::chrono::steady_clock::now();
+    printf("load %s: %lld us\n", path.c_str(), (long long)std::chrono::duration_cast<std::chrono::microseconds>(et - st).count());
+    return tokenizer;
+}
+
+// convert text vocab to binary tokenizer, which is mapped by `Tokenizer::load` without parsing
+int main(int argc, const char* argv[]) {
+    if (argc < 3 || std::unique_ptr<Tokenizer>(create_tokenizer(argv[2])) == nullptr) {
+        std::cout << "Usage: " << argv[0] << " tokenizer.txt sentencepiece|unigram|tiktoken|wordpiece [tokenizer.mtok]" << std::endl;
+        return 0;
+    }
+    std::string txt_path = argv[1];
+    std::string bin_path;
+    if (argc > 3) {
+        bin_path = argv[3];
+    } else {
+        size_t pos = txt_path.find_last_of("/\\");
+        bin_path = (pos != std::string::npos ? txt_path.substr(0, pos + 1) : "") + "tokenizer.mtok";
+    }
+    auto text = load_tokenizer(argv[2], txt_path);
+    if (text == nullptr || !text->save(bin_path)) {
+        return 1;
+    }
+    auto binary = load_tokenizer(argv[2], bin_path);
+    if (binary == nullptr) {
+        return 1;
+    }
+    std::string prompt = "Hello world! 你好，世界。";
+    auto ids = text->encode(prompt);
+    if (binary->encode(prompt) != ids) {
+        std::cerr << "Error: binary tokenizer encode mismatch" << std::endl;
+        return 1;
+    }
+    printf("%s:", prompt.c_str());
+    for (int id : ids) {
+        printf(" %d", id);
+    }
+    printf("\nsave %s Done\n", bin_path.c_str());
+    return 0;
+}
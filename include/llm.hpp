@@ -21,6 +21,7 @@
 #include <MNN/expr/Module.hpp>
 #include <MNN/expr/MathOp.hpp>
 #include <MNN/expr/NeuralNetWorkOp.hpp>
+#include <MNN/expr/Executor.hpp>
 #include "tokenizer.hpp"
 
 using namespace MNN;
@@ -46,86 +47,207 @@ private:
     CallBack callback_ = nullptr;
 };
 
-class Llm {
+// LlmConfig: options of `LlmModel::load`
+struct LlmConfig {
+    // runtime cache dir, empty is disable
+    std::string cache_dir = "";
+    // disk embedding file "int4", "int8" or "bf16", "auto" is the smallest one present
+    std::string disk_embed_format = "auto";
+    // bytes of prompt parts kept in the encode cache shared by sessions; 0 is disable
+    size_t encode_cache_bytes = 4 << 20;
+};
+
+class LlmSession;
+
+// LlmModel: prompt template, masks and position ids of a model family, with the runtime, modules
+// and tokenizer loaded by `load`. It is read only after `load`, so every LlmSession of it shares
+// one copy of the weights; the state of a conversation is passed in by the session.
+class LlmModel {
 public:
-    Llm() {
+    // disk embedding file formats, each row is `hidden_size_` values
+    enum DiskEmbedType {
+        // bf16 values
+        BF16 = 0,
+        // fp32 row scale + int8 values
+        INT8 = 1,
+        // fp32 row scale + packed int4 values, low nibble first
+        INT4 = 2
+    };
+    LlmModel() {
         // default tokenier is senrencepiece
         tokenizer_.reset(new Sentencepiece);
     }
-    virtual ~Llm() {
+    virtual ~LlmModel() {
         modules_.clear();
         visual_module_.reset();
         runtime_manager_.reset();
     }
-    static Llm* createLLM(const std::string& path, std::string model_type = "auto");
-    void load(const std::string& model_dir);
-    void chat();
-    void warmup();
-    std::string response(const std::string& input_str, std::ostream* os = &std::cout, const char* end_with = nullptr);
-    float load_progress() { return load_progress_; }
-    void reset();
-    void print_speed();
-public:
-    std::vector<int> history_;
-    // forward info
-    int max_seq_len_ = 1024;
-    int prompt_len_ = 0;
-    int gen_seq_len_ = 0;
-    int all_seq_len_ = 0;
-    // time
-    int64_t prefill_us_ = 0;
-    int64_t decode_us_ = 0;
+    static LlmModel* create(const std::string& path, std::string model_type = "auto");
+    void load(const std::string& model_dir, const LlmConfig& llm_config = LlmConfig());
+    float load_progress() const { return load_progress_; }
+    const std::string& model_name() const { return model_name_; }
+    // tokens of `text` without the chat template, counted without keeping the ids
+    size_t token_count(const std::string& text) const;
+    // upper bound of `token_count` in one pass over the bytes, to reject or route long prompts first
+    size_t max_token_count(const std::string& text) const;
 protected:
-    VARP embedding(const std::vector<int>& input_ids);
-    VARP txt_embedding(const std::vector<int>& input_ids);
-    int forward(const std::vector<int>& input_ids);
-    std::vector<int> tokenizer_encode(const std::string& input_str);
-    std::string decode(int id);
+    std::vector<int> tokenizer_encode(const std::string& input_str) const;
+    // encode the concatenation of `segments`, template segments and repeated lines hit the encode cache
+    std::vector<int> tokenizer_encode(const std::vector<std::string_view>& segments) const;
+    virtual VARP gen_static_attention_mask(int valid_len, int capacity) const;
 protected:
     // model configs
     bool is_single_ = false;
     bool is_visual_ = false;
+    // causal attention, padding after the prompt is invisible to it
+    bool is_causal_ = true;
     int layer_nums_ = 0;
     int hidden_size_ = 4096;
     std::vector<int> key_value_shape_ = {};
     std::string model_name_ = "";
-    // gen info
+    std::string model_type_ = "";
+    // tokenizer, loaded by `load`
+    std::shared_ptr<Tokenizer> tokenizer_;
+private:
+    friend class LlmSession;
+    // embedding of a prompt with images, text parts are embedded by `txt_embedding`
+    virtual VARP visual_embedding(const std::vector<int>& input_ids, Module* visual_module,
+                                  const std::function<VARP(const std::vector<int>&)>& txt_embedding) const { return nullptr; }
+    virtual std::vector<int> tokenizer(const LlmSession& session, const std::string& query) const = 0;
+    virtual VARP gen_attention_mask(const LlmSession& session, int seq_len) const = 0;
+    virtual VARP gen_position_ids(const LlmSession& session, int seq_len) const = 0;
+    virtual bool is_stop(int token_id) const = 0;
+    // write the tuning and shapes planned on `runtime_manager_` to the runtime cache file
+    void update_cache() const;
+private:
+    std::string model_dir_;
     float load_progress_ = 0.f;
-    // tokenizer
-    std::unique_ptr<Tokenizer> tokenizer_;
+    // schedule config used to create runtime and session executors
+    MNNForwardType backend_type_ = MNN_FORWARD_CPU;
+    int thread_num_ = 4;
+    BackendConfig backend_config_;
+    // runtime of the loaded modules, so of the default session, clones run on their session executors
+    std::shared_ptr<Executor::RuntimeManager> runtime_manager_;
+    std::vector<std::shared_ptr<Module>> modules_;
     std::shared_ptr<Module> visual_module_;
+    // encoded prompt parts, shared by sessions
+    std::shared_ptr<EncodeCache> encode_cache_;
+    // disk embedding
+    DiskEmbedType disk_embed_type_ = BF16;
+    std::string disk_embed_path_ = "";
+    // runtime cache file
+    std::string cache_path_;
+};
+
+// LlmSession: one conversation (history, kv cache and stats) of a loaded LlmModel. It owns an
+// executor and module clones sharing the weights, so sessions of one model can run in different threads.
+// The default session of Llm forwards the model modules instead, so its warmup is saved to the runtime cache.
+class LlmSession {
+public:
+    LlmSession(std::shared_ptr<const LlmModel> model, bool clone_modules = true);
+    ~LlmSession();
+    void chat();
+    void warmup();
+    std::string response(const std::string& input_str, std::ostream* os = &std::cout, const char* end_with = nullptr);
+    void reset();
+    void print_speed();
+    size_t token_count(const std::string& text) const { return model_->token_count(text); }
+    size_t max_token_count(const std::string& text) const { return model_->max_token_count(text); }
+    const LlmModel* model() const { return model_.get(); }
+    // forward info
+    const std::vector<int>& history() const { return history_; }
+    int prompt_len() const { return prompt_len_; }
+    // ids of the last query with its template, without the history before it
+    int query_len() const { return query_len_; }
+    int gen_seq_len() const { return gen_seq_len_; }
+    int all_seq_len() const { return all_seq_len_; }
+    // time
+    int64_t prefill_us() const { return prefill_us_; }
+    int64_t decode_us() const { return decode_us_; }
+public:
+    int max_seq_len_ = 1024;
+    // prefill lengths and decode steps run by `warmup`
+    std::vector<int> warmup_prefill_lens_ = {1};
+    int warmup_decode_steps_ = 0;
+    // ascending prefill lengths, prompt is padded to the smallest bucket not less than it; empty is disable
+    std::vector<int> prefill_buckets_ = {};
+    // decode with kv preallocated to this capacity so every step has the same input shapes; 0 is disable
+    int static_kv_capacity_ = 0;
 private:
-    virtual VARP visual_embedding(const std::vector<int>& input_ids) { return nullptr; }
-    virtual std::vector<int> tokenizer(const std::string& query) = 0;
-    virtual VARP gen_attention_mask(int seq_len) = 0;
-    virtual VARP gen_position_ids(int seq_len) = 0;
-    virtual bool is_stop(int token_id) = 0;
+    VARP embedding(const std::vector<int>& input_ids);
+    VARP txt_embedding(const std::vector<int>& input_ids);
+    int forward(const std::vector<int>& input_ids);
+    int forward_padded(const std::vector<int>& input_ids, int real_len);
+    void init_past_key_values();
+    int prefill_bucket(int seq_len);
+    int kv_seq_axis() const;
+    void to_static_past_key_values();
+    void to_dynamic_past_key_values();
 private:
-    // MNN Modules
-    std::shared_ptr<Executor::RuntimeManager> runtime_manager_;
+    std::shared_ptr<const LlmModel> model_;
+    std::vector<int> history_;
+    int prompt_len_ = 0;
+    int query_len_ = 0;
+    int gen_seq_len_ = 0;
+    int all_seq_len_ = 0;
+    int64_t prefill_us_ = 0;
+    int64_t decode_us_ = 0;
+    // MNN Modules of this session, clones of the model modules unless `clone_modules_` is false
+    bool clone_modules_ = true;
+    std::shared_ptr<Executor> executor_;
     std::vector<std::shared_ptr<Module>> modules_;
+    std::shared_ptr<Module> visual_module_;
     std::vector<VARP> past_key_values_;
-    // model dir
-    std::string model_dir_;
+    // past_key_values_ is preallocated to static_kv_capacity_
+    bool is_static_kv_ = false;
+};
+
+// Llm: a model with one default session, for a single conversation
+class Llm {
+public:
+    static Llm* createLLM(const std::string& path, std::string model_type = "auto");
+    void load(const std::string& model_dir);
+    // new conversation sharing the loaded model with the configs of the default session, it can run in another thread
+    LlmSession* create_session() const;
+    std::shared_ptr<const LlmModel> model() const { return model_; }
+    // default session, created by `load`
+    LlmSession* session() { return session_.get(); }
+    void chat() { session_->chat(); }
+    void warmup() { session_->warmup(); }
+    std::string response(const std::string& input_str, std::ostream* os = &std::cout, const char* end_with = nullptr) {
+        return session_->response(input_str, os, end_with);
+    }
+    float load_progress() { return model_->load_progress(); }
+    void reset() { session_->reset(); }
+    void print_speed() { session_->print_speed(); }
+    size_t token_count(const std::string& text) const { return model_->token_count(text); }
+    size_t max_token_count(const std::string& text) const { return model_->max_token_count(text); }
+public:
+    // load options, set before `load`
+    LlmConfig config_;
+private:
+    std::shared_ptr<LlmModel> model_;
+    std::unique_ptr<LlmSession> session_;
 };
 
 // some llm models
-class Chatglm_6b : public Llm {
+class Chatglm_6b : public LlmModel {
 public:
     Chatglm_6b() {
         model_name_ = "Chatglm_6b";
+        is_causal_ = false;
         layer_nums_ = 28;
         key_value_shape_ = {2, 0, 1, 32, 128};
     }
 private:
-    virtual std::vector<int> tokenizer(const std::string& query) override;
-    virtual VARP gen_attention_mask(int seq_len) override;
-    virtual VARP gen_position_ids(int seq_len) override;
-    virtual bool is_stop(int token_id) override;
-    int context_len_ = 0;
+    virtual std::vector<int> tokenizer(const LlmSession& session, const std::string& query) const override;
+    virtual VARP gen_attention_mask(const LlmSession& session, int seq_len) const override;
+    virtual VARP gen_static_attention_mask(int valid_len, int capacity) const override;
+    virtual VARP gen_position_ids(const LlmSession& session, int seq_len) const override;
+    virtual bool is_stop(int token_id) const override;
 };
 
-class Chatglm2_6b : public Llm {
+class Chatglm2_6b : public LlmModel {
 public:
     Chatglm2_6b() {
         model_name_ = "Chatglm2_6b";
@@ -133,10 +255,11 @@ public:
         key_value_shape_ = {2, 0, 1, 2, 128};
     }
 private:
-    virtual std::vector<int> tokenizer(const std::string& query) override;
-    virtual VARP gen_attention_mask(int seq_len) override;
-    virtual VARP gen_position_ids(int seq_len) override;
-    virtual bool is_stop(int token_id) override;
+    virtual std::vector<int> tokenizer(const LlmSession& session, const std::string& query) const override;
+    virtual VARP gen_attention_mask(const LlmSession& session, int seq_len) const override;
+    virtual VARP gen_static_attention_mask(int valid_len, int capacity) const override;
+    virtual VARP gen_position_ids(const LlmSession& session, int seq_len) const override;
+    virtual bool is_stop(int token_id) const override;
 };
 
 class Phi_2 : public Chatglm2_6b {
@@ -146,27 +269,28 @@ public:
         layer_nums_ = 32;
         key_value_shape_ = {1, 0, 2, 32, 80};
         hidden_size_ = 2560;
-        tokenizer_.reset(new Tiktoken);
+        tokenizer_.reset(new Tiktoken(Tiktoken::GPT2));
     }
 private:
-    virtual std::vector<int> tokenizer(const std::string& query) override;
-    virtual bool is_stop(int token_id) override;
+    virtual std::vector<int> tokenizer(const LlmSession& session, const std::string& query) const override;
+    virtual bool is_stop(int token_id) const override;
 };
 
-class Qwen_7b : public Llm {
+class Qwen_7b : public LlmModel {
 public:
     Qwen_7b() {
         model_name_ = "Qwen_7b";
         layer_nums_ = 32;
         key_value_shape_ = {2, 1, 0, 32, 128};
         hidden_size_ = 4096;
-        tokenizer_.reset(new Tiktoken);
+        tokenizer_.reset(new Tiktoken(Tiktoken::QWEN));
     }
 private:
-    virtual std::vector<int> tokenizer(const std::string& query) override;
-    virtual VARP gen_attention_mask(int seq_len) override;
-    virtual VARP gen_position_ids(int seq_len) override;
-    virtual bool is_stop(int token_id) override;
+    virtual std::vector<int> tokenizer(const LlmSession& session, const std::string& query) const override;
+    virtual VARP gen_attention_mask(const LlmSession& session, int seq_len) const override;
+    virtual VARP gen_static_attention_mask(int valid_len, int capacity) const override;
+    virtual VARP gen_position_ids(const LlmSession& session, int seq_len) const override;
+    virtual bool is_stop(int token_id) const override;
 };
 
 class Qwen_vl : public Qwen_7b {
@@ -177,7 +301,7 @@ public:
         layer_nums_ = 32;
         key_value_shape_ = {2, 1, 0, 32, 128};
         hidden_size_ = 4096;
-        tokenizer_.reset(new Tiktoken);
+        tokenizer_.reset(new Tiktoken(Tiktoken::QWEN));
     }
 private:
     const int img_size_ = 448;
@@ -186,10 +310,12 @@ private:
     const int img_end_ = 151858;
     const int img_pad_ = 151859;
 private:
-    std::vector<int> url_encode(const std::string& url);
-    virtual VARP visual_embedding(const std::vector<int>& input_ids) override;
-    virtual std::vector<int> tokenizer(const std::string& query) override;
-    virtual VARP gen_attention_mask(int seq_len) override;
+    std::vector<int> url_encode(const std::string& url) const;
+    virtual VARP visual_embedding(const std::vector<int>& input_ids, Module* visual_module,
+                                  const std::function<VARP(const std::vector<int>&)>& txt_embedding) const override;
+    virtual std::vector<int> tokenizer(const LlmSession& session, const std::string& query) const override;
+    virtual VARP gen_attention_mask(const LlmSession& session, int seq_len) const override;
+    virtual VARP gen_static_attention_mask(int valid_len, int capacity) const override;
 };
 
 class Qwen_1_8b : public Qwen_7b {
@@ -199,11 +325,11 @@ public:
         layer_nums_ = 24;
         key_value_shape_ = {2, 1, 0, 16, 128};
         hidden_size_ = 2048;
-        tokenizer_.reset(new Tiktoken);
+        tokenizer_.reset(new Tiktoken(Tiktoken::QWEN));
     }
 };
 
-class Llama2_7b : public Llm {
+class Llama2_7b : public LlmModel {
 public:
     Llama2_7b() {
         model_name_ = "Llama2_7b";
@@ -211,10 +337,10 @@ public:
         key_value_shape_ = {2, 1, 32, 0, 128};
     }
 private:
-    virtual std::vector<int> tokenizer(const std::string& query) override;
-    virtual VARP gen_attention_mask(int seq_len) override;
-    virtual VARP gen_position_ids(int seq_len) override;
-    virtual bool is_stop(int token_id) override;
+    virtual std::vector<int> tokenizer(const LlmSession& session, const std::string& query) const override;
+    virtual VARP gen_attention_mask(const LlmSession& session, int seq_len) const override;
+    virtual VARP gen_position_ids(const LlmSession& session, int seq_len) const override;
+    virtual bool is_stop(int token_id) const override;
 };
 
 // Llm end
@@ -234,6 +360,8 @@ public:
     static float dist(VARP var0, VARP var1);
     void load(const std::string& model_dir);
     VARP embedding(const std::string& txt);
+    // embeddings of `txts`, which are tokenized as one batch on the thread pool
+    std::vector<VARP> embedding(const std::vector<std::string>& txts);
     void print_speed();
     int dim() { return hidden_size_; }
 public:
@@ -242,6 +370,7 @@ public:
     int prompt_len_ = 0;
 protected:
     std::vector<int> tokenizer_encode(const std::string& input_str);
+    std::vector<std::vector<int>> tokenizer_encode(const std::vector<std::string>& input_strs);
 protected:
     // model configs
     int layer_nums_ = 0;
@@ -251,8 +380,11 @@ protected:
     std::unique_ptr<Tokenizer> tokenizer_;
 private:
     virtual std::vector<int> tokenizer(const std::string& query) = 0;
+    // ids of every query, one by one unless a model encodes them as a batch
+    virtual std::vector<std::vector<int>> tokenizer(const std::vector<std::string>& queries);
     virtual VARP gen_attention_mask(int seq_len) = 0;
     virtual VARP gen_position_ids(int seq_len) = 0;
+    VARP forward(const std::vector<int>& ids);
 private:
     // MNN Modules
     std::shared_ptr<Executor::RuntimeManager> runtime_manager_;
@@ -268,37 +400,15 @@ public:
         model_name_ = "Bge";
         layer_nums_ = 24;
         hidden_size_ = 1024;
+        tokenizer_.reset(new WordPiece);
     }
 private:
     virtual std::vector<int> tokenizer(const std::string& query) override;
+    virtual std::vector<std::vector<int>> tokenizer(const std::vector<std::string>& queries) override;
     virtual VARP gen_attention_mask(int seq_len) override;
     virtual VARP gen_position_ids(int seq_len) override;
 };
 
 // Embedding end
 
-// TextVectorStore strat
-class TextVectorStore {
-public:
-    TextVectorStore() {}
-    ~TextVectorStore() {}
-    static TextVectorStore* load(const std::string& path);
-    void set_embedding(std::shared_ptr<Embedding> embedding) {
-        embedding_ = embedding;
-    }
-    void save(const std::string& path);
-    void add_text(const std::string& text);
-    void add_texts(const std::vector<std::string>& texts);
-    std::vector<std::string> search_similar_texts(const std::string& txt, int topk = 1);
-    void bench();
-protected:
-    inline VARP text2vector(const std::string& text);
-private:
-    std::shared_ptr<Embedding> embedding_;
-    VARP vectors_;
-    std::vector<std::string> texts_;
-    int dim_ = 1024;
-};
-// TextVectorStore end
-
 #endif // LLM_hpp
@@ -0,0 +1,134 @@
+//
+//  thread_pool.hpp
+//
+
+#ifndef THREAD_POOL_hpp
+#define THREAD_POOL_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ThreadPool: fixed workers sharing a queue of parallel loops, taking indices of the oldest loop first.
+// The calling thread takes part in its loop, so loops of different threads always progress, and a loop
+// started inside a task runs inline.
+class ThreadPool {
+public:
+    explicit ThreadPool(int thread_num) {
+        for (int i = 1; i < thread_num; i++) {
+            workers_.emplace_back([this]() { worker(); });
+        }
+    }
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    // pool of all hardware threads shared by tokenizer and vector store
+    static ThreadPool& shared() {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+    int thread_num() const { return static_cast<int>(workers_.size()) + 1; }
+    // loops started by this thread run inline while it lives, so a background job never holds the workers from other loops
+    class InlineScope {
+    public:
+        InlineScope() : saved_(in_task()) { in_task() = true; }
+        ~InlineScope() { in_task() = saved_; }
+        InlineScope(const InlineScope&) = delete;
+        InlineScope& operator=(const InlineScope&) = delete;
+    private:
+        bool saved_;
+    };
+    // run `task(i)` for i in [0, n), return when all are done
+    void parallel_for(size_t n, const std::function<void(size_t)>& task) {
+        if (n <= 1 || workers_.empty() || in_task()) {
+            for (size_t i = 0; i < n; i++) {
+                task(i);
+            }
+            return;
+        }
+        Job job(task, n);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(&job);
+        }
+        cv_.notify_all();
+        run(job);
+        // all indices are taken, wait for the workers still running the job
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto queued = std::find(jobs_.begin(), jobs_.end(), &job);
+        if (queued != jobs_.end()) {
+            jobs_.erase(queued);
+        }
+        done_cv_.wait(lock, [&job]() { return job.active == 0; });
+    }
+private:
+    // one parallel loop, on the stack of its caller
+    struct Job {
+        Job(const std::function<void(size_t)>& job_task, size_t job_size) : task(job_task), size(job_size) {}
+        const std::function<void(size_t)>& task;
+        size_t size;
+        std::atomic<size_t> next{0};
+        // workers running the job, guarded by mutex_
+        size_t active = 0;
+    };
+    static bool& in_task() {
+        thread_local bool flag = false;
+        return flag;
+    }
+    static void run(Job& job) {
+        in_task() = true;
+        for (size_t i = job.next++; i < job.size; i = job.next++) {
+            job.task(i);
+        }
+        in_task() = false;
+    }
+    void worker() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            // drop the jobs whose indices are all taken, their callers wait for the running workers
+            while (!jobs_.empty() && jobs_.front()->next >= jobs_.front()->size) {
+                jobs_.pop_front();
+            }
+            if (stop_) {
+                return;
+            }
+            if (jobs_.empty()) {
+                cv_.wait(lock);
+                continue;
+            }
+            auto job = jobs_.front();
+            job->active++;
+            lock.unlock();
+            run(*job);
+            lock.lock();
+            if (--job->active == 0) {
+                done_cv_.notify_all();
+            }
+        }
+    }
+private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable done_cv_;
+    // running loops, oldest first
+    std::deque<Job*> jobs_;
+    bool stop_ = false;
+};
+
+#endif // THREAD_POOL_hpp
@@ -9,34 +9,265 @@
 #define TOKENIZER_hpp
 
 #include <vector>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <iostream>
 #include <string_view>
+#include <iterator>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
 
+// read only mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    bool valid() const { return data_ != nullptr; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+// EncodeCache: LRU cache of the ids of encoded text parts, keyed by the hash of the part.
+// It is thread safe, so the sessions of a model share one.
+class EncodeCache {
+public:
+    // parts are kept up to `capacity` bytes of text and ids, a part over 1/16 of it is not kept
+    explicit EncodeCache(size_t capacity) : capacity_(capacity) {}
+    // append the ids of `text` to `ids`, false if it is not cached
+    bool find(std::string_view text, std::vector<int>& ids);
+    void insert(std::string_view text, const std::vector<int>& ids);
+    // kept parts and their bytes
+    size_t size();
+    size_t bytes();
+private:
+    struct Entry {
+        std::string text;
+        std::vector<int> ids;
+    };
+    static size_t entry_bytes(size_t text_size, size_t ids_size);
+    size_t capacity_;
+    size_t bytes_ = 0;
+    std::mutex mutex_;
+    // most recently used first
+    std::list<Entry> entries_;
+    std::unordered_map<size_t, std::list<Entry>::iterator> index_;
+};
+
+// IdSink: output of `Tokenizer::encode_text`, appends the ids to a vector, or only counts them without one
+class IdSink {
+public:
+    explicit IdSink(std::vector<int>* ids) : ids_(ids), size_(ids ? ids->size() : 0) {}
+    void push(int id) {
+        if (ids_) {
+            ids_->push_back(id);
+        }
+        size_++;
+    }
+    template <typename Iter>
+    void append(Iter begin, Iter end) {
+        if (ids_) {
+            ids_->insert(ids_->end(), begin, end);
+        }
+        size_ += std::distance(begin, end);
+    }
+    // drop the ids after the first `size`
+    void resize(size_t size) {
+        if (ids_) {
+            ids_->resize(size);
+        }
+        size_ = size;
+    }
+    size_t size() const { return size_; }
+private:
+    std::vector<int>* ids_;
+    size_t size_;
+};
+
+// A tokenizer is one binary image: header, token table and the sections of the subclass.
+// The image is built when parsing the text vocab, or mapped from the file written by `save`.
 class Tokenizer {
 public:
     Tokenizer() = default;
     virtual ~Tokenizer() = default;
-    virtual bool load(const std::string& filename) = 0;
-    virtual std::vector<int> encode(const std::string& str) = 0;
-    virtual std::string decode(int id) = 0;
+    Tokenizer(const Tokenizer&) = delete;
+    Tokenizer& operator=(const Tokenizer&) = delete;
+    // load text vocab, or binary file written by `save` which is mapped without parsing
+    bool load(const std::string& filename);
+    // save the loaded tokenizer as binary file
+    bool save(const std::string& filename) const;
+    // a long text is split and its parts are encoded in parallel
+    std::vector<int> encode(const std::string& str);
+    // texts are encoded in parallel on the shared thread pool
+    std::vector<std::vector<int>> encode_batch(const std::vector<std::string_view>& texts);
+    // encode the concatenation of `segments`. It is cut at segment and line ends where the parts
+    // encode to the same ids, and parts found in `cache` are not encoded again.
+    std::vector<int> encode(const std::vector<std::string_view>& segments, EncodeCache* cache);
+    // number of ids of `str`, long texts are counted in parallel parts and no ids are kept
+    size_t count(std::string_view str);
+    // upper bound of `count` in one pass over the bytes, every token covers one byte at least
+    virtual size_t max_count(std::string_view str) const { return str.size(); }
+    // bytes of `id` in the decode table, empty for an invalid id
+    std::string_view decode_view(int id) const {
+        if (id < 0 || id >= vocab_size_) {
+            return std::string_view();
+        }
+        return std::string_view(decode_blob_ + decode_offsets_[id], decode_offsets_[id + 1] - decode_offsets_[id]);
+    }
+    std::string decode(int id) const { return std::string(decode_view(id)); }
+protected:
+    enum Kind {
+        SENTENCEPIECE = 1,
+        TIKTOKEN = 2,
+        WORDPIECE = 3
+    };
+    virtual Kind kind() const = 0;
+    // parse text vocab into `image`, which starts with `write_tokens`
+    virtual bool load_text(const std::string& filename, std::vector<char>& image) = 0;
+    // view the sections following the token table, `offset` is moved past them
+    virtual bool map(const char* image, size_t size, size_t& offset) = 0;
+    // put the ids of `str` to `ids`, called from several threads at once
+    virtual void encode_text(std::string_view str, IdSink& ids) = 0;
+    // positions about every `chunk` bytes of `str`, encoding the parts between them gives the same ids
+    virtual std::vector<size_t> split(std::string_view /* str */, size_t /* chunk */) const { return {}; }
+    // the positions of ascending `points` which `split` could return
+    virtual std::vector<size_t> filter_splits(std::string_view /* str */, const std::vector<size_t>& /* points */) const { return {}; }
+    void write_tokens(const std::vector<std::string>& tokens, std::vector<char>& image) const;
+    std::string_view token(int id) const {
+        return std::string_view(blob_ + offsets_[id], offsets_[id + 1] - offsets_[id]);
+    }
+protected:
+    int vocab_size_ = 0;
+    size_t max_token_len_ = 0;
+    // token i is blob_[offsets_[i], offsets_[i + 1])
+    const uint32_t* offsets_ = nullptr;
+    const char* blob_ = nullptr;
+    // decoded bytes of token i, the token table unless the subclass maps its own
+    const uint32_t* decode_offsets_ = nullptr;
+    const char* decode_blob_ = nullptr;
+private:
+    bool map_image(const char* image, size_t size);
+    const char* image_data_ = nullptr;
+    size_t image_size_ = 0;
+    // owned image when parsed from text, or the mapped binary file
+    std::vector<char> image_;
+    std::unique_ptr<MappedFile> mapped_;
 };
 
-class Sentencepiece : public Tokenizer {
+// StreamDecoder: text of generated ids which only breaks at utf-8 character boundaries.
+// The bytes of an incomplete character are held until the ids completing it arrive.
+class StreamDecoder {
+public:
+    explicit StreamDecoder(const Tokenizer* tokenizer) : tokenizer_(tokenizer) {}
+    // complete characters up to `id`, valid until the next call
+    std::string_view put(int id);
+    // end of the stream, U+FFFD for the held bytes of an incomplete character
+    std::string_view flush();
+private:
+    const Tokenizer* tokenizer_;
+    std::string buffer_;
+    // bytes of `buffer_` returned by the last call
+    size_t emitted_ = 0;
+};
+
+// Trie: read only byte trie built once at load.
+// Nodes and edges are flat arrays, the children of a node are sorted by label
+// and the root children are a direct table. The arrays are a serialized image,
+// owned after `build` or viewed in a tokenizer image after `map`.
+class Trie {
 public:
-    Sentencepiece() = default;
-    virtual bool load(const std::string& filename) override;
-    virtual std::vector<int> encode(const std::string& str) override;
-    virtual std::string decode(int id) override;
+    Trie() = default;
+    Trie(const Trie&) = delete;
+    Trie& operator=(const Trie&) = delete;
+    void build(const std::vector<std::pair<std::string_view, int>>& keys);
+    // append the serialized trie to `image`
+    void save(std::vector<char>& image) const;
+    // view the serialized trie at `image + offset` without copy, `offset` is moved past it
+    bool map(const char* image, size_t size, size_t& offset);
+    // value of `key`, -1 if not found
+    int find(std::string_view key) const;
+    // value of the longest key which is a prefix of `str`, -1 if not found
+    int longest_match(std::string_view str, size_t* match_len) const;
+    // call `visit(len, value)` for every key which is a prefix of `str`, from short to long
+    template <typename Visit>
+    void prefix_match(std::string_view str, Visit&& visit) const {
+        if (node_num_ == 0) {
+            return;
+        }
+        int node = 0;
+        for (size_t i = 0; i < str.size(); i++) {
+            node = child(node, static_cast<uint8_t>(str[i]));
+            if (node < 0) {
+                return;
+            }
+            if (values_[node] >= 0) {
+                visit(i + 1, values_[node]);
+            }
+        }
+    }
+    bool empty() const { return node_num_ <= 1; }
 private:
+    inline int child(int node, uint8_t label) const {
+        if (node == 0) {
+            return root_[label];
+        }
+        uint32_t begin = edge_begin_[node], end = edge_begin_[node + 1];
+        while (begin < end) {
+            uint32_t mid = (begin + end) / 2;
+            if (labels_[mid] < label) {
+                begin = mid + 1;
+            } else {
+                end = mid;
+            }
+        }
+        return (begin < edge_begin_[node + 1] && labels_[begin] == label) ? targets_[begin] : -1;
+    }
+private:
+    uint32_t node_num_ = 0;
+    uint32_t edge_num_ = 0;
+    const int* root_ = nullptr;
+    // node values, -1 is not a key
+    const int* values_ = nullptr;
+    // edges of node i are [edge_begin_[i], edge_begin_[i + 1])
+    const uint32_t* edge_begin_ = nullptr;
+    const int* targets_ = nullptr;
+    const uint8_t* labels_ = nullptr;
+    // serialized image after `build`
+    std::vector<char> storage_;
+};
+
+class Sentencepiece : public Tokenizer {
+public:
     enum ModelType {
         UNIGRAM = 1,
         BPE = 2,
         WORD = 3,
         CHAR = 4
     };
+    // `type` is used if the text vocab has no `#type` line, the binary image keeps the type it was built with
+    Sentencepiece(ModelType type = BPE) : type_(type) {}
+    // a char which is a piece is one token at most, an unknown char falls back to its bytes
+    virtual size_t max_count(std::string_view str) const override;
+protected:
+    virtual Kind kind() const override { return SENTENCEPIECE; }
+    virtual bool load_text(const std::string& filename, std::vector<char>& image) override;
+    virtual bool map(const char* image, size_t size, size_t& offset) override;
+    virtual void encode_text(std::string_view str, IdSink& ids) override;
+    virtual std::vector<size_t> split(std::string_view str, size_t chunk) const override;
+    virtual std::vector<size_t> filter_splits(std::string_view str, const std::vector<size_t>& points) const override;
+private:
     enum PieceType {
         NORMAL = 1,
         UNKNOWN = 2,
@@ -45,12 +276,6 @@ private:
         UNUSED = 5,
         BYTE = 6
     };
-    struct SentencePiece {
-        std::string piece;
-        float score;
-        PieceType type = PieceType::NORMAL;
-    };
-    using EncodeResult = std::vector<std::pair<std::string_view, int>>;
 private:
     // model train type
     ModelType type_ = BPE;
@@ -58,30 +283,99 @@ private:
     bool byte_fall_back_ = true;
     // unknown id.
     int unk_id_ = 0;
-    // pieces from model
-    std::vector<SentencePiece> sentence_pieces_;
+    // score and type of pieces, the pieces are the token table
+    const float* scores_ = nullptr;
+    const uint8_t* types_ = nullptr;
     // piece -> id map for normal pieces
-    std::unordered_map<std::string, int> pieces_;
+    Trie pieces_;
     // piece -> id map for control, unknown, and byte pieces
-    std::unordered_map<std::string, int> reserved_id_map_;
+    Trie reserved_id_map_;
+    // id of byte piece `<0xXX>`
+    int byte_ids_[256];
+    // score range of normal pieces, used by unigram for unknown and user defined pieces
+    float min_score_ = 0.f;
+    float max_score_ = 0.f;
 private:
+    using RevMerge = std::unordered_map<std::string_view, std::pair<std::string_view, std::string_view>>;
     float get_score(int id) const;
     bool is_unused(int id) const;
     bool is_control(int id) const;
-    int piece_to_id(const std::string& w) const;
+    int piece_to_id(std::string_view w) const;
+    // no piece crosses `pos`
+    bool is_split(std::string_view str, size_t pos) const;
     std::string byte_to_piece(unsigned char c) const;
-    EncodeResult bpe_encode(std::string_view str, float alpha = 0.f);
+    // put `id` of `piece`, an unknown piece falls back to its bytes
+    void put_piece(std::string_view piece, int id, IdSink& ids) const;
+    void resegment(std::string_view w, const RevMerge& rev_merge, IdSink& ids) const;
+    void bpe_encode(std::string_view str, IdSink& ids, float alpha = 0.f);
+    void unigram_encode(std::string_view str, IdSink& ids) const;
 };
 
 class Tiktoken : public Tokenizer {
 public:
-    Tiktoken() = default;
-    virtual bool load(const std::string& filename) override;
-    virtual std::vector<int> encode(const std::string& str) override;
-    virtual std::string decode(int id) override;
+    // pre-tokenize pattern of byte-level bpe, token id is the merge rank
+    enum Pattern {
+        // no bpe, greedy longest match
+        NONE = 0,
+        // 's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+        GPT2 = 1,
+        // (?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
+        QWEN = 2
+    };
+    Tiktoken(Pattern pattern = NONE) : pattern_(pattern) {}
+protected:
+    virtual Kind kind() const override { return TIKTOKEN; }
+    virtual bool load_text(const std::string& filename, std::vector<char>& image) override;
+    virtual bool map(const char* image, size_t size, size_t& offset) override;
+    virtual void encode_text(std::string_view str, IdSink& ids) override;
+    virtual std::vector<size_t> split(std::string_view str, size_t chunk) const override;
+    virtual std::vector<size_t> filter_splits(std::string_view str, const std::vector<size_t>& points) const override;
+private:
+    // length of the first pre-token of `str`
+    size_t pretokenize(std::string_view str) const;
+    // no token crosses `pos`, the split of greedy match
+    bool is_split(std::string_view str, size_t pos) const;
+    // pre-token boundaries `bounds` end the same when the text up to the last one is encoded alone
+    bool same_alone(std::string_view str, const std::vector<size_t>& bounds) const;
+    void greedy_encode(std::string_view str, IdSink& ids) const;
+    void bpe_encode(std::string_view word, IdSink& ids);
+private:
+    Pattern pattern_;
+    // token -> rank, the token table is rank -> token
+    Trie encoder_;
+    // word -> ids cache of bpe merge results
+    static constexpr size_t kMaxCacheSize = 1 << 16;
+    std::shared_mutex cache_mutex_;
+    std::deque<std::string> cache_words_;
+    std::unordered_map<std::string_view, std::vector<int>> cache_;
+};
+
+// WordPiece: bert basic tokenization, then greedy longest match first in every word,
+// pieces after the first one of a word are the `##` tokens
+class WordPiece : public Tokenizer {
+public:
+    // lower case and strip accents, as the uncased and chinese bert models do
+    WordPiece(bool lower_case = true) : lower_case_(lower_case) {}
+    // every piece covers one folded code point at least
+    virtual size_t max_count(std::string_view str) const override;
+protected:
+    virtual Kind kind() const override { return WORDPIECE; }
+    virtual bool load_text(const std::string& filename, std::vector<char>& image) override;
+    virtual bool map(const char* image, size_t size, size_t& offset) override;
+    virtual void encode_text(std::string_view str, IdSink& ids) override;
+    virtual std::vector<size_t> split(std::string_view str, size_t chunk) const override;
+    virtual std::vector<size_t> filter_splits(std::string_view str, const std::vector<size_t>& points) const override;
+private:
+    // ids of a word of `chars` code points, a single unknown id if it can't be covered
+    void word_encode(std::string_view word, size_t chars, IdSink& ids) const;
+    // no word crosses `pos`
+    bool is_split(std::string_view str, size_t pos) const;
 private:
-    std::unordered_map<std::string, int> encoder_;
-    std::vector<std::string> decoder_;
+    bool lower_case_;
+    int unk_id_ = 100;
+    // first piece of a word -> id, and `##` piece without `##` -> id
+    Trie pieces_;
+    Trie suffixes_;
 };
 
 #endif // TOKENIZER_hpp
\ No newline at end of file
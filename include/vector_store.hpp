@@ -0,0 +1,528 @@
+//
+//  vector_store.hpp
+//
+
+#ifndef VECTOR_STORE_hpp
+#define VECTOR_STORE_hpp
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "llm.hpp"
+
+// VectorMatrix: row-major float vectors in one 64-byte aligned buffer.
+// Rows are padded to a multiple of 16 floats and the capacity doubles, so appending is amortized O(1).
+// A matrix may borrow the rows of a mapped file, they are copied to its own buffer by the next append.
+class VectorMatrix {
+public:
+    static constexpr size_t kAlign = 64;
+    explicit VectorMatrix(int dim = 0) { reset(dim); }
+    ~VectorMatrix() { release(); }
+    VectorMatrix(const VectorMatrix&) = delete;
+    VectorMatrix& operator=(const VectorMatrix&) = delete;
+    // drop all rows and set the row size
+    void reset(int dim);
+    void reserve(size_t rows);
+    // borrow `n` aligned rows of `stride()` floats at `data`, which outlive the matrix or its next append
+    void view(const float* data, size_t n, int dim);
+    void swap(VectorMatrix& other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(dim_, other.dim_);
+        std::swap(stride_, other.stride_);
+        std::swap(owned_, other.owned_);
+    }
+    // append `n` rows of `dim` floats
+    void append(const float* rows, size_t n);
+    int dim() const { return dim_; }
+    // floats between the starts of two rows
+    size_t stride() const { return stride_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const float* row(size_t i) const { return data_ + i * stride_; }
+    float* row(size_t i) { return data_ + i * stride_; }
+private:
+    void release();
+private:
+    float* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    int dim_ = 0;
+    size_t stride_ = 0;
+    // false while borrowing the rows
+    bool owned_ = true;
+};
+
+// one search result, a smaller distance is more similar
+struct VectorHit {
+    int64_t id;
+    float distance;
+};
+
+// TopK: the k smallest distances pushed, kept in a max heap so the worst one is replaced in O(log k)
+class TopK {
+public:
+    explicit TopK(int k) : k_(std::max(k, 0)) { heap_.reserve(k_); }
+    int k() const { return static_cast<int>(k_); }
+    // distance a hit has to be less than to be kept
+    float bound() const {
+        return heap_.size() < k_ ? std::numeric_limits<float>::infinity() : heap_.front().distance;
+    }
+    void push(int64_t id, float distance) {
+        if (heap_.size() < k_) {
+            heap_.push_back({id, distance});
+            std::push_heap(heap_.begin(), heap_.end(), less);
+        } else if (k_ > 0 && distance < heap_.front().distance) {
+            std::pop_heap(heap_.begin(), heap_.end(), less);
+            heap_.back() = {id, distance};
+            std::push_heap(heap_.begin(), heap_.end(), less);
+        }
+    }
+    void merge(const TopK& other) {
+        for (const auto& hit : other.heap_) {
+            push(hit.id, hit.distance);
+        }
+    }
+    // hits from near to far, the heap is left empty
+    std::vector<VectorHit> sorted() {
+        std::sort_heap(heap_.begin(), heap_.end(), less);
+        return std::move(heap_);
+    }
+private:
+    static bool less(const VectorHit& a, const VectorHit& b) {
+        return a.distance < b.distance || (a.distance == b.distance && a.id < b.id);
+    }
+    size_t k_;
+    std::vector<VectorHit> heap_;
+};
+
+// Bitset: a bit per row of a store, rows past its size are never set
+class Bitset {
+public:
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+    explicit Bitset(size_t size = 0, bool value = false) { resize(size, value); }
+    size_t size() const { return size_; }
+    bool test(size_t i) const { return i < size_ && (words_[i >> 6] >> (i & 63) & 1); }
+    void set(size_t i) { words_[i >> 6] |= uint64_t(1) << (i & 63); }
+    void reset(size_t i) { words_[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    // rows added by growing are set to `value`
+    void resize(size_t size, bool value = false);
+    // rows set
+    size_t count() const;
+    // first row set from `i`, npos if none
+    size_t next(size_t i) const;
+    // bits of rows [i, i + 16), `i` is a multiple of 16
+    uint32_t bits16(size_t i) const { return i < size_ ? (words_[i >> 6] >> (i & 63)) & 0xffff : 0; }
+    const std::vector<uint64_t>& words() const { return words_; }
+    Bitset& operator&=(const Bitset& other);
+    Bitset& operator|=(const Bitset& other);
+    // complement of the rows in the size
+    void flip();
+private:
+    // bits past the size are zero
+    void clear_tail();
+private:
+    std::vector<uint64_t> words_;
+    size_t size_ = 0;
+};
+
+// Filter: a predicate on the metadata columns of a store, compiled by a search to the bitset of the rows it keeps.
+// A comparison keeps no row without a value in its column, or with a value of the other type.
+class Filter {
+public:
+    // keeps every row
+    Filter() = default;
+    bool empty() const { return node_ == nullptr; }
+    static Filter eq(const std::string& column, int64_t value) { return in(column, std::vector<int64_t>{value}); }
+    static Filter eq(const std::string& column, const std::string& value) { return in(column, std::vector<std::string>{value}); }
+    // lo <= value <= hi
+    static Filter range(const std::string& column, int64_t lo, int64_t hi);
+    static Filter in(const std::string& column, const std::vector<int64_t>& values);
+    static Filter in(const std::string& column, const std::vector<std::string>& values);
+    Filter operator&&(const Filter& other) const;
+    Filter operator||(const Filter& other) const;
+    Filter operator!() const;
+private:
+    friend class TextVectorStore;
+    enum Op { IN_INTS, IN_STRINGS, RANGE, AND, OR, NOT };
+    struct Node;
+    explicit Filter(std::shared_ptr<const Node> node) : node_(std::move(node)) {}
+    std::shared_ptr<const Node> node_;
+};
+
+// MetadataColumn: a value per row, strings are coded by their index in the dictionary
+struct MetadataColumn {
+    enum Type {
+        INT = 0,
+        STRING = 1
+    };
+    Type type = INT;
+    // rows with a value
+    Bitset valid;
+    std::vector<int64_t> values;
+    std::vector<std::string> dictionary;
+    std::unordered_map<std::string, int64_t> codes;
+};
+
+// per query knobs of the approximate indexes, 0 takes the default of the store
+struct SearchParams {
+    // ivf lists scanned
+    int nprobe = 0;
+    // hnsw candidates kept while searching, not less than topk
+    int ef = 0;
+    // candidates of pq or scalar codes re-ranked by the exact vectors
+    int rerank = 0;
+    // rows searched, all if empty. It is compiled under the store lock by every search, so it sees the rows of
+    // the store as searched. Rows outside it are never scored, so it also bounds the work of a search.
+    Filter filter;
+};
+
+// ProductQuantizer: a vector is split into m sub vectors, each coded by one byte for the nearest of 256 centroids.
+// The distance to a query is a sum of m entries of its lookup table (asymmetric distance computation).
+// Codes are interleaved in blocks of 16 rows, so a block is summed by simd gathers.
+class ProductQuantizer {
+public:
+    static constexpr int kCentroids = 256;
+    static constexpr size_t kBlock = 16;
+    // train `m` sub quantizers on the rows of `data`, `rotate` first learns an opq rotation
+    void train(const VectorMatrix& data, int m, bool rotate);
+    bool trained() const { return m_ > 0; }
+    int m() const { return m_; }
+    int dim() const { return dim_; }
+    // bytes of the codes of `rows` rows
+    size_t code_size(size_t rows) const { return (rows + kBlock - 1) / kBlock * kBlock * m_; }
+    // the `m` bytes code of a row
+    void encode(const float* vector, uint8_t* code) const;
+    // put `code` as row `index` of the interleaved `codes`, growing them
+    void put_code(const uint8_t* code, size_t index, std::vector<uint8_t>& codes) const;
+    // m x 256 distances of the sub vectors of a row or prepared query to the centroids
+    void lookup_table(const float* query, bool inner_product, float* table) const;
+    // distances of the kBlock rows of a block of codes
+    void block_distances(const float* table, const uint8_t* block, float* out) const;
+    void save(std::vector<char>& image) const;
+    bool load(const char* image, size_t size, size_t& offset);
+private:
+    // `vector` rotated and split into m sub vectors of `sub_dim_`
+    void split(const float* vector, float* subs) const;
+private:
+    int m_ = 0;
+    int dim_ = 0;
+    int sub_dim_ = 0;
+    // rows are the rotated axes, empty without opq
+    VectorMatrix rotation_;
+    // m x sub_dim_ x 256, the centroids of a sub quantizer are columns
+    std::vector<float> codebooks_;
+};
+
+class TextVectorStore;
+
+// VectorIndex: approximate nearest neighbor search over the rows of a store
+class VectorIndex {
+public:
+    enum Type {
+        // exact scan of all rows, no index
+        FLAT = 0,
+        // k-means lists, `nprobe` nearest lists are scanned
+        IVF = 1,
+        // hierarchical navigable small world graph, `ef` candidates are searched
+        HNSW = 2,
+        // pq codes of all rows are scanned, the nearest `rerank` are re-ranked
+        PQ = 3,
+        // ivf lists of pq codes
+        IVF_PQ = 4,
+        // fp16 rows
+        FP16 = 5,
+        // a byte per dimension, in steps between the min and max of the dimension
+        SQ8 = 6,
+        // a bit per dimension, the sign around its mean, hamming distances pick the rows re-ranked
+        BINARY = 7
+    };
+    virtual ~VectorIndex() = default;
+    static std::unique_ptr<VectorIndex> create(Type type);
+    virtual Type type() const = 0;
+    // index all rows of `store`
+    virtual void build(const TextVectorStore& store) = 0;
+    // index rows [begin, end) just appended to `store`
+    virtual void add(const TextVectorStore& store, size_t begin, size_t end) = 0;
+    // push the nearest rows to the prepared `query` to `top`, only those in `filter` if not null
+    virtual void search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                        TopK& top) const = 0;
+    virtual void save(std::vector<char>& image) const = 0;
+    // load the bytes written by `save` for the rows of `store`, false if they do not match them
+    virtual bool load(const TextVectorStore& store, const char* image, size_t size) = 0;
+};
+
+class IvfIndex : public VectorIndex {
+public:
+    explicit IvfIndex(bool pq = false) : pq_(pq) {}
+    virtual Type type() const override { return pq_ ? IVF_PQ : IVF; }
+    virtual void build(const TextVectorStore& store) override;
+    virtual void add(const TextVectorStore& store, size_t begin, size_t end) override;
+    virtual void search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                        TopK& top) const override;
+    virtual void save(std::vector<char>& image) const override;
+    virtual bool load(const TextVectorStore& store, const char* image, size_t size) override;
+private:
+    // append rows [begin, end) to the lists of their nearest centroids
+    void assign(const TextVectorStore& store, size_t begin, size_t end);
+private:
+    VectorMatrix centroids_;
+    // row ids of every list
+    std::vector<std::vector<uint32_t>> lists_;
+    // lists keep pq codes of the rows, which are scanned instead of the vectors
+    bool pq_;
+    ProductQuantizer quantizer_;
+    std::vector<std::vector<uint8_t>> codes_;
+};
+
+// HnswIndex: layers of proximity graphs, a node is in layers [0, level] with a random level.
+// Rows are inserted in parallel, and the links of a node are guarded by one of the striped locks.
+class HnswIndex : public VectorIndex {
+public:
+    HnswIndex() : locks_(kLockStripes) {}
+    virtual Type type() const override { return HNSW; }
+    virtual void build(const TextVectorStore& store) override;
+    virtual void add(const TextVectorStore& store, size_t begin, size_t end) override;
+    virtual void search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                        TopK& top) const override;
+    virtual void save(std::vector<char>& image) const override;
+    virtual bool load(const TextVectorStore& store, const char* image, size_t size) override;
+private:
+    // (distance, node)
+    using Candidate = std::pair<float, uint32_t>;
+    static constexpr size_t kLockStripes = 1024;
+    // links of `node` at `level`: the count and then the neighbors
+    uint32_t* links(uint32_t node, int level) {
+        return level == 0 ? links0_.data() + node * (2 * m_ + 1) : upper_links_[node].data() + (level - 1) * (m_ + 1);
+    }
+    const uint32_t* links(uint32_t node, int level) const {
+        return const_cast<HnswIndex*>(this)->links(node, level);
+    }
+    std::mutex& lock(uint32_t node) const { return locks_[node % kLockStripes]; }
+    // copy the neighbors of `node` at `level`, under its lock while building
+    template <bool kLocked>
+    void neighbors(uint32_t node, int level, std::vector<uint32_t>& out) const;
+    void insert(const TextVectorStore& store, uint32_t node);
+    // nearest node to `query` from `entry` by greedy walk at `level`
+    template <bool kLocked>
+    Candidate greedy(const TextVectorStore& store, const float* query, Candidate entry, int level) const;
+    // about the `ef` nearest nodes to `query` at `level` searched from `entry`, from near to far, only those in `filter` if not null
+    template <bool kLocked>
+    std::vector<Candidate> search_layer(const TextVectorStore& store, const float* query, Candidate entry, int ef, int level,
+                                        const Bitset* filter = nullptr) const;
+    // keep at most `m` of the sorted `candidates`, which are nearer to the query than to every kept one
+    void select_neighbors(const TextVectorStore& store, std::vector<Candidate>& candidates, int m) const;
+private:
+    // max links of a node above layer 0, layer 0 has 2 * m_
+    int m_ = 16;
+    int ef_construction_ = 200;
+    std::vector<uint8_t> levels_;
+    std::vector<uint32_t> links0_;
+    std::vector<std::vector<uint32_t>> upper_links_;
+    // entry node at the top layer
+    uint32_t entry_ = 0;
+    int max_level_ = -1;
+    std::mutex entry_mutex_;
+    mutable std::vector<std::mutex> locks_;
+};
+
+class PqIndex : public VectorIndex {
+public:
+    virtual Type type() const override { return PQ; }
+    virtual void build(const TextVectorStore& store) override;
+    virtual void add(const TextVectorStore& store, size_t begin, size_t end) override;
+    virtual void search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                        TopK& top) const override;
+    virtual void save(std::vector<char>& image) const override;
+    virtual bool load(const TextVectorStore& store, const char* image, size_t size) override;
+private:
+    ProductQuantizer quantizer_;
+    std::vector<uint8_t> codes_;
+    size_t size_ = 0;
+};
+
+// ScalarIndex: every dimension of the rows coded alone, as FP16, SQ8 or BINARY, and all codes scanned by simd kernels.
+// SQ8 queries are quantized too, so the scan is an integer dot product.
+class ScalarIndex : public VectorIndex {
+public:
+    explicit ScalarIndex(Type type) : type_(type) {}
+    virtual Type type() const override { return type_; }
+    virtual void build(const TextVectorStore& store) override;
+    virtual void add(const TextVectorStore& store, size_t begin, size_t end) override;
+    virtual void search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                        TopK& top) const override;
+    virtual void save(std::vector<char>& image) const override;
+    virtual bool load(const TextVectorStore& store, const char* image, size_t size) override;
+private:
+    // bytes of the code of a row, a multiple of 64
+    size_t code_size() const;
+    void encode(const float* vector, uint8_t* code) const;
+private:
+    Type type_;
+    // floats of a padded row
+    size_t stride_ = 0;
+    // per dimension min of SQ8 or mean of BINARY
+    std::vector<float> offsets_;
+    // per dimension step of SQ8
+    std::vector<float> steps_;
+    std::vector<uint8_t> codes_;
+    // squared norms of the SQ8 rows as decoded, for l2
+    std::vector<float> norms_;
+    size_t size_ = 0;
+};
+
+// TextVectorStore strat
+class TextVectorStore {
+public:
+    enum Metric {
+        // squared euclidean distance
+        L2 = 0,
+        // negative inner product
+        INNER_PRODUCT = 1,
+        // negative inner product, vectors and queries are normalized
+        COSINE = 2
+    };
+    TextVectorStore() {}
+    // waits for a running compaction
+    ~TextVectorStore();
+    // a store file is mapped, so vectors and texts are read when used, files of Variable::save are copied
+    static TextVectorStore* load(const std::string& path);
+    void set_embedding(std::shared_ptr<Embedding> embedding) {
+        embedding_ = embedding;
+    }
+    void save(const std::string& path);
+    // the id of the text, ids are never reused
+    int64_t add_text(const std::string& text);
+    // embed all texts, then append their vectors at once
+    std::vector<int64_t> add_texts(const std::vector<std::string>& texts);
+    // replace the text and vector of `id`, which keeps its metadata, false if there is no `id`
+    bool update_text(int64_t id, const std::string& text);
+    // delete the text of `id` by a tombstone, false if there is no `id`
+    bool remove_text(int64_t id);
+    // rewrite the rows without the deleted ones and rebuild the index. Writers wait for it, readers only for the swap of the result.
+    void compact();
+    std::vector<std::string> search_similar_texts(const std::string& txt, int topk = 1);
+    // search_similar_texts of the rows kept by `filter`
+    std::vector<std::string> search_similar_texts(const std::string& txt, const Filter& filter, int topk = 1);
+    // search_similar_texts of every text, searched as one batch
+    std::vector<std::vector<std::string>> search_similar_texts(const std::vector<std::string>& txts, int topk = 1);
+    // the ids of the `topk` nearest texts to `query` of `dim` floats, by the index if built or a parallel scan
+    std::vector<VectorHit> search(const float* query, int topk, const SearchParams& params = SearchParams()) const;
+    // search of `count` queries of `dim` floats, a flat store is scanned by blocks of queries times blocks of rows
+    std::vector<std::vector<VectorHit>> search_batch(const float* queries, size_t count, int topk, const SearchParams& params = SearchParams()) const;
+    // index the rows and the rows added later, FLAT drops the index
+    void build_index(VectorIndex::Type type);
+    void bench();
+    // texts not deleted
+    size_t live_size() const;
+    // text of `id`, empty if there is none
+    std::string text(int64_t id) const;
+    // metadata of `id`, a column takes the type of its first value
+    void set_metadata(int64_t id, const std::string& column, int64_t value);
+    void set_metadata(int64_t id, const std::string& column, const std::string& value);
+    // rows, with the deleted ones until a compaction. The rows are read by the indexes while the store is locked.
+    size_t size() const { return vectors_.size(); }
+    const VectorMatrix& vectors() const { return vectors_; }
+    // distance of a prepared query to a row
+    float distance(const float* query, const float* row) const;
+    // push rows [begin, end) to `top`, only those in `filter` if not null
+    void scan(const float* query, size_t begin, size_t end, TopK& top, const Bitset* filter = nullptr) const;
+public:
+    // distance of search, set before adding vectors
+    Metric metric_ = L2;
+    // ivf lists, 0 is 4 * sqrt(rows) when built
+    int ivf_nlist_ = 0;
+    // ivf lists scanned per query
+    int ivf_nprobe_ = 16;
+    // hnsw links per node and layer, candidates kept while building and while searching
+    int hnsw_m_ = 16;
+    int hnsw_ef_construction_ = 200;
+    int hnsw_ef_search_ = 64;
+    // pq bytes per vector, 0 is dim / 8
+    int pq_m_ = 0;
+    // rotate the vectors by opq before pq
+    bool pq_opq_ = false;
+    // candidates of pq or scalar codes re-ranked per query, 0 returns the distances of the codes
+    int rerank_ = 64;
+    // share of deleted rows that starts a compaction in the background, 0 never compacts by itself
+    float compact_ratio_ = 0.25f;
+protected:
+    inline VARP text2vector(const std::string& text);
+    // append `n` vectors and their texts, with new ids if `ids` is null
+    void append(const float* vectors, const std::string* texts, size_t n, const int64_t* ids = nullptr);
+    // `n` queries padded to the row stride, normalized for cosine
+    void prepare_query(const float* query, VectorMatrix& prepared, size_t n = 1) const;
+    // views of the vectors and texts of the store file `image`, copies of them unless `borrow`
+    bool map_image(const char* image, size_t size, bool borrow);
+    // Variable::save file of older stores
+    bool load_legacy(const std::string& path);
+    // the int32 type and the image of an index, rebuilt if the image is invalid
+    void load_index(const char* image, size_t size);
+    bool load_metadata(const char* image, size_t size);
+    void save_metadata(std::vector<char>& image) const;
+    // column `name` of `type` with a value slot per row, null if it has the other type
+    MetadataColumn* metadata_column(const std::string& name, MetadataColumn::Type type);
+    Bitset evaluate(const Filter::Node& node) const;
+    // search and search_batch with the store locked, hits are rows
+    std::vector<VectorHit> search_rows(const float* query, int topk, const SearchParams& params) const;
+    std::vector<std::vector<VectorHit>> search_batch_rows(const float* queries, size_t count, int topk, const SearchParams& params) const;
+    // rows kept by `filter` without the deleted ones, which may be put in `rows`, null if every row is kept
+    const Bitset* compile_rows(const Filter& filter, Bitset& rows) const;
+    std::string_view row_text(size_t row) const;
+    int64_t id_of(size_t row) const { return ids_.empty() ? static_cast<int64_t>(row) : ids_[row]; }
+    // row of `id`, Bitset::npos if it is not in the store
+    size_t row_of(int64_t id) const;
+    // ids_ and rows_ of the rows whose ids are still their rows
+    void materialize_ids();
+    // wake the compaction thread, which is started by the first request
+    void request_compaction();
+    // `mutex_` shared by a reader or held by a writer, which holds `write_mutex_` first
+    std::shared_lock<std::shared_mutex> read_lock() const;
+    std::unique_lock<std::shared_mutex> write_lock();
+private:
+    std::shared_ptr<Embedding> embedding_;
+    std::unique_ptr<VectorIndex> index_;
+    VectorMatrix vectors_;
+    // the first `mapped_texts_` texts are in the mapped file, the rest are owned
+    std::unique_ptr<MappedFile> mapped_;
+    const uint64_t* text_offsets_ = nullptr;
+    const char* text_blob_ = nullptr;
+    size_t text_blob_size_ = 0;
+    size_t mapped_texts_ = 0;
+    // row in the mapped file of a mapped text, empty while the rows are those of the file
+    std::vector<size_t> mapped_rows_;
+    std::vector<std::string> texts_;
+    std::map<std::string, MetadataColumn> columns_;
+    // id of every row, empty while the id of every row is the row
+    std::vector<int64_t> ids_;
+    // rows of the ids in ids_ not deleted
+    std::unordered_map<int64_t, size_t> rows_;
+    int64_t next_id_ = 0;
+    Bitset live_;
+    size_t deleted_ = 0;
+    int dim_ = 1024;
+    // readers share `mutex_`, writers hold `write_mutex_` and then `mutex_`,
+    // so a compaction holding `write_mutex_` while it reads the rows does not block readers
+    mutable std::shared_mutex mutex_;
+    std::mutex write_mutex_;
+    // passed by readers and held by a writer waiting for `mutex_`, so a stream of readers does not starve it
+    mutable std::mutex turnstile_;
+    std::thread compactor_;
+    std::mutex compact_mutex_;
+    std::condition_variable compact_cv_;
+    bool compact_pending_ = false;
+    bool compact_stop_ = false;
+};
+// TextVectorStore end
+
+#endif // VECTOR_STORE_hpp
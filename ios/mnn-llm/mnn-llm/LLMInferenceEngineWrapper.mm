@@ -44,7 +44,8 @@ const char* GetMainBundleDirectory() {
 - (void)processInput:(NSString *)input withStreamHandler:(StreamOutputHandler)handler {
     LlmStreamBuffer::CallBack callback = [handler](const char* str, size_t len) {
         if (handler) {
-            NSString *nsOutput = [NSString stringWithUTF8String:str];
+            // `str` is not null terminated, llm only streams complete utf-8 characters
+            NSString *nsOutput = [[NSString alloc] initWithBytes:str length:len encoding:NSUTF8StringEncoding];
             handler(nsOutput);
         }
     };
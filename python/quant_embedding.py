@@ -0,0 +1,65 @@
+
+import os
+import argparse
+
+import numpy as np
+
+# convert `embeddings_bf16.bin` to row-quantized disk embedding used by `USING_DISK_EMBED`
+#   int8: [fp32 scale][int8 x hidden_size] per row, value = q * scale
+#   int4: [fp32 scale][uint8 x ceil(hidden_size / 2)] per row, low nibble first, value = (q - 8) * scale
+
+def load_bf16(path, hidden_size):
+    raw = np.memmap(path, dtype=np.uint16, mode='r')
+    assert raw.size % hidden_size == 0, f'{path} size is not a multiple of hidden_size {hidden_size}'
+    return raw.reshape(-1, hidden_size)
+
+def bf16_to_fp32(rows):
+    return (rows.astype(np.uint32) << 16).view(np.float32)
+
+def quant_rows(rows, bits):
+    qmax = 127 if bits == 8 else 7
+    absmax = np.abs(rows).max(axis=1, keepdims=True)
+    scale = np.where(absmax > 0, absmax / qmax, 1.0).astype(np.float32)
+    q = np.clip(np.rint(rows / scale), -qmax - 1, qmax).astype(np.int32)
+    if bits == 8:
+        data = q.astype(np.int8).view(np.uint8)
+    else:
+        q = (q + 8).astype(np.uint8)
+        if q.shape[1] % 2:
+            q = np.pad(q, ((0, 0), (0, 1)), constant_values=8)
+        data = q[:, 0::2] | (q[:, 1::2] << 4)
+    return np.concatenate([scale.view(np.uint8), data], axis=1)
+
+def dequant_rows(packed, hidden_size, bits):
+    scale = packed[:, :4].copy().view(np.float32)
+    data = packed[:, 4:]
+    if bits == 8:
+        q = data.view(np.int8).astype(np.float32)
+    else:
+        q = np.empty((data.shape[0], data.shape[1] * 2), dtype=np.float32)
+        q[:, 0::2] = data & 0x0f
+        q[:, 1::2] = data >> 4
+        q = q[:, :hidden_size] - 8
+    return q * scale
+
+def convert(model_dir, hidden_size, bits, chunk):
+    src = os.path.join(model_dir, 'embeddings_bf16.bin')
+    dst = os.path.join(model_dir, f'embeddings_int{bits}.bin')
+    table = load_bf16(src, hidden_size)
+    err = 0.0
+    with open(dst, 'wb') as f:
+        for i in range(0, table.shape[0], chunk):
+            rows = bf16_to_fp32(np.asarray(table[i : i + chunk]))
+            packed = quant_rows(rows, bits)
+            f.write(packed.tobytes())
+            err = max(err, float(np.abs(dequant_rows(packed, hidden_size, bits) - rows).max()))
+    print(f'{src} -> {dst}: {table.shape[0]} rows, {os.path.getsize(src)} -> {os.path.getsize(dst)} bytes, max abs error {err:.6f}')
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='quantize disk embedding', formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('--model_dir', type=str, required=True, help='model dir which contains `embeddings_bf16.bin`.')
+    parser.add_argument('--hidden_size', type=int, required=True, help='hidden size of the model, eg: 4096 for qwen-7b.')
+    parser.add_argument('--bits', type=int, default=8, choices=[8, 4], help='quant bits, default is 8.')
+    parser.add_argument('--chunk', type=int, default=4096, help='rows converted per step, default is 4096.')
+    args = parser.parse_args()
+    convert(args.model_dir, args.hidden_size, args.bits, args.chunk)
@@ -0,0 +1,63 @@
+import base64
+import argparse
+import unicodedata
+
+import regex
+
+# reference ids of `Tiktoken` rank bpe, checked by `tiktoken_demo`
+#   ranks: tiktoken file, a base64 token per line, the rank is the line
+#   cases: `qwen|gpt2<TAB>text` then the ids, text escapes are \\ \t \n \r
+
+QWEN = r"(?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+"
+GPT2 = r"'s|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+"
+
+TEXTS = [
+    "Hello world! It's a test, we'll see: they're 12345 numbers and 3.14159.",
+    "你好，世界！这是一个测试。中文分词与BPE合并规则 2024年10月18日。",
+    "Ünïcödé café naïve résumé — “quotes” and 'single' ...",
+    " \t tabs\n\nnewlines\r\n  indented   code() {x=1;}\n",
+    "Русский текст и числа ١٢٣ ⅩⅡ ½ ² emoji 😀😃 done.",
+    "WE'LL SEE, IT'S THEY'RE I'M you'd I've",
+    "   leading and trailing spaces   ",
+    "a\n\n\n   b\r\n\r\nc",
+    "1234567890 007 3.0e-5",
+    "",
+]
+
+def bpe(piece, ranks):
+    if piece in ranks:
+        return [ranks[piece]]
+    parts = [bytes([b]) for b in piece]
+    while True:
+        # lowest rank pair first, the leftmost of equal ranks
+        best = None
+        for i in range(len(parts) - 1):
+            rank = ranks.get(parts[i] + parts[i + 1])
+            if rank is not None and (best is None or rank < best[0]):
+                best = (rank, i)
+        if best is None:
+            break
+        i = best[1]
+        parts[i:i + 2] = [parts[i] + parts[i + 1]]
+    return [ranks[p] for p in parts]
+
+def escape(text):
+    return text.replace('\\', '\\\\').replace('\t', '\\t').replace('\n', '\\n').replace('\r', '\\r')
+
+def main():
+    parser = argparse.ArgumentParser(description='reference ids of tiktoken rank bpe')
+    parser.add_argument('ranks', help='tiktoken ranks file')
+    parser.add_argument('cases', help='output cases file')
+    args = parser.parse_args()
+    with open(args.ranks) as f:
+        ranks = {base64.b64decode(line.strip()): i for i, line in enumerate(f) if line.strip()}
+    with open(args.cases, 'w', encoding='utf-8') as f:
+        f.write(f'# generated by python/tiktoken_cases.py, unicode {unicodedata.unidata_version}\n')
+        for name, pattern in (('qwen', QWEN), ('gpt2', GPT2)):
+            for text in TEXTS:
+                ids = [i for word in regex.findall(pattern, text) for i in bpe(word.encode(), ranks)]
+                f.write(f'{name}\t{escape(text)}\n')
+                f.write(' '.join(map(str, ids)) + '\n')
+
+if __name__ == '__main__':
+    main()
@@ -9,19 +9,26 @@
 #include <iostream>
 #include <fstream>
 #include <regex>
+#include <cstring>
+#include <algorithm>
 
 #include <MNN/expr/ExecutorScope.hpp>
 #include <MNN/AutoTime.hpp>
 #include "llm.hpp"
 #include "tokenizer.hpp"
 
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 #ifdef USING_VISUAL_MODEL
 #include "httplib.h"
 #include <cv/cv.hpp>
 #endif
 
 // Llm start
-Llm* Llm::createLLM(const std::string& path, std::string model_type) {
+LlmModel* LlmModel::create(const std::string& path, std::string model_type) {
     auto size = path.size();
 
     // end with '.mnn' is single model file, otherwise split block models
@@ -30,7 +37,7 @@ Llm* Llm::createLLM(const std::string& path, std::string model_type) {
                       path[size - 3] == 'm' &&
                       path[size - 2] == 'n' &&
                       path[size - 1] == 'n');
-    Llm* llm = nullptr;
+    LlmModel* llm = nullptr;
     if (model_type == "auto") {
         model_type = path;
     }
@@ -70,11 +77,65 @@ Llm* Llm::createLLM(const std::string& path, std::string model_type) {
         return llm;
     }
     llm->is_single_ = is_single;
+    llm->model_type_ = model_type;
     std::cout << "### model name : "<< llm->model_name_ << std::endl;
     return llm;
 }
 
-void Llm::chat() {
+Llm* Llm::createLLM(const std::string& path, std::string model_type) {
+    std::shared_ptr<LlmModel> model(LlmModel::create(path, model_type));
+    if (!model) {
+        return nullptr;
+    }
+    Llm* llm = new Llm;
+    llm->model_ = model;
+    return llm;
+}
+
+void Llm::load(const std::string& model_dir) {
+    model_->load(model_dir, config_);
+    // the default session runs the loaded modules, whose runtime keeps the cache
+    session_.reset(new LlmSession(model_, false));
+}
+
+LlmSession* Llm::create_session() const {
+    auto session = new LlmSession(model_);
+    // copy the configs of the default session
+    if (session_) {
+        session->max_seq_len_ = session_->max_seq_len_;
+        session->warmup_prefill_lens_ = session_->warmup_prefill_lens_;
+        session->warmup_decode_steps_ = session_->warmup_decode_steps_;
+        session->prefill_buckets_ = session_->prefill_buckets_;
+        session->static_kv_capacity_ = session_->static_kv_capacity_;
+    }
+    return session;
+}
+
+LlmSession::LlmSession(std::shared_ptr<const LlmModel> model, bool clone_modules) : model_(model), clone_modules_(clone_modules) {
+    // own executor and module clones sharing weights, so sessions can forward concurrently
+    executor_ = Executor::newExecutor(model_->backend_type_, model_->backend_config_, model_->thread_num_);
+    if (!clone_modules_) {
+        modules_ = model_->modules_;
+        visual_module_ = model_->visual_module_;
+        return;
+    }
+    ExecutorScope scope(executor_);
+    for (auto& module : model_->modules_) {
+        modules_.emplace_back(module ? Module::clone(module.get(), true) : nullptr);
+    }
+    if (model_->visual_module_) {
+        visual_module_.reset(Module::clone(model_->visual_module_.get(), true));
+    }
+}
+
+LlmSession::~LlmSession() {
+    modules_.clear();
+    visual_module_.reset();
+    past_key_values_.clear();
+    executor_.reset();
+}
+
+void LlmSession::chat() {
     while (true) {
         std::cout << "\nQ: ";
         std::string input_str;
@@ -94,25 +155,20 @@ void Llm::chat() {
     reset();
 }
 
-std::string Llm::response(const std::string& query, std::ostream* os, const char* end_with) {
+std::string LlmSession::response(const std::string& query, std::ostream* os, const char* end_with) {
     if (!end_with) {
         end_with = "\n";
     }
+    ExecutorScope scope(executor_);
     // init status
     gen_seq_len_ = 0;
     all_seq_len_ = 0;
     prefill_us_ = 0;
     decode_us_ = 0;
-    past_key_values_.clear();
-    if (is_single_) {
-        past_key_values_.push_back(_Input(key_value_shape_, NCHW));
-    } else {
-        for (int i = 0; i < layer_nums_; i++) {
-            past_key_values_.push_back(_Input(key_value_shape_, NCHW));
-        }
-    }
+    init_past_key_values();
     // response
-    auto input_ids = tokenizer(query);
+    auto input_ids = model_->tokenizer(*this, query);
+    query_len_ = static_cast<int>(input_ids.size());
     if (!history_.empty()) {
         std::copy(input_ids.begin(), input_ids.end(), std::back_inserter(history_));
         input_ids = history_;
@@ -124,34 +180,48 @@ std::string Llm::response(const std::string& query, std::ostream* os, const char
     auto st = std::chrono::system_clock::now();
     int token = forward(input_ids);
     auto et = std::chrono::system_clock::now();
+    if (token < 0) {
+        return "";
+    }
     history_.push_back(token);
-    std::string output_str = decode(token);
+    // stream only complete utf-8 characters
+    StreamDecoder stream(model_->tokenizer_.get());
+    std::string output_str(stream.put(token));
     prefill_us_ = std::chrono::duration_cast<std::chrono::microseconds>(et - st).count();
     *os << output_str << std::flush;
+    bool stopped = false;
     while (gen_seq_len_ < max_seq_len_) {
         st = std::chrono::system_clock::now();
         token = forward({token});
         et = std::chrono::system_clock::now();
         decode_us_ += std::chrono::duration_cast<std::chrono::microseconds>(et - st).count();
-        if (is_stop(token)) {
-            *os << end_with << std::flush;
+        if (token < 0 || model_->is_stop(token)) {
+            stopped = true;
             break;
         }
         history_.push_back(token);
-        auto word = decode(token);
-        *os << word << std::flush;
-        output_str += word;
+        auto word = stream.put(token);
+        if (!word.empty()) {
+            *os << word << std::flush;
+            output_str += word;
+        }
+    }
+    // held bytes are written whether the response stopped or reached max_seq_len_
+    auto rest = stream.flush();
+    output_str += rest;
+    *os << rest;
+    if (stopped) {
+        *os << end_with;
     }
+    *os << std::flush;
 #ifdef DUMP_PROFILE_INFO
     print_speed();
 #endif
-    // update Cache
-    // runtime_manager_->updateCache();
     // reset forward info
     return output_str;
 }
 
-void Llm::print_speed() {
+void LlmSession::print_speed() {
     auto prefill_s = prefill_us_ * 1e-6;
     auto decode_s = decode_us_ * 1e-6;
     auto total_s = prefill_s + decode_s;
@@ -169,37 +239,169 @@ void Llm::print_speed() {
     printf("##################################\n");
 }
 
-void Llm::reset() {
+void LlmSession::reset() {
     history_.clear();
 }
 
-void Llm::load(const std::string& model_dir) {
+void LlmSession::init_past_key_values() {
+    is_static_kv_ = false;
+    past_key_values_.clear();
+    if (model_->is_single_) {
+        past_key_values_.push_back(_Input(model_->key_value_shape_, NCHW));
+    } else {
+        for (int i = 0; i < model_->layer_nums_; i++) {
+            past_key_values_.push_back(_Input(model_->key_value_shape_, NCHW));
+        }
+    }
+}
+
+int LlmSession::kv_seq_axis() const {
+    const auto& key_value_shape = model_->key_value_shape_;
+    return std::find(key_value_shape.begin(), key_value_shape.end(), 0) - key_value_shape.begin();
+}
+
+// copy `len` slots along the seq axis from src[src_start:] to dst[dst_start:]
+static void copy_kv_slots(VARP dst, int dst_start, VARP src, int src_start, int len, int axis) {
+    auto dst_dims = dst->getInfo()->dim;
+    auto src_dims = src->getInfo()->dim;
+    size_t outer = 1, inner = 1;
+    for (int i = 0; i < axis; i++) {
+        outer *= dst_dims[i];
+    }
+    for (size_t i = axis + 1; i < dst_dims.size(); i++) {
+        inner *= dst_dims[i];
+    }
+    auto src_ptr = src->readMap<float>();
+    auto dst_ptr = dst->writeMap<float>();
+    for (size_t o = 0; o < outer; o++) {
+        ::memcpy(dst_ptr + (o * dst_dims[axis] + dst_start) * inner,
+                 src_ptr + (o * src_dims[axis] + src_start) * inner,
+                 len * inner * sizeof(float));
+    }
+}
+
+void LlmSession::to_static_past_key_values() {
+    // move the prompt kv into buffers of static_kv_capacity_ slots, slots after all_seq_len_ are masked
+    int axis = kv_seq_axis();
+    for (auto& past_key_value : past_key_values_) {
+        auto dims = past_key_value->getInfo()->dim;
+        dims[axis] = static_kv_capacity_;
+        auto kv = _Input(dims, NCHW);
+        // zero the unused slots, they are masked but must not be nan
+        ::memset(kv->writeMap<float>(), 0, kv->getInfo()->size * sizeof(float));
+        copy_kv_slots(kv, 0, past_key_value, 0, all_seq_len_, axis);
+        past_key_value = kv;
+    }
+    is_static_kv_ = true;
+}
+
+void LlmSession::to_dynamic_past_key_values() {
+    int axis = kv_seq_axis();
+    for (auto& past_key_value : past_key_values_) {
+        auto dims = past_key_value->getInfo()->dim;
+        dims[axis] = all_seq_len_;
+        auto kv = _Input(dims, NCHW);
+        copy_kv_slots(kv, 0, past_key_value, 0, all_seq_len_, axis);
+        past_key_value = kv;
+    }
+    is_static_kv_ = false;
+}
+
+VARP LlmModel::gen_static_attention_mask(int valid_len, int capacity) const {
+    // static kv slots and the current token, the current token is concated after the slots
+    auto attention_mask = _Input({1, 1, 1, capacity + 1}, NCHW, halide_type_of<float>());
+    auto ptr = attention_mask->writeMap<float>();
+    for (int i = 0; i < capacity + 1; i++) {
+        ptr[i] = (i >= valid_len && i < capacity) * std::numeric_limits<float>::lowest();
+    }
+    return attention_mask;
+}
+
+static std::string host_name() {
+#ifdef _WIN32
+    const char* name = getenv("COMPUTERNAME");
+    return name ? name : "localhost";
+#else
+    char name[256] = {0};
+    if (gethostname(name, sizeof(name) - 1) != 0) {
+        return "localhost";
+    }
+    return name;
+#endif
+}
+
+// fnv-1a 64, the name must be stable across builds and standard libraries
+static uint64_t fnv1a_64(const std::string& str) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : str) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// cache file name: {model_name}_{host}_{hash of model path and schedule config}.cache
+static std::string runtime_cache_name(const std::string& model_name, const std::string& model_dir, const ScheduleConfig& config) {
+    std::string key = model_dir + "#" + std::to_string(config.type) + "#" + std::to_string(config.numThread);
+    if (config.backendConfig) {
+        key += "#" + std::to_string(config.backendConfig->precision) + "#" + std::to_string(config.backendConfig->memory);
+    }
+    char hash[32];
+    snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(fnv1a_64(key)));
+    return model_name + "_" + host_name() + "_" + hash + ".cache";
+}
+
+// the binary tokenizer written by tokenizer_demo is mapped instead of parsing the text vocab,
+// unless the text vocab is newer than it
+static std::string tokenizer_file(const std::string& dir) {
+    std::string text_path = dir + "/tokenizer.txt";
+    std::string binary_path = dir + "/tokenizer.mtok";
+    struct stat text_stat, binary_stat;
+    if (::stat(binary_path.c_str(), &binary_stat) != 0) {
+        return text_path;
+    }
+    if (::stat(text_path.c_str(), &text_stat) == 0 && text_stat.st_mtime > binary_stat.st_mtime) {
+        MNN_PRINT("%s is older than %s, ignored\n", binary_path.c_str(), text_path.c_str());
+        return text_path;
+    }
+    return binary_path;
+}
+
+void LlmModel::load(const std::string& model_dir, const LlmConfig& llm_config) {
     model_dir_ = model_dir;
     // init
     ScheduleConfig config;
-    BackendConfig cpuBackendConfig;
+    BackendConfig& cpuBackendConfig = backend_config_;
     config.type          = MNN_FORWARD_CPU;
     // config.type          = MNN_FORWARD_OPENCL;
     config.numThread     = 4;
     cpuBackendConfig.precision = BackendConfig::Precision_Low;
     cpuBackendConfig.memory = BackendConfig::Memory_Low;
     config.backendConfig = &cpuBackendConfig;
+    backend_type_ = config.type;
+    thread_num_ = config.numThread;
     runtime_manager_.reset(Executor::RuntimeManager::createRuntimeManager(config));
-    if (config.type == MNN_FORWARD_OPENCL) {
-        const char* cacheFileName = ".tempcache";
-        // runtime_manager_->setCache(cacheFileName);
+    if (!llm_config.cache_dir.empty()) {
+        // tuning and shape info of this model on this host, reused across process restarts
+        cache_path_ = llm_config.cache_dir + "/" + runtime_cache_name(model_name_, model_dir, config);
+        runtime_manager_->setCache(cache_path_);
+        MNN_PRINT("runtime cache: %s\n", cache_path_.c_str());
     }
     load_progress_ = 0.f;
     printf("load tokenizer\n");
     // 1. load vocab
-    std::string tokenizer_path = model_dir + "/tokenizer.txt";
+    std::string tokenizer_path = tokenizer_file(model_dir);
     if (is_single_) {
         size_t pos = model_dir.find_last_of("/\\");
         std::string dir_path = (pos != std::string::npos) ? model_dir.substr(0, pos + 1) : "";
-        tokenizer_path = dir_path + "/tokenizer.txt";
+        tokenizer_path = tokenizer_file(dir_path);
     }
     load_progress_ += 5.f;
+    MNN_PRINT("load %s\n", tokenizer_path.c_str());
     tokenizer_->load(tokenizer_path);
+    if (llm_config.encode_cache_bytes > 0) {
+        encode_cache_.reset(new EncodeCache(llm_config.encode_cache_bytes));
+    }
     load_progress_ += 5.f;
     printf("load tokenizer Done\n");
     // 2. load model
@@ -235,6 +437,27 @@ void Llm::load(const std::string& model_dir) {
         modules_[layer_nums_ + 1].reset(Module::load({}, {}, embedding_model_path.c_str(), runtime_manager_, &module_config));
         MNN_PRINT("Done!\n");
         load_progress_ += step;
+#else
+        // the format of the config, or the smallest embedding file present: int4 > int8 > bf16
+        const std::pair<DiskEmbedType, const char*> embed_formats[] = {
+            {INT4, "int4"}, {INT8, "int8"}, {BF16, "bf16"}
+        };
+        for (const auto& embed_format : embed_formats) {
+            if (llm_config.disk_embed_format != "auto" && llm_config.disk_embed_format != embed_format.second) {
+                continue;
+            }
+            std::string embed_path = model_dir + "/embeddings_" + embed_format.second + ".bin";
+            if (std::ifstream(embed_path).good()) {
+                disk_embed_type_ = embed_format.first;
+                disk_embed_path_ = embed_path;
+                break;
+            }
+        }
+        if (disk_embed_path_.empty()) {
+            MNN_ERROR("Error: no %s disk embedding file in %s\n", llm_config.disk_embed_format.c_str(), model_dir.c_str());
+        } else {
+            MNN_PRINT("disk embedding: %s, format %s\n", disk_embed_path_.c_str(), llm_config.disk_embed_format.c_str());
+        }
 #endif
         if (is_visual_) {
             std::string visual_model_path = model_dir + "/visual.mnn";
@@ -260,115 +483,221 @@ void Llm::load(const std::string& model_dir) {
     }
 }
 
-void Llm::warmup() {
-    // warmup
+void LlmModel::update_cache() const {
+    if (!cache_path_.empty()) {
+        runtime_manager_->updateCache();
+    }
+}
+
+void LlmSession::warmup() {
+    // warmup every prefill length bucket and the decode steps after it
     MNN_PRINT("### warmup ... ");
-    if (is_single_) {
-        past_key_values_.push_back(_Input(key_value_shape_, NCHW));
-    } else {
-        for (int i = 0; i < layer_nums_; i++) {
-            past_key_values_.push_back(_Input(key_value_shape_, NCHW));
+    ExecutorScope scope(executor_);
+    for (int prefill_len : warmup_prefill_lens_) {
+        all_seq_len_ = 0;
+        gen_seq_len_ = 0;
+        init_past_key_values();
+        std::vector<int> tmp(std::max(prefill_len, 1), 0);
+        forward(tmp);
+        for (int i = 0; i < warmup_decode_steps_; i++) {
+            forward({0});
         }
     }
-    std::vector<int> tmp(1, 0);
-    forward(tmp);
+    past_key_values_.clear();
     all_seq_len_ = 0;
     gen_seq_len_ = 0;
+    // the model modules were tuned for every bucket, write the cache once rather than after every response
+    if (!clone_modules_) {
+        model_->update_cache();
+    }
     printf("Done\n");
 }
 
-int Llm::forward(const std::vector<int>& input_ids) {
+int LlmSession::prefill_bucket(int seq_len) {
+    // only split causal models can drop the padding before lm
+    if (prefill_buckets_.empty() || gen_seq_len_ > 0 || model_->is_single_ || !model_->is_causal_) {
+        return seq_len;
+    }
+    auto bucket = std::lower_bound(prefill_buckets_.begin(), prefill_buckets_.end(), seq_len);
+    if (bucket == prefill_buckets_.end()) {
+        return seq_len;
+    }
+    return *bucket;
+}
+
+int LlmSession::forward(const std::vector<int>& input_ids) {
+    int real_len = input_ids.size();
+    int seq_len = prefill_bucket(real_len);
+    if (seq_len > real_len) {
+        std::vector<int> padded_ids(input_ids);
+        padded_ids.resize(seq_len, 0);
+        return forward_padded(padded_ids, real_len);
+    }
+    return forward_padded(input_ids, real_len);
+}
+
+int LlmSession::forward_padded(const std::vector<int>& input_ids, int real_len) {
     int seq_len = input_ids.size();
+    if (is_static_kv_ && all_seq_len_ >= static_kv_capacity_) {
+        // capacity is used up, continue with growing kv
+        to_dynamic_past_key_values();
+    }
+    int axis = kv_seq_axis();
+    // write the new kv slot back to the static buffer instead of taking the presents
+    auto update_kv = [this, axis](VARP& past_key_value, VARP present) {
+        if (is_static_kv_) {
+            copy_kv_slots(past_key_value, all_seq_len_, present, static_kv_capacity_, 1, axis);
+        } else {
+            past_key_value = present;
+        }
+    };
     auto inputs_ids_ = _Const(input_ids.data(), {seq_len}, NCHW, halide_type_of<int>());
-    auto attention_mask = gen_attention_mask(seq_len);
-    auto position_ids = gen_position_ids(seq_len);
+    auto attention_mask = is_static_kv_ ? model_->gen_static_attention_mask(all_seq_len_, static_kv_capacity_)
+                                        : model_->gen_attention_mask(*this, seq_len);
+    auto position_ids = model_->gen_position_ids(*this, seq_len);
+    int layer_nums = model_->layer_nums_;
     int id = -1;
-    if (is_single_) {
+    if (model_->is_single_) {
         // single model
         auto outputs = modules_.back()->onForward({inputs_ids_, attention_mask, position_ids, past_key_values_[0]});
         id = outputs[0]->readMap<int>()[0];
-        past_key_values_[0] = outputs[1];
+        update_kv(past_key_values_[0], outputs[1]);
     } else {
         // split block models
         auto hidden_states = embedding(input_ids);
-        for (int i = 0; i < layer_nums_; i++) {
+        if (hidden_states == nullptr) {
+            return -1;
+        }
+        for (int i = 0; i < layer_nums; i++) {
             AUTOTIME;
             auto outputs = modules_[i]->onForward({hidden_states, attention_mask, position_ids, past_key_values_[i]});
             hidden_states = outputs[0];
-            past_key_values_[i] = outputs[1];
+            update_kv(past_key_values_[i], outputs[1]);
+        }
+        if (seq_len > real_len) {
+            // drop padding: lm reads the last real token, kv cache keeps the real tokens
+            std::vector<int> starts = {real_len - 1, 0, 0}, sizes = {1, -1, -1};
+            hidden_states = _Slice(hidden_states, _Const(starts.data(), {3}, NCHW, halide_type_of<int>()),
+                                   _Const(sizes.data(), {3}, NCHW, halide_type_of<int>()));
+            int dims = model_->key_value_shape_.size();
+            std::vector<int> kv_starts(dims, 0), kv_sizes(dims, -1);
+            kv_sizes[axis] = real_len;
+            auto kv_starts_var = _Const(kv_starts.data(), {dims}, NCHW, halide_type_of<int>());
+            auto kv_sizes_var = _Const(kv_sizes.data(), {dims}, NCHW, halide_type_of<int>());
+            for (int i = 0; i < layer_nums; i++) {
+                past_key_values_[i] = _Slice(past_key_values_[i], kv_starts_var, kv_sizes_var);
+            }
         }
         {
             AUTOTIME;
-            auto outputs = modules_[layer_nums_]->onForward({hidden_states});
+            auto outputs = modules_[layer_nums]->onForward({hidden_states});
             id = outputs[0]->readMap<int>()[0];
         }
 
     }
-    all_seq_len_ += seq_len;
+    all_seq_len_ += real_len;
     gen_seq_len_++;
+    if (!is_static_kv_ && gen_seq_len_ == 1 && all_seq_len_ < static_kv_capacity_) {
+        to_static_past_key_values();
+    }
     return id;
 }
 
-VARP Llm::txt_embedding(const std::vector<int>& input_ids) {
+VARP LlmSession::txt_embedding(const std::vector<int>& input_ids) {
 #ifndef USING_DISK_EMBED
     // using model forward
     auto inputs_ids_ = _Const(input_ids.data(), {static_cast<int>(input_ids.size())}, NCHW, halide_type_of<int>());
-    auto hidden_states = modules_[layer_nums_ + 1]->onForward({inputs_ids_})[0];
+    auto hidden_states = modules_[model_->layer_nums_ + 1]->onForward({inputs_ids_})[0];
     return hidden_states;
 #endif
     AUTOTIME;
     // disk embedding to save memory
     size_t seq_len = input_ids.size();
-    auto embedding = _Input({static_cast<int>(seq_len), 1, hidden_size_}, NCHW);
-    size_t size = hidden_size_ * sizeof(int16_t);
-    std::string file_path = model_dir_ + "/embeddings_bf16.bin";
-    FILE* file = fopen(file_path.c_str(), "rb");
-    std::unique_ptr<int16_t[]> buffer(new int16_t[hidden_size_]);
+    int hidden_size = model_->hidden_size_;
+    auto embedding = _Input({static_cast<int>(seq_len), 1, hidden_size}, NCHW);
+    size_t size = hidden_size * sizeof(int16_t);
+    auto disk_embed_type = model_->disk_embed_type_;
+    if (disk_embed_type == LlmModel::INT8) {
+        size = sizeof(float) + hidden_size;
+    } else if (disk_embed_type == LlmModel::INT4) {
+        size = sizeof(float) + (hidden_size + 1) / 2;
+    }
+    FILE* file = fopen(model_->disk_embed_path_.c_str(), "rb");
+    if (file == nullptr) {
+        MNN_ERROR("Error: can't open disk embedding file %s\n", model_->disk_embed_path_.c_str());
+        return nullptr;
+    }
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+    auto dst = embedding->writeMap<float>();
     for (size_t i = 0; i < seq_len; i++) {
-        fseek(file, input_ids[i] * size, SEEK_SET);
-        fread(buffer.get(), 1, size, file);
-        auto ptr = embedding->writeMap<int16_t>() + i * hidden_size_ * 2;
-        for (int j = 0; j < hidden_size_; j++) {
-            ptr[j * 2] = 0;
-            ptr[j * 2 + 1] = buffer[j];
+        // a row past the end of the file is zero
+        if (fseek(file, static_cast<long>(input_ids[i] * size), SEEK_SET) != 0 || fread(buffer.get(), 1, size, file) != size) {
+            ::memset(buffer.get(), 0, size);
+        }
+        auto ptr = dst + i * hidden_size;
+        if (disk_embed_type == LlmModel::BF16) {
+            // bf16 is the high half of fp32
+            auto src = reinterpret_cast<const uint16_t*>(buffer.get());
+            auto out = reinterpret_cast<uint32_t*>(ptr);
+            for (int j = 0; j < hidden_size; j++) {
+                out[j] = static_cast<uint32_t>(src[j]) << 16;
+            }
+            continue;
+        }
+        float scale;
+        ::memcpy(&scale, buffer.get(), sizeof(float));
+        auto src = buffer.get() + sizeof(float);
+        if (disk_embed_type == LlmModel::INT8) {
+            auto qsrc = reinterpret_cast<const int8_t*>(src);
+            for (int j = 0; j < hidden_size; j++) {
+                ptr[j] = qsrc[j] * scale;
+            }
+        } else {
+            // int4 is stored as unsigned nibble with zero point 8
+            for (int j = 0; j < hidden_size; j++) {
+                int q = (j & 1) ? (src[j / 2] >> 4) : (src[j / 2] & 0x0f);
+                ptr[j] = (q - 8) * scale;
+            }
         }
     }
     fclose(file);
     return embedding;
 }
 
-VARP Llm::embedding(const std::vector<int>& input_ids) {
-    if (is_visual_ && !gen_seq_len_) {
-        return visual_embedding(input_ids);
+VARP LlmSession::embedding(const std::vector<int>& input_ids) {
+    if (model_->is_visual_ && !gen_seq_len_) {
+        return model_->visual_embedding(input_ids, visual_module_.get(), [this](const std::vector<int>& ids) {
+            return txt_embedding(ids);
+        });
     }
     return txt_embedding(input_ids);
 }
 
-std::vector<int> Llm::tokenizer_encode(const std::string& input_str) {
-    auto ids = tokenizer_->encode(input_str);
-    return ids;
+std::vector<int> LlmModel::tokenizer_encode(const std::string& input_str) const {
+    return tokenizer_encode(std::vector<std::string_view>{input_str});
 }
 
-std::string Llm::decode(int id) {
-    std::string word = tokenizer_->decode(id);
-    // Fix utf-8 garbled characters
-    if (word.length() == 6 && word[0] == '<' && word[word.length()-1] == '>' && word[1] == '0' && word[2] == 'x') {
-        int num = std::stoi(word.substr(3, 2), nullptr, 16);
-        word = static_cast<char>(num);
-    }
-    return word;
+std::vector<int> LlmModel::tokenizer_encode(const std::vector<std::string_view>& segments) const {
+    return tokenizer_->encode(segments, encode_cache_.get());
+}
+
+size_t LlmModel::token_count(const std::string& text) const {
+    return tokenizer_->count(text);
+}
+
+size_t LlmModel::max_token_count(const std::string& text) const {
+    return tokenizer_->max_count(text);
 }
 
 // Chatglm_6b
-std::vector<int> Chatglm_6b::tokenizer(const std::string& query) {
+std::vector<int> Chatglm_6b::tokenizer(const LlmSession& session, const std::string& query) const {
     auto ids = tokenizer_encode(query);
-    context_len_ = ids.size();
     ids.push_back(130001);
     ids.push_back(130004);
     return ids;
 }
 
-VARP Chatglm_6b::gen_attention_mask(int seq_len) {
+VARP Chatglm_6b::gen_attention_mask(const LlmSession& session, int seq_len) const {
     auto attention_mask = _Input({1, 1, seq_len, seq_len}, NCHW, halide_type_of<int>());
     auto ptr = attention_mask->writeMap<int>();
     for (int i = 0; i < seq_len * seq_len; i++) {
@@ -382,12 +711,23 @@ VARP Chatglm_6b::gen_attention_mask(int seq_len) {
     return attention_mask;
 }
 
-VARP Chatglm_6b::gen_position_ids(int seq_len) {
+VARP Chatglm_6b::gen_static_attention_mask(int valid_len, int capacity) const {
+    auto attention_mask = _Input({1, 1, 1, capacity + 1}, NCHW, halide_type_of<int>());
+    auto ptr = attention_mask->writeMap<int>();
+    for (int i = 0; i < capacity + 1; i++) {
+        ptr[i] = i >= valid_len && i < capacity;
+    }
+    return attention_mask;
+}
+
+VARP Chatglm_6b::gen_position_ids(const LlmSession& session, int seq_len) const {
     auto position_ids = _Input({1, 2, seq_len}, NCHW, halide_type_of<int>());
     auto ptr = position_ids->writeMap<int>();
     if (seq_len == 1) {
+        // context is the query without the gmask and bos appended by `tokenizer`
+        int context_len = std::max(session.query_len() - 2, 0);
         ptr[0] = 1;
-        ptr[1] = all_seq_len_ - context_len_;
+        ptr[1] = session.all_seq_len() - context_len;
     } else {
         for (int i = 0; i < seq_len; i++) {
             ptr[i] = i;
@@ -398,22 +738,22 @@ VARP Chatglm_6b::gen_position_ids(int seq_len) {
     return position_ids;
 }
 
-bool Chatglm_6b::is_stop(int token_id) {
+bool Chatglm_6b::is_stop(int token_id) const {
     return token_id == 130005;
 }
 
 // Chatglm2_6b
-std::vector<int> Chatglm2_6b::tokenizer(const std::string& query) {
-    auto prompt = "问：" + query + "\n答：";
-    auto ids = tokenizer_encode(prompt);
-    if (history_.empty()) {
+std::vector<int> Chatglm2_6b::tokenizer(const LlmSession& session, const std::string& query) const {
+    // "问：" + query + "\n答："
+    auto ids = tokenizer_encode({"问：", query, "\n答："});
+    if (session.history().empty()) {
         ids.insert(ids.begin(), 64792);
         ids.insert(ids.begin(), 64790);
     }
     return ids;
 }
 
-VARP Chatglm2_6b::gen_attention_mask(int seq_len) {
+VARP Chatglm2_6b::gen_attention_mask(const LlmSession& session, int seq_len) const {
     auto attention_mask = _Input({1, 1, seq_len, seq_len}, NCHW, halide_type_of<int>());
     auto ptr = attention_mask->writeMap<int>();
     if (seq_len > 1) {
@@ -428,11 +768,20 @@ VARP Chatglm2_6b::gen_attention_mask(int seq_len) {
     return attention_mask;
 }
 
-VARP Chatglm2_6b::gen_position_ids(int seq_len) {
+VARP Chatglm2_6b::gen_static_attention_mask(int valid_len, int capacity) const {
+    auto attention_mask = _Input({1, 1, 1, capacity + 1}, NCHW, halide_type_of<int>());
+    auto ptr = attention_mask->writeMap<int>();
+    for (int i = 0; i < capacity + 1; i++) {
+        ptr[i] = i >= valid_len && i < capacity;
+    }
+    return attention_mask;
+}
+
+VARP Chatglm2_6b::gen_position_ids(const LlmSession& session, int seq_len) const {
     auto position_ids = _Input({seq_len}, NCHW, halide_type_of<int>());
     auto ptr = position_ids->writeMap<int>();
     if (seq_len == 1) {
-        ptr[0] = gen_seq_len_;
+        ptr[0] = session.gen_seq_len();
     } else {
         for (int i = 0; i < seq_len; i++) {
             ptr[i] = i;
@@ -441,23 +790,23 @@ VARP Chatglm2_6b::gen_position_ids(int seq_len) {
     return position_ids;
 }
 
-bool Chatglm2_6b::is_stop(int token_id) {
+bool Chatglm2_6b::is_stop(int token_id) const {
     return token_id <= 2;
 }
 
 // Phi_2
-std::vector<int> Phi_2::tokenizer(const std::string& query) {
+std::vector<int> Phi_2::tokenizer(const LlmSession& session, const std::string& query) const {
     auto prompt = query;
     auto ids = tokenizer_encode(prompt);
     return ids;
 }
 
-bool Phi_2::is_stop(int token_id) {
+bool Phi_2::is_stop(int token_id) const {
     return token_id == 50256;
 }
 
 // Qwen_7b
-std::vector<int> Qwen_7b::tokenizer(const std::string& query) {
+std::vector<int> Qwen_7b::tokenizer(const LlmSession& session, const std::string& query) const {
     auto ids = tokenizer_encode(query);
     // auto prompt = "\n<|im_start|>user\n" + query + "<|im_end|>\n<|im_start|>assistant\n";
     ids.insert(ids.begin(), {198, 151644, 872, 198});
@@ -465,7 +814,7 @@ std::vector<int> Qwen_7b::tokenizer(const std::string& query) {
     return ids;
 }
 
-VARP Qwen_7b::gen_attention_mask(int seq_len) {
+VARP Qwen_7b::gen_attention_mask(const LlmSession& session, int seq_len) const {
     auto attention_mask = _Input({1, 1, seq_len, seq_len}, NCHW, halide_type_of<int>());
     auto ptr = attention_mask->writeMap<int>();
     for (int i = 0; i < seq_len; i++) {
@@ -476,11 +825,20 @@ VARP Qwen_7b::gen_attention_mask(int seq_len) {
     return attention_mask;
 }
 
-VARP Qwen_7b::gen_position_ids(int seq_len) {
+VARP Qwen_7b::gen_static_attention_mask(int valid_len, int capacity) const {
+    auto attention_mask = _Input({1, 1, 1, capacity + 1}, NCHW, halide_type_of<int>());
+    auto ptr = attention_mask->writeMap<int>();
+    for (int i = 0; i < capacity + 1; i++) {
+        ptr[i] = i < valid_len || i == capacity;
+    }
+    return attention_mask;
+}
+
+VARP Qwen_7b::gen_position_ids(const LlmSession& session, int seq_len) const {
     auto position_ids = _Input({seq_len}, NCHW, halide_type_of<int>());
     auto ptr = position_ids->writeMap<int>();
     if (seq_len == 1) {
-        ptr[0] = all_seq_len_;
+        ptr[0] = session.all_seq_len();
     } else {
         for (int i = 0; i < seq_len; i++) {
             ptr[i] = i;
@@ -489,12 +847,12 @@ VARP Qwen_7b::gen_position_ids(int seq_len) {
     return position_ids;
 }
 
-bool Qwen_7b::is_stop(int token_id) {
+bool Qwen_7b::is_stop(int token_id) const {
     return token_id >= 151645;
 }
 
 // Qwen_vl
-std::vector<int> Qwen_vl::url_encode(const std::string& url) {
+std::vector<int> Qwen_vl::url_encode(const std::string& url) const {
     std::vector<int> ascii_values(imgpad_len_, img_pad_);
     ascii_values[0] = img_start_;
     ascii_values[imgpad_len_ - 1] = img_end_;
@@ -504,7 +862,8 @@ std::vector<int> Qwen_vl::url_encode(const std::string& url) {
     return ascii_values;
 }
 
-VARP Qwen_vl::visual_embedding(const std::vector<int>& input_ids) {
+VARP Qwen_vl::visual_embedding(const std::vector<int>& input_ids, Module* visual_module,
+                               const std::function<VARP(const std::vector<int>&)>& txt_embedding) const {
 #ifdef USING_VISUAL_MODEL
     int start_pos = 0, pad_pos = 0, end_pos = 0;
     for (int i = 0; i < input_ids.size(); i++) {
@@ -564,10 +923,13 @@ VARP Qwen_vl::visual_embedding(const std::vector<int>& input_ids) {
                             {123.25239296, 117.20384, 104.50194688}, {0.0145414 , 0.01494914, 0.01416452});
     image = MNN::Express::_Unsqueeze(image, {0});
     image = MNN::Express::_Convert(image, NC4HW4);
-    auto image_embedding = visual_module_->forward(image);
+    auto image_embedding = visual_module->forward(image);
     image_embedding = MNN::Express::_Permute(image_embedding, {1, 0, 2});
     auto prefix_embedding = txt_embedding(prefix);
     auto suffix_embedding = txt_embedding(suffix);
+    if (prefix_embedding == nullptr || suffix_embedding == nullptr) {
+        return nullptr;
+    }
     auto embeddings = MNN::Express::_Concat({prefix_embedding, image_embedding, suffix_embedding}, 0);
 #else
     auto embeddings = txt_embedding(input_ids);
@@ -575,7 +937,7 @@ VARP Qwen_vl::visual_embedding(const std::vector<int>& input_ids) {
     return embeddings;
 }
 
-std::vector<int> Qwen_vl::tokenizer(const std::string& query) {
+std::vector<int> Qwen_vl::tokenizer(const LlmSession& session, const std::string& query) const {
     // split query
     std::regex img_regex("<img>(.*?)</img>");
     std::string::const_iterator searchStart(query.cbegin());
@@ -599,11 +961,11 @@ std::vector<int> Qwen_vl::tokenizer(const std::string& query) {
     return ids;
 }
 
-VARP Qwen_vl::gen_attention_mask(int seq_len) {
+VARP Qwen_vl::gen_attention_mask(const LlmSession& session, int seq_len) const {
     if (seq_len == 1) {
-        auto attention_mask = _Input({1, 1, 1, all_seq_len_ + 1}, NCHW, halide_type_of<float>());
+        auto attention_mask = _Input({1, 1, 1, session.all_seq_len() + 1}, NCHW, halide_type_of<float>());
         auto ptr = attention_mask->writeMap<float>();
-        for (int i = 0; i < all_seq_len_ + 1; i++) {
+        for (int i = 0; i < session.all_seq_len() + 1; i++) {
             ptr[i] = 0;
         }
         return attention_mask;
@@ -619,8 +981,12 @@ VARP Qwen_vl::gen_attention_mask(int seq_len) {
     }
 }
 
+VARP Qwen_vl::gen_static_attention_mask(int valid_len, int capacity) const {
+    return LlmModel::gen_static_attention_mask(valid_len, capacity);
+}
+
 // Llama2_7b
-std::vector<int> Llama2_7b::tokenizer(const std::string& query) {
+std::vector<int> Llama2_7b::tokenizer(const LlmSession& session, const std::string& query) const {
     auto ids = tokenizer_encode(query);
     if (model_name_ == "Baichuan2_7b") {
         // baichuan2: <reserved_106>{query}<reserved_107>: 195, query, 196
@@ -641,11 +1007,11 @@ std::vector<int> Llama2_7b::tokenizer(const std::string& query) {
     return ids;
 }
 
-VARP Llama2_7b::gen_attention_mask(int seq_len) {
+VARP Llama2_7b::gen_attention_mask(const LlmSession& session, int seq_len) const {
     if (seq_len == 1) {
-        auto attention_mask = _Input({1, 1, 1, all_seq_len_ + 1}, NCHW, halide_type_of<float>());
+        auto attention_mask = _Input({1, 1, 1, session.all_seq_len() + 1}, NCHW, halide_type_of<float>());
         auto ptr = attention_mask->writeMap<float>();
-        for (int i = 0; i < all_seq_len_ + 1; i++) {
+        for (int i = 0; i < session.all_seq_len() + 1; i++) {
             ptr[i] = 0;
         }
         return attention_mask;
@@ -661,11 +1027,11 @@ VARP Llama2_7b::gen_attention_mask(int seq_len) {
     }
 }
 
-VARP Llama2_7b::gen_position_ids(int seq_len) {
+VARP Llama2_7b::gen_position_ids(const LlmSession& session, int seq_len) const {
     auto position_ids = _Input({1, seq_len}, NCHW, halide_type_of<int>());
     auto ptr = position_ids->writeMap<int>();
     if (seq_len == 1) {
-        ptr[0] = all_seq_len_;
+        ptr[0] = session.all_seq_len();
     } else {
         for (int i = 0; i < seq_len; i++) {
             ptr[i] = i;
@@ -674,7 +1040,7 @@ VARP Llama2_7b::gen_position_ids(int seq_len) {
     return position_ids;
 }
 
-bool Llama2_7b::is_stop(int token_id) {
+bool Llama2_7b::is_stop(int token_id) const {
     if (model_name_ == "Internlm_7b") {
         // 103028: <eoa>
         return token_id == 2 || token_id == 103028;
@@ -724,7 +1090,8 @@ void Embedding::load(const std::string& model_dir) {
     // 1. load vocab
     size_t pos = model_dir.find_last_of("/\\");
     std::string dir_path = (pos != std::string::npos) ? model_dir.substr(0, pos + 1) : "";
-    std::string tokenizer_path = dir_path + "/tokenizer.txt";
+    std::string tokenizer_path = tokenizer_file(dir_path);
+    MNN_PRINT("load %s\n", tokenizer_path.c_str());
     tokenizer_->load(tokenizer_path);
     printf("load tokenizer Done\n");
     // 2. load model
@@ -742,14 +1109,40 @@ void Embedding::load(const std::string& model_dir) {
 VARP Embedding::embedding(const std::string& txt) {
     auto ids = tokenizer(txt);
     prompt_len_ = ids.size();
-    auto inputs_ids = _Const(ids.data(), {prompt_len_}, NCHW, halide_type_of<int>());
-    auto attention_mask = gen_attention_mask(prompt_len_);
-    auto position_ids = gen_position_ids(prompt_len_);
+    return forward(ids);
+}
+
+std::vector<VARP> Embedding::embedding(const std::vector<std::string>& txts) {
+    auto batch = tokenizer(txts);
+    std::vector<VARP> embeddings;
+    embeddings.reserve(batch.size());
+    prompt_len_ = 0;
+    for (const auto& ids : batch) {
+        prompt_len_ += ids.size();
+        embeddings.push_back(forward(ids));
+    }
+    return embeddings;
+}
+
+VARP Embedding::forward(const std::vector<int>& ids) {
+    int seq_len = ids.size();
+    auto inputs_ids = _Const(ids.data(), {seq_len}, NCHW, halide_type_of<int>());
+    auto attention_mask = gen_attention_mask(seq_len);
+    auto position_ids = gen_position_ids(seq_len);
     auto outputs = module_->onForward({inputs_ids, attention_mask, position_ids});
     auto sentence_embeddings = outputs[0];
     return sentence_embeddings;
 }
 
+std::vector<std::vector<int>> Embedding::tokenizer(const std::vector<std::string>& queries) {
+    std::vector<std::vector<int>> batch;
+    batch.reserve(queries.size());
+    for (const auto& query : queries) {
+        batch.push_back(tokenizer(query));
+    }
+    return batch;
+}
+
 void Embedding::print_speed() {
     auto total_s = embedding_us_ * 1e-6;
     printf("\n#################################\n");
@@ -764,6 +1157,11 @@ std::vector<int> Embedding::tokenizer_encode(const std::string& input_str) {
     return ids;
 }
 
+std::vector<std::vector<int>> Embedding::tokenizer_encode(const std::vector<std::string>& input_strs) {
+    std::vector<std::string_view> texts(input_strs.begin(), input_strs.end());
+    return tokenizer_->encode_batch(texts);
+}
+
 std::vector<int> Bge::tokenizer(const std::string& query) {
     auto ids = tokenizer_encode(query);
     ids.insert(ids.begin(), 101);
@@ -771,6 +1169,15 @@ std::vector<int> Bge::tokenizer(const std::string& query) {
     return ids;
 }
 
+std::vector<std::vector<int>> Bge::tokenizer(const std::vector<std::string>& queries) {
+    auto batch = tokenizer_encode(queries);
+    for (auto& ids : batch) {
+        ids.insert(ids.begin(), 101);
+        ids.push_back(102);
+    }
+    return batch;
+}
+
 VARP Bge::gen_attention_mask(int seq_len) {
     auto attention_mask = _Input({1, 1, 1, seq_len}, NCHW, halide_type_of<int>());
     auto ptr = attention_mask->writeMap<int>();
@@ -789,91 +1196,3 @@ VARP Bge::gen_position_ids(int seq_len) {
     return position_ids;
 }
 // Embedding end
-
-// TextVectorStore strat
-TextVectorStore* TextVectorStore::load(const std::string& path) {
-    auto vars = Variable::load(path.c_str());
-    if (vars.size() < 2) {
-        return nullptr;
-    }
-    TextVectorStore* store = new TextVectorStore;
-    store->vectors_ = vars[0];
-    for (int i = 1; i < vars.size(); i++) {
-        const char* txt = vars[i]->readMap<char>();
-        store->texts_.push_back(txt);
-    }
-    return store;
-}
-
-void TextVectorStore::save(const std::string& path) {
-    std::vector<VARP> vars;
-    vars.push_back(vectors_);
-    for (auto text : texts_) {
-        auto text_var = _Const(text.data(), {text.size()}, NHWC, halide_type_of<int8_t>());
-        vars.push_back(text_var);
-    }
-    Variable::save(vars, path.c_str());
-}
-
-void TextVectorStore::add_text(const std::string& text) {
-    auto vector = text2vector(text);
-    texts_.push_back(text);
-    if (vectors_ == nullptr) {
-        vectors_ = vector;
-    } else {
-        vectors_ = _Concat({vectors_, vector}, 0);
-    }
-    vectors_.fix(VARP::CONSTANT);
-}
-
-void TextVectorStore::add_texts(const std::vector<std::string>& texts) {
-    for (const auto& text : texts) {
-        add_text(text);
-    }
-}
-
-std::vector<std::string> TextVectorStore::search_similar_texts(const std::string& text, int topk) {
-    auto vector = text2vector(text);
-    auto dist = _Sqrt(_ReduceSum(_Square(vectors_ - vector), {-1}));
-    auto indices = _Sort(dist, 0, true);
-    // auto ptr = dist->readMap<float>();
-    auto idx_ptr = indices->readMap<int>();
-    std::vector<std::string> res;
-    for (int i = 0; i < topk; i++) {
-        int pos = idx_ptr[i];
-        if (pos >= 0 && pos < texts_.size()) {
-            res.push_back(texts_[pos]);
-        }
-    }
-    return res;
-}
-
-void TextVectorStore::bench() {
-    const int n = 50000;
-    const int d = 1024;
-    std::vector<int> shape0_v = {n, d};
-    std::vector<int> shape1_v = {1, d};
-    auto shape0 = _Const(shape0_v.data(), {2});
-    auto shape1 = _Const(shape1_v.data(), {2});
-    vectors_ = _RandomUnifom(shape0, halide_type_of<float>());
-    auto vec = _RandomUnifom(shape1, halide_type_of<float>());
-    auto start = std::chrono::high_resolution_clock::now();
-    auto dist = _Sqrt(_ReduceSum(_Square(vectors_ - vec), {-1}));
-    auto indices = _Sort(dist, 0, true);
-    auto ptr = dist->readMap<float>();
-    auto iptr = indices->readMap<int>();
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    std::cout << "search took " << duration.count() << " milliseconds." << std::endl;
-    for (int i = 0; i < 5; i++) {
-        printf("index: %d, distance: %f\n", iptr[i], ptr[iptr[i]]);
-    }
-    vectors_ = nullptr;
-}
-
-VARP TextVectorStore::text2vector(const std::string& text) {
-    auto vector = embedding_->embedding(text);
-    return vector;
-}
-
-// TextVectorStore end
\ No newline at end of file
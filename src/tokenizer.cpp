@@ -6,11 +6,25 @@
 //
 
 #include "tokenizer.hpp"
+#include "thread_pool.hpp"
 #include <fstream>
 #include <sstream>
 #include <queue>
 #include <functional>
 #include <random>
+#include <algorithm>
+#include <mutex>
+#include <cstring>
+#include <limits>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // base64
 static const std::string base64_chars =
@@ -66,40 +80,695 @@ static std::string base64_decode(const std::string& str) {
     return ret;
 }
 
-bool Sentencepiece::load(const std::string& filename) {
+// binary image of tokenizer, arrays are in host byte order
+static const char kImageMagic[4] = {'M', 'T', 'O', 'K'};
+static const uint32_t kImageVersion = 3;
+
+struct ImageHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t vocab_size;
+    uint32_t blob_size;
+    uint32_t reserved[3];
+};
+
+// sections are padded to 8 bytes, so every array of a mapped image is aligned
+template <typename T>
+static void append_section(std::vector<char>& image, const T* data, size_t count) {
+    const char* bytes = reinterpret_cast<const char*>(data);
+    image.insert(image.end(), bytes, bytes + count * sizeof(T));
+    image.resize((image.size() + 7) / 8 * 8, 0);
+}
+
+template <typename T>
+static const T* view_section(const char* image, size_t size, size_t& offset, size_t count) {
+    size_t bytes = (count * sizeof(T) + 7) / 8 * 8;
+    if (offset > size || bytes > size - offset) {
+        return nullptr;
+    }
+    auto data = reinterpret_cast<const T*>(image + offset);
+    offset += bytes;
+    return data;
+}
+
+// string table: uint32 offsets[count + 1] and the blob, string i is blob[offsets[i], offsets[i + 1])
+static void append_table(std::vector<char>& image, const std::vector<std::string>& strs) {
+    std::vector<uint32_t> offsets(1, 0);
+    offsets.reserve(strs.size() + 1);
+    std::string blob;
+    for (const auto& str : strs) {
+        blob += str;
+        offsets.push_back(static_cast<uint32_t>(blob.size()));
+    }
+    append_section(image, offsets.data(), offsets.size());
+    append_section(image, blob.data(), blob.size());
+}
+
+static bool view_table(const char* image, size_t size, size_t& offset, size_t count, const uint32_t** offsets, const char** blob) {
+    *offsets = view_section<uint32_t>(image, size, offset, count + 1);
+    *blob = *offsets ? view_section<char>(image, size, offset, (*offsets)[count]) : nullptr;
+    return *blob != nullptr;
+}
+
+MappedFile::MappedFile(const std::string& filename) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return;
+    }
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const char*>(data);
+    size_ = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            data_ = static_cast<const char*>(data);
+            size_ = static_cast<size_t>(st.st_size);
+        }
+    }
+    // the mapping keeps the file referenced
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    if (data_ == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+#else
+    ::munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+bool Tokenizer::load(const std::string& filename) {
+    ImageHeader header;
+    bool binary = false;
+    {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.good()) {
+            std::cerr << "Error: can't open tokenizer file " << filename << std::endl;
+            return false;
+        }
+        binary = file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+                 !::memcmp(header.magic, kImageMagic, sizeof(kImageMagic));
+    }
+    if (binary && header.version != kImageVersion) {
+        std::cerr << "Error: tokenizer version " << header.version << " of " << filename << " is not " << kImageVersion << ", please convert it again" << std::endl;
+        return false;
+    }
+    mapped_.reset();
+    image_.clear();
+    if (binary) {
+        mapped_.reset(new MappedFile(filename));
+        if (mapped_->valid()) {
+            return map_image(mapped_->data(), mapped_->size());
+        }
+        // no mmap, read the image instead
+        mapped_.reset();
+        std::ifstream file(filename, std::ios::binary);
+        image_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else if (!load_text(filename, image_)) {
+        return false;
+    }
+    return map_image(image_.data(), image_.size());
+}
+
+bool Tokenizer::save(const std::string& filename) const {
+    if (image_data_ == nullptr) {
+        std::cerr << "Error: tokenizer is not loaded" << std::endl;
+        return false;
+    }
+    std::ofstream file(filename, std::ios::binary);
+    file.write(image_data_, image_size_);
+    return file.good();
+}
+
+void Tokenizer::write_tokens(const std::vector<std::string>& tokens, std::vector<char>& image) const {
+    size_t blob_size = 0;
+    for (const auto& token : tokens) {
+        blob_size += token.size();
+    }
+    ImageHeader header;
+    ::memset(&header, 0, sizeof(header));
+    ::memcpy(header.magic, kImageMagic, sizeof(kImageMagic));
+    header.version = kImageVersion;
+    header.kind = kind();
+    header.vocab_size = static_cast<uint32_t>(tokens.size());
+    header.blob_size = static_cast<uint32_t>(blob_size);
+    image.clear();
+    append_section(image, &header, 1);
+    append_table(image, tokens);
+}
+
+bool Tokenizer::map_image(const char* image, size_t size) {
+    size_t offset = 0;
+    auto header = view_section<ImageHeader>(image, size, offset, 1);
+    if (header == nullptr || ::memcmp(header->magic, kImageMagic, sizeof(kImageMagic)) || header->version != kImageVersion) {
+        std::cerr << "Error: invalid tokenizer image" << std::endl;
+        return false;
+    }
+    if (header->kind != kind()) {
+        std::cerr << "Error: tokenizer image kind " << header->kind << " mismatch " << kind() << std::endl;
+        return false;
+    }
+    vocab_size_ = header->vocab_size;
+    bool valid = view_table(image, size, offset, vocab_size_, &offsets_, &blob_) && offsets_[vocab_size_] == header->blob_size;
+    decode_offsets_ = offsets_;
+    decode_blob_ = blob_;
+    if (!valid || !map(image, size, offset)) {
+        std::cerr << "Error: truncated tokenizer image" << std::endl;
+        vocab_size_ = 0;
+        return false;
+    }
+    max_token_len_ = 0;
+    for (int i = 0; i < vocab_size_; i++) {
+        max_token_len_ = std::max<size_t>(max_token_len_, offsets_[i + 1] - offsets_[i]);
+    }
+    image_data_ = image;
+    image_size_ = size;
+    return true;
+}
+
+// long texts are split into parts of about kSplitSize bytes for the threads
+static const size_t kSplitSize = 16 * 1024;
+
+std::vector<int> Tokenizer::encode(const std::string& str) {
+    if (str.size() < 2 * kSplitSize) {
+        std::vector<int> ids;
+        IdSink sink(&ids);
+        encode_text(str, sink);
+        return ids;
+    }
+    return std::move(encode_batch({str})[0]);
+}
+
+std::vector<std::vector<int>> Tokenizer::encode_batch(const std::vector<std::string_view>& texts) {
+    struct Part {
+        size_t text;
+        std::string_view str;
+    };
+    std::vector<Part> parts;
+    parts.reserve(texts.size());
+    for (size_t i = 0; i < texts.size(); i++) {
+        size_t begin = 0;
+        if (texts[i].size() >= 2 * kSplitSize) {
+            for (size_t end : split(texts[i], kSplitSize)) {
+                parts.push_back({i, texts[i].substr(begin, end - begin)});
+                begin = end;
+            }
+        }
+        parts.push_back({i, texts[i].substr(begin)});
+    }
+    std::vector<std::vector<int>> part_ids(parts.size());
+    ThreadPool::shared().parallel_for(parts.size(), [&](size_t i) {
+        IdSink sink(&part_ids[i]);
+        encode_text(parts[i].str, sink);
+    });
+    std::vector<std::vector<int>> ids(texts.size());
+    for (size_t i = 0; i < parts.size(); i++) {
+        auto& text_ids = ids[parts[i].text];
+        if (text_ids.empty()) {
+            text_ids = std::move(part_ids[i]);
+        } else {
+            text_ids.insert(text_ids.end(), part_ids[i].begin(), part_ids[i].end());
+        }
+    }
+    return ids;
+}
+
+std::vector<int> Tokenizer::encode(const std::vector<std::string_view>& segments, EncodeCache* cache) {
+    std::string str;
+    std::vector<size_t> points;
+    for (auto segment : segments) {
+        for (size_t pos = segment.find('\n'); pos != std::string_view::npos; pos = segment.find('\n', pos + 1)) {
+            points.push_back(str.size() + pos + 1);
+        }
+        str.append(segment.data(), segment.size());
+        points.push_back(str.size());
+    }
+    if (cache == nullptr) {
+        return encode(str);
+    }
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    points.erase(std::remove_if(points.begin(), points.end(), [&](size_t pos) {
+        return pos == 0 || pos >= str.size();
+    }), points.end());
+    std::vector<std::string_view> parts;
+    size_t begin = 0;
+    for (size_t end : filter_splits(str, points)) {
+        parts.push_back(std::string_view(str).substr(begin, end - begin));
+        begin = end;
+    }
+    parts.push_back(std::string_view(str).substr(begin));
+    // encode the parts not cached together
+    std::vector<std::vector<int>> part_ids(parts.size());
+    std::vector<std::string_view> missed;
+    std::vector<size_t> missed_index;
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (!cache->find(parts[i], part_ids[i])) {
+            missed.push_back(parts[i]);
+            missed_index.push_back(i);
+        }
+    }
+    // a few short misses, such as a new question after a cached template, are not worth the threads
+    size_t missed_size = 0;
+    for (auto part : missed) {
+        missed_size += part.size();
+    }
+    std::vector<std::vector<int>> missed_ids(missed.size());
+    if (missed_size < 2 * kSplitSize) {
+        for (size_t i = 0; i < missed.size(); i++) {
+            IdSink sink(&missed_ids[i]);
+            encode_text(missed[i], sink);
+        }
+    } else {
+        missed_ids = encode_batch(missed);
+    }
+    for (size_t i = 0; i < missed.size(); i++) {
+        cache->insert(missed[i], missed_ids[i]);
+        part_ids[missed_index[i]] = std::move(missed_ids[i]);
+    }
+    std::vector<int> ids;
+    for (const auto& part : part_ids) {
+        ids.insert(ids.end(), part.begin(), part.end());
+    }
+    return ids;
+}
+
+size_t Tokenizer::count(std::string_view str) {
+    // ids of a part are counted without keeping them
+    auto count_part = [this](std::string_view part) {
+        IdSink counter(nullptr);
+        encode_text(part, counter);
+        return counter.size();
+    };
+    if (str.size() < 2 * kSplitSize) {
+        return count_part(str);
+    }
+    std::vector<std::string_view> parts;
+    size_t begin = 0;
+    for (size_t end : split(str, kSplitSize)) {
+        parts.push_back(str.substr(begin, end - begin));
+        begin = end;
+    }
+    parts.push_back(str.substr(begin));
+    std::atomic<size_t> total{0};
+    ThreadPool::shared().parallel_for(parts.size(), [&](size_t i) {
+        total += count_part(parts[i]);
+    });
+    return total;
+}
+
+bool EncodeCache::find(std::string_view text, std::vector<int>& ids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(std::hash<std::string_view>()(text));
+    if (it == index_.end() || it->second->text != text) {
+        return false;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    ids.insert(ids.end(), it->second->ids.begin(), it->second->ids.end());
+    return true;
+}
+
+size_t EncodeCache::entry_bytes(size_t text_size, size_t ids_size) {
+    // list node, index node and the two heap blocks
+    const size_t overhead = 96;
+    return text_size + ids_size * sizeof(int) + overhead;
+}
+
+void EncodeCache::insert(std::string_view text, const std::vector<int>& ids) {
+    size_t bytes = entry_bytes(text.size(), ids.size());
+    if (bytes > capacity_ / 16) {
+        return;
+    }
+    size_t hash = std::hash<std::string_view>()(text);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(hash);
+    if (it != index_.end()) {
+        // same text inserted by another session, or a hash collision which the newer text replaces
+        bytes_ -= entry_bytes(it->second->text.size(), it->second->ids.size());
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+    while (!entries_.empty() && bytes_ + bytes > capacity_) {
+        auto& last = entries_.back();
+        bytes_ -= entry_bytes(last.text.size(), last.ids.size());
+        index_.erase(std::hash<std::string_view>()(last.text));
+        entries_.pop_back();
+    }
+    entries_.push_front({std::string(text), ids});
+    index_[hash] = entries_.begin();
+    bytes_ += bytes;
+}
+
+size_t EncodeCache::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t EncodeCache::bytes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+// length of the prefix of `str` not ending inside a utf-8 character, invalid bytes count as characters
+static size_t complete_utf8_len(std::string_view str) {
+    size_t size = str.size();
+    for (size_t back = 1; back <= std::min<size_t>(4, size); back++) {
+        unsigned char c = str[size - back];
+        if ((c & 0xC0) == 0x80) {
+            continue;
+        }
+        size_t len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return back < len ? size - back : size;
+    }
+    return size;
+}
+
+std::string_view StreamDecoder::put(int id) {
+    auto piece = tokenizer_->decode_view(id);
+    buffer_.erase(0, emitted_);
+    emitted_ = 0;
+    if (buffer_.empty()) {
+        // common case: the piece itself, no copy
+        size_t len = complete_utf8_len(piece);
+        buffer_.assign(piece.substr(len));
+        return piece.substr(0, len);
+    }
+    buffer_.append(piece);
+    emitted_ = complete_utf8_len(buffer_);
+    return std::string_view(buffer_.data(), emitted_);
+}
+
+std::string_view StreamDecoder::flush() {
+    buffer_.erase(0, emitted_);
+    // the held bytes are an incomplete character, so the stream stays valid utf-8
+    if (!buffer_.empty()) {
+        buffer_ = "\xEF\xBF\xBD";
+    }
+    emitted_ = buffer_.size();
+    return buffer_;
+}
+
+// true if a key of `trie` starts before `pos` and ends after it
+static bool key_crosses(const Trie& trie, std::string_view str, size_t pos, size_t max_len) {
+    bool crosses = false;
+    for (size_t start = pos + 1 > max_len ? pos + 1 - max_len : 0; start < pos && !crosses; start++) {
+        trie.prefix_match(str.substr(start), [&](size_t len, int) {
+            crosses |= start + len > pos;
+        });
+    }
+    return crosses;
+}
+
+// the first position from every `chunk` bytes which is `safe`, searched within a window
+template <typename Safe>
+static std::vector<size_t> split_points(std::string_view str, size_t chunk, Safe&& safe) {
+    const size_t window = 1024;
+    std::vector<size_t> points;
+    for (size_t pos = chunk; pos + chunk / 2 < str.size(); pos += chunk) {
+        size_t end = std::min(str.size(), pos + window);
+        while (pos < end && !safe(pos)) {
+            pos++;
+        }
+        if (pos < end) {
+            points.push_back(pos);
+        }
+    }
+    return points;
+}
+
+void Trie::build(const std::vector<std::pair<std::string_view, int>>& keys) {
+    // sort keys so every node's children are created in label order, then lay nodes out breadth first
+    std::vector<const std::pair<std::string_view, int>*> sorted(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        sorted[i] = &keys[i];
+    }
+    // stable so the first of duplicated keys wins
+    std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<std::string_view, int>* a, const std::pair<std::string_view, int>* b) {
+        return a->first < b->first;
+    });
+    struct BuildNode {
+        int value = -1;
+        std::vector<std::pair<uint8_t, int>> children;
+    };
+    std::vector<BuildNode> nodes(1);
+    for (auto key : sorted) {
+        int node = 0;
+        for (unsigned char c : key->first) {
+            auto& children = nodes[node].children;
+            if (children.empty() || children.back().first != c) {
+                children.emplace_back(c, static_cast<int>(nodes.size()));
+                nodes.emplace_back();
+            }
+            node = nodes[node].children.back().second;
+        }
+        if (nodes[node].value < 0) {
+            nodes[node].value = key->second;
+        }
+    }
+    std::vector<int> order(1, 0), index(nodes.size(), 0);
+    for (size_t i = 0; i < order.size(); i++) {
+        for (auto& child : nodes[order[i]].children) {
+            index[child.second] = static_cast<int>(order.size());
+            order.push_back(child.second);
+        }
+    }
+    std::vector<int> values(order.size()), targets;
+    std::vector<uint32_t> edge_begin(order.size() + 1);
+    std::vector<uint8_t> labels;
+    labels.reserve(nodes.size());
+    targets.reserve(nodes.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        const auto& node = nodes[order[i]];
+        values[i] = node.value;
+        edge_begin[i] = static_cast<uint32_t>(labels.size());
+        for (auto& child : node.children) {
+            labels.push_back(child.first);
+            targets.push_back(index[child.second]);
+        }
+    }
+    edge_begin[order.size()] = static_cast<uint32_t>(labels.size());
+    int root[256];
+    std::fill(root, root + 256, -1);
+    for (uint32_t e = edge_begin[0]; e < edge_begin[1]; e++) {
+        root[labels[e]] = targets[e];
+    }
+    const uint32_t num[2] = {static_cast<uint32_t>(values.size()), static_cast<uint32_t>(labels.size())};
+    storage_.clear();
+    append_section(storage_, num, 2);
+    append_section(storage_, root, 256);
+    append_section(storage_, values.data(), values.size());
+    append_section(storage_, edge_begin.data(), edge_begin.size());
+    append_section(storage_, targets.data(), targets.size());
+    append_section(storage_, labels.data(), labels.size());
+    size_t offset = 0;
+    map(storage_.data(), storage_.size(), offset);
+}
+
+void Trie::save(std::vector<char>& image) const {
+    const uint32_t num[2] = {node_num_, edge_num_};
+    append_section(image, num, 2);
+    if (node_num_ == 0) {
+        return;
+    }
+    append_section(image, root_, 256);
+    append_section(image, values_, node_num_);
+    append_section(image, edge_begin_, node_num_ + 1);
+    append_section(image, targets_, edge_num_);
+    append_section(image, labels_, edge_num_);
+}
+
+bool Trie::map(const char* image, size_t size, size_t& offset) {
+    auto num = view_section<uint32_t>(image, size, offset, 2);
+    if (num == nullptr) {
+        return false;
+    }
+    node_num_ = num[0];
+    edge_num_ = num[1];
+    if (node_num_ > 0) {
+        root_ = view_section<int>(image, size, offset, 256);
+        values_ = view_section<int>(image, size, offset, node_num_);
+        edge_begin_ = view_section<uint32_t>(image, size, offset, node_num_ + 1);
+        targets_ = view_section<int>(image, size, offset, edge_num_);
+        labels_ = view_section<uint8_t>(image, size, offset, edge_num_);
+        if (!root_ || !values_ || !edge_begin_ || !targets_ || !labels_ || edge_begin_[node_num_] != edge_num_) {
+            node_num_ = 0;
+            return false;
+        }
+    }
+    if (image != storage_.data()) {
+        std::vector<char>().swap(storage_);
+    }
+    return true;
+}
+
+int Trie::find(std::string_view key) const {
+    if (node_num_ == 0) {
+        return -1;
+    }
+    int node = 0;
+    for (unsigned char c : key) {
+        node = child(node, c);
+        if (node < 0) {
+            return -1;
+        }
+    }
+    return values_[node];
+}
+
+int Trie::longest_match(std::string_view str, size_t* match_len) const {
+    int value = -1;
+    *match_len = 0;
+    prefix_match(str, [&](size_t len, int id) {
+        value = id;
+        *match_len = len;
+    });
+    return value;
+}
+
+struct SentencepieceHeader {
+    int32_t model_type;
+    int32_t unk_id;
+    float min_score;
+    float max_score;
+    int32_t byte_ids[256];
+};
+
+bool Sentencepiece::load_text(const std::string& filename, std::vector<char>& image) {
     std::ifstream tok_file(filename);
     std::string line, token;
     float score;
-    int index = 0, type;
+    int type;
+    std::vector<std::string> tokens;
+    std::vector<float> scores;
+    std::vector<uint8_t> types;
     while (std::getline(tok_file, line)) {
+        // optional first line `#type unigram|bpe`, pieces are base64 so it is not a piece
+        if (tokens.empty() && !line.compare(0, 6, "#type ")) {
+            auto name = line.substr(6);
+            if (name == "unigram") {
+                type_ = UNIGRAM;
+            } else if (name == "bpe") {
+                type_ = BPE;
+            } else {
+                std::cerr << "Error: unknown sentencepiece model type " << name << " of " << filename << std::endl;
+                return false;
+            }
+            continue;
+        }
         std::istringstream line_str(line);
         line_str >> token >> score >> type;
-        token = base64_decode(token);
-        auto piece_type = static_cast<PieceType>(type);
-        SentencePiece piece {token, score, piece_type};
-        sentence_pieces_.emplace_back(std::move(piece));
-        if (piece_type == PieceType::NORMAL) {
-            pieces_.insert({token, index});
+        tokens.emplace_back(base64_decode(token));
+        scores.push_back(score);
+        types.push_back(static_cast<uint8_t>(type));
+    }
+    tok_file.close();
+    std::vector<std::pair<std::string_view, int>> normal_pieces, reserved_pieces;
+    SentencepieceHeader header;
+    header.model_type = type_;
+    header.unk_id = 0;
+    header.min_score = std::numeric_limits<float>::max();
+    header.max_score = std::numeric_limits<float>::lowest();
+    for (size_t index = 0; index < tokens.size(); index++) {
+        if (types[index] == PieceType::NORMAL) {
+            normal_pieces.emplace_back(tokens[index], index);
+            header.min_score = std::min(header.min_score, scores[index]);
+            header.max_score = std::max(header.max_score, scores[index]);
         } else {
-            reserved_id_map_.insert({token, index});
-            if (piece_type == PieceType::UNKNOWN) {
-                unk_id_ = index;
+            reserved_pieces.emplace_back(tokens[index], index);
+            if (types[index] == PieceType::UNKNOWN) {
+                header.unk_id = index;
             }
         }
-        index++;
     }
-    tok_file.close();
+    Trie pieces, reserved_id_map;
+    pieces.build(normal_pieces);
+    reserved_id_map.build(reserved_pieces);
+    for (int c = 0; c < 256; c++) {
+        auto piece = byte_to_piece(c);
+        int id = reserved_id_map.find(piece);
+        if (id < 0) {
+            id = pieces.find(piece);
+        }
+        header.byte_ids[c] = id < 0 ? header.unk_id : id;
+    }
+    write_tokens(tokens, image);
+    append_section(image, scores.data(), scores.size());
+    append_section(image, types.data(), types.size());
+    append_section(image, &header, 1);
+    pieces.save(image);
+    reserved_id_map.save(image);
+    // decoded bytes: `<0xXX>` is the byte, `▁` is space
+    std::vector<std::string> decoded(tokens.size());
+    for (size_t index = 0; index < tokens.size(); index++) {
+        auto& text = decoded[index];
+        if (types[index] == PieceType::BYTE && tokens[index].size() == 6) {
+            text.push_back(static_cast<char>(std::strtol(tokens[index].substr(3, 2).c_str(), nullptr, 16)));
+            continue;
+        }
+        for (size_t pos = 0; pos < tokens[index].size();) {
+            if (!tokens[index].compare(pos, 3, "▁")) {
+                text.push_back(' ');
+                pos += 3;
+            } else {
+                text.push_back(tokens[index][pos++]);
+            }
+        }
+    }
+    append_table(image, decoded);
     return true;
 }
 
-int Sentencepiece::piece_to_id(const std::string& piece) const {
-    auto it = reserved_id_map_.find(piece);
-    if (it != reserved_id_map_.end()) {
-        return it->second;
+bool Sentencepiece::map(const char* image, size_t size, size_t& offset) {
+    scores_ = view_section<float>(image, size, offset, vocab_size_);
+    types_ = view_section<uint8_t>(image, size, offset, vocab_size_);
+    auto header = view_section<SentencepieceHeader>(image, size, offset, 1);
+    if (scores_ == nullptr || types_ == nullptr || header == nullptr) {
+        return false;
+    }
+    type_ = static_cast<ModelType>(header->model_type);
+    unk_id_ = header->unk_id;
+    min_score_ = header->min_score;
+    max_score_ = header->max_score;
+    ::memcpy(byte_ids_, header->byte_ids, sizeof(byte_ids_));
+    return pieces_.map(image, size, offset) && reserved_id_map_.map(image, size, offset) &&
+           view_table(image, size, offset, vocab_size_, &decode_offsets_, &decode_blob_);
+}
+
+int Sentencepiece::piece_to_id(std::string_view piece) const {
+    int id = reserved_id_map_.find(piece);
+    if (id >= 0) {
+        return id;
     }
-    auto it2 = pieces_.find(piece);
-    if (it2 != pieces_.end()) {
-        return it2->second;
+    id = pieces_.find(piece);
+    if (id >= 0) {
+        return id;
     }
     return unk_id_;
 }
@@ -112,8 +781,37 @@ std::string Sentencepiece::byte_to_piece(unsigned char c) const {
     return s;
 }
 
+void Sentencepiece::put_piece(std::string_view piece, int id, IdSink& ids) const {
+    if (id == unk_id_ && byte_fall_back_) {
+        // Decomposes an unknown piece into UTF-8 bytes
+        for (unsigned char c : piece) {
+            ids.push(byte_ids_[c]);
+        }
+    } else {
+        ids.push(id);
+    }
+}
+
+void Sentencepiece::resegment(std::string_view w, const RevMerge& rev_merge, IdSink& ids) const {
+    const int id = piece_to_id(w);
+    if (id == -1 || !is_unused(id)) {
+        put_piece(w, id, ids);
+        return;
+    }
+    const auto p = rev_merge.find(w);
+    if (p == rev_merge.end()) {
+        // This block will never be called, as `rev_merge` stores all the
+        // resegmentation info for unused id.
+        put_piece(w, id, ids);
+        return;
+    }
+    // Recursively resegment left and right symbols.
+    resegment(p->second.first, rev_merge, ids);
+    resegment(p->second.second, rev_merge, ids);
+}
+
 // ref: https://github.com/google/sentencepiece/blob/master/src/bpe_model.cc
-Sentencepiece::EncodeResult Sentencepiece::bpe_encode(std::string_view normalized, float alpha) {
+void Sentencepiece::bpe_encode(std::string_view normalized, IdSink& ids, float alpha) {
     // util class begin
     struct SymbolPair {
         int left;     // left index of this pair
@@ -122,11 +820,8 @@ Sentencepiece::EncodeResult Sentencepiece::bpe_encode(std::string_view normalize
         size_t size;  // length of this piece
     };
 
-    class SymbolPairComparator {
-    public:
-        const bool operator()(SymbolPair *h1, SymbolPair *h2) {
-            return (h1->score < h2->score || (h1->score == h2->score && h1->left > h2->left));
-        }
+    auto pair_cmp = [](const SymbolPair& h1, const SymbolPair& h2) {
+        return (h1.score < h2.score || (h1.score == h2.score && h1.left > h2.left));
     };
 
     struct Symbol {
@@ -137,224 +832,1359 @@ Sentencepiece::EncodeResult Sentencepiece::bpe_encode(std::string_view normalize
     };
     // util class end
 
-    using Agenda = std::priority_queue<SymbolPair *, std::vector<SymbolPair *>, SymbolPairComparator>;
-    Agenda agenda;
-    std::vector<Symbol> symbols;
-    symbols.reserve(normalized.size());
+    // buffers are reused by the calls of one thread, pairs are stored by value in a heap
+    thread_local std::vector<SymbolPair> agenda;
+    thread_local std::vector<Symbol> symbols;
     // Reverse merge rules. key: merged symbol, value: pair of original symbols.
-    std::unordered_map<std::string_view, std::pair<std::string_view, std::string_view>> rev_merge;
-    // SymbolPair holder.
-    std::vector<std::unique_ptr<SymbolPair>> symbol_pair_holder;
+    thread_local RevMerge rev_merge;
+    agenda.clear();
+    symbols.clear();
+    rev_merge.clear();
+    symbols.reserve(normalized.size());
     // Lookup new symbol pair at [left, right] and inserts it to agenda.
-    auto MaybeAddNewSymbolPair = [this, &symbol_pair_holder, &symbols, &agenda, &rev_merge](int left, int right) {
+    auto MaybeAddNewSymbolPair = [this, &pair_cmp](int left, int right) {
         if (left == -1 || right == -1 || symbols[left].freeze || symbols[right].freeze) {
             return;
         }
         const std::string_view piece(symbols[left].piece.data(), symbols[left].piece.size() + symbols[right].piece.size());
-        std::string piece_str(piece);
-        const auto it = pieces_.find(piece_str);
-        if (it == pieces_.end()) {
+        const int id = pieces_.find(piece);
+        if (id < 0) {
             return;
         }
-        symbol_pair_holder.emplace_back(new SymbolPair);
-        auto *h = symbol_pair_holder.back().get();
-        h->left = left;
-        h->right = right;
-        h->score = get_score(it->second);
-        h->size = piece.size();
-        agenda.push(h);
+        agenda.push_back({left, right, get_score(id), piece.size()});
+        std::push_heap(agenda.begin(), agenda.end(), pair_cmp);
 
         // Makes `rev_merge` for resegmentation.
-        if (is_unused(it->second)) {
+        if (is_unused(id)) {
             rev_merge[piece] = std::make_pair(symbols[left].piece, symbols[right].piece);
         }
     };
-    // Splits the input into character sequence
-    int index = 0;
-    while (!normalized.empty()) {
+    // Splits the input into character sequence, 8 ascii bytes are checked at once
+    const char* data = normalized.data();
+    const size_t size = normalized.size();
+    size_t pos = 0;
+    auto add_symbol = [](const char* piece, size_t len) {
         Symbol s;
-        // const int mblen = matcher_->PrefixMatch(normalized, &s.freeze);
-        int mblen = std::min<int>(normalized.size(), one_char_len(normalized.data()));
-        s.piece = std::string_view(normalized.data(), mblen);
-        s.prev = index == 0 ? -1 : index - 1;
-        normalized.remove_prefix(mblen);
-        s.next = normalized.empty() ? -1 : index + 1;
-        ++index;
+        s.piece = std::string_view(piece, len);
+        s.prev = static_cast<int>(symbols.size()) - 1;
+        s.next = static_cast<int>(symbols.size()) + 1;
         symbols.emplace_back(s);
+    };
+    while (pos < size) {
+        uint64_t chunk;
+        if (pos + sizeof(chunk) <= size) {
+            ::memcpy(&chunk, data + pos, sizeof(chunk));
+            if (!(chunk & 0x8080808080808080ULL)) {
+                for (size_t i = 0; i < sizeof(chunk); i++) {
+                    add_symbol(data + pos + i, 1);
+                }
+                pos += sizeof(chunk);
+                continue;
+            }
+        }
+        // const int mblen = matcher_->PrefixMatch(normalized, &s.freeze);
+        size_t mblen = std::min<size_t>(size - pos, one_char_len(data + pos));
+        add_symbol(data + pos, mblen);
+        pos += mblen;
     }
 
     if (symbols.empty()) {
-        return {};
+        return;
     }
+    symbols.back().next = -1;
     // Lookup all bigrams.
     for (size_t i = 1; i < symbols.size(); ++i) {
         MaybeAddNewSymbolPair(i - 1, i);
     }
 
     // BPE-dropout: https://arxiv.org/pdf/1910.13267.pdf
-    // std::mt19937 *rand_gen = nullptr;
-    std::mt19937 rand_gen;
+    std::unique_ptr<std::mt19937> rand_gen;
     auto skip_merge = [&]() {
         if (alpha <= 0.0) return false;
         if (alpha >= 1.0) return true;
-        // if (rand_gen == nullptr) rand_gen = random::GetRandomGenerator();
+        if (rand_gen == nullptr) rand_gen.reset(new std::mt19937);
         std::uniform_real_distribution<> gen(0.0, 1.0);
-        return gen(rand_gen) < alpha;
+        return gen(*rand_gen) < alpha;
     };
 
     // Main loop.
     while (!agenda.empty()) {
-        SymbolPair *top = agenda.top();
-        agenda.pop();
+        std::pop_heap(agenda.begin(), agenda.end(), pair_cmp);
+        const SymbolPair top = agenda.back();
+        agenda.pop_back();
 
         // `top` is no longer available.
-        if (symbols[top->left].piece.empty() || symbols[top->right].piece.empty() ||
-            symbols[top->left].piece.size() + symbols[top->right].piece.size() != top->size) {
+        if (symbols[top.left].piece.empty() || symbols[top.right].piece.empty() ||
+            symbols[top.left].piece.size() + symbols[top.right].piece.size() != top.size) {
             continue;
         }
 
         if (skip_merge()) continue;
         // Replaces symbols with `top` rule.
-        symbols[top->left].piece = std::string_view(
-            symbols[top->left].piece.data(),
-            symbols[top->left].piece.size() + symbols[top->right].piece.size());
+        symbols[top.left].piece = std::string_view(
+            symbols[top.left].piece.data(),
+            symbols[top.left].piece.size() + symbols[top.right].piece.size());
 
         // Updates prev/next pointers.
-        symbols[top->left].next = symbols[top->right].next;
-        if (symbols[top->right].next >= 0) {
-        symbols[symbols[top->right].next].prev = top->left;
+        symbols[top.left].next = symbols[top.right].next;
+        if (symbols[top.right].next >= 0) {
+            symbols[symbols[top.right].next].prev = top.left;
         }
-        symbols[top->right].piece = std::string_view("");
+        symbols[top.right].piece = std::string_view("");
 
         // Adds new symbol pairs which are newly added after symbol replacement.
-        MaybeAddNewSymbolPair(symbols[top->left].prev, top->left);
-        MaybeAddNewSymbolPair(top->left, symbols[top->left].next);
+        MaybeAddNewSymbolPair(symbols[top.left].prev, top.left);
+        MaybeAddNewSymbolPair(top.left, symbols[top.left].next);
     }
 
-    std::function<void(std::string_view, EncodeResult*)> resegment;
-    resegment = [this, &resegment, &rev_merge](std::string_view w, EncodeResult *output) -> void {
-        std::string w_str(w);
-        const int id = piece_to_id(w_str);
-        // std::cout << "piece: " << w << ", id = " << id << std::endl;
-        if (id == -1 || !is_unused(id)) {
-            output->emplace_back(w, id);
-            return;
-        }
-        const auto p = rev_merge.find(w);
-        if (p == rev_merge.end()) {
-            // This block will never be called, as `rev_merge` stores all the
-            // resegmentation info for unused id.
-            output->emplace_back(w, id);
-            return;
-        }
-        // Recursively resegment left and right symbols.
-        resegment(p->second.first, output);
-        resegment(p->second.second, output);
-    };
-    EncodeResult output;
     for (int index = 0; index != -1; index = symbols[index].next) {
-        resegment(symbols[index].piece, &output);
+        resegment(symbols[index].piece, rev_merge, ids);
     }
-    return output;
 }
 
-std::vector<int> Sentencepiece::encode(const std::string& str) {
-    std::vector<int> ids;
-    auto result = bpe_encode(str);
-    size_t consumed = 0;
-    for (const auto &p : result) {
-        const std::string_view w = p.first;   // piece
-        const int id = p.second;              // id
-        const bool is_unk = (id == unk_id_);
-        if (is_unk && byte_fall_back_) {
-            // Decomposes an unknown piece into UTF-8 bytes
-            for (int i = 0; i < w.size(); ++i) {
-                // Create a byte piece
-                const char b = w[i];
-                const auto piece = byte_to_piece(b);
-                auto sp_id = piece_to_id(piece);
-                ids.push_back(sp_id);
+// ref: https://github.com/google/sentencepiece/blob/master/src/unigram_model.cc
+void Sentencepiece::unigram_encode(std::string_view normalized, IdSink& ids) const {
+    // Represents the last node of the best path.
+    struct BestPathNode {
+        int id = -1;  // The vocab id. (maybe -1 for UNK)
+        float best_path_score = 0;  // The total score of the best path ending at this node.
+        int starts_at = -1;  // The starting position (in utf-8) of this node. The entire best path can be constructed by backtracking along this link.
+    };
+    const float kUnkPenalty = 10.0;
+    const float unk_score = min_score_ - kUnkPenalty;
+    const int size = static_cast<int>(normalized.size());
+    // lattice nodes are reused by the calls of one thread
+    thread_local std::vector<BestPathNode> best_path_ends_at;
+    best_path_ends_at.assign(size + 1, BestPathNode());
+    // Generate lattice on-the-fly (not stored) and update best_path_ends_at.
+    int starts_at = 0;
+    while (starts_at < size) {
+        const float best_path_score_till_here = best_path_ends_at[starts_at].best_path_score;
+        bool has_single_node = false;
+        const int mblen = std::min<int>(one_char_len(normalized.data() + starts_at), size - starts_at);
+        auto visit = [&](size_t length, int id) {
+            if (is_unused(id)) {
+                return;
+            }
+            const auto type = types_[id];
+            if (type != PieceType::NORMAL && type != PieceType::USER_DEFINED) {
+                return;
+            }
+            const float score = type == PieceType::USER_DEFINED ? (length * max_score_ - 0.1) : get_score(id);
+            const float candidate_best_path_score = score + best_path_score_till_here;
+            auto& target_node = best_path_ends_at[starts_at + length];
+            if (target_node.starts_at == -1 || candidate_best_path_score > target_node.best_path_score) {
+                target_node.best_path_score = candidate_best_path_score;
+                target_node.starts_at = starts_at;
+                target_node.id = id;
+            }
+            if (!has_single_node && length == static_cast<size_t>(mblen)) {
+                has_single_node = true;
+            }
+        };
+        const auto rest = normalized.substr(starts_at);
+        pieces_.prefix_match(rest, visit);
+        reserved_id_map_.prefix_match(rest, visit);
+        if (!has_single_node) {
+            auto& target_node = best_path_ends_at[starts_at + mblen];
+            const float candidate_best_path_score = unk_score + best_path_score_till_here;
+            if (target_node.starts_at == -1 || candidate_best_path_score > target_node.best_path_score) {
+                target_node.best_path_score = candidate_best_path_score;
+                target_node.starts_at = starts_at;
+                target_node.id = unk_id_;
             }
-        } else {
-            ids.push_back(id);
         }
+        // Move by one unicode character.
+        starts_at += mblen;
+    }
+    // Backtrack to identify the best path, then put it from the start.
+    thread_local std::vector<int> path_ends;
+    path_ends.clear();
+    for (int ends_at = size; ends_at > 0; ends_at = best_path_ends_at[ends_at].starts_at) {
+        path_ends.push_back(ends_at);
+    }
+    for (auto it = path_ends.rbegin(); it != path_ends.rend(); ++it) {
+        const auto& node = best_path_ends_at[*it];
+        put_piece(normalized.substr(node.starts_at, *it - node.starts_at), node.id, ids);
     }
-    return ids;
 }
 
-std::string Sentencepiece::decode(int id) {
-    auto piece = sentence_pieces_[id].piece;
-    int pos = piece.find("▁");
-    if (pos != -1) {
-        piece.replace(pos, pos + 3, " ");
+void Sentencepiece::encode_text(std::string_view str, IdSink& ids) {
+    if (type_ == UNIGRAM) {
+        unigram_encode(str, ids);
+    } else {
+        bpe_encode(str, ids);
     }
-    return piece;
+}
+
+// no piece crosses a split point, so neither merges nor lattice paths do
+bool Sentencepiece::is_split(std::string_view str, size_t pos) const {
+    return (str[pos] & 0xC0) != 0x80 && !key_crosses(pieces_, str, pos, max_token_len_) &&
+           !key_crosses(reserved_id_map_, str, pos, max_token_len_);
+}
+
+std::vector<size_t> Sentencepiece::split(std::string_view str, size_t chunk) const {
+    return split_points(str, chunk, [&](size_t pos) { return is_split(str, pos); });
+}
+
+std::vector<size_t> Sentencepiece::filter_splits(std::string_view str, const std::vector<size_t>& points) const {
+    std::vector<size_t> splits;
+    for (size_t pos : points) {
+        if (is_split(str, pos)) {
+            splits.push_back(pos);
+        }
+    }
+    return splits;
+}
+
+size_t Sentencepiece::max_count(std::string_view str) const {
+    size_t count = 0;
+    for (size_t pos = 0; pos < str.size();) {
+        size_t len = std::min(one_char_len(str.data() + pos), str.size() - pos);
+        if (len > 1) {
+            int id = pieces_.find(str.substr(pos, len));
+            count += (id >= 0 && !is_unused(id)) ? 1 : len;
+        } else {
+            count++;
+        }
+        pos += len;
+    }
+    return count;
 }
 
 float Sentencepiece::get_score(int id) const {
-    return sentence_pieces_[id].score;
+    return scores_[id];
 }
 
 bool Sentencepiece::is_unused(int id) const {
-    return sentence_pieces_[id].type == PieceType::UNUSED;
+    return types_[id] == PieceType::UNUSED;
 }
 
 bool Sentencepiece::is_control(int id) const {
-    return sentence_pieces_[id].type == PieceType::CONTROL;
+    return types_[id] == PieceType::CONTROL;
+}
+
+// unicode 14.0.0 letter (1) and number (2) ranges above ascii, generated from python unicodedata
+static const uint32_t unicode_ranges[][3] = {
+    {0xAA, 0xAA, 1}, {0xB2, 0xB3, 2}, {0xB5, 0xB5, 1}, {0xB9, 0xB9, 2}, {0xBA, 0xBA, 1}, {0xBC, 0xBE, 2},
+    {0xC0, 0xD6, 1}, {0xD8, 0xF6, 1}, {0xF8, 0x2C1, 1}, {0x2C6, 0x2D1, 1}, {0x2E0, 0x2E4, 1}, {0x2EC, 0x2EC, 1},
+    {0x2EE, 0x2EE, 1}, {0x370, 0x374, 1}, {0x376, 0x377, 1}, {0x37A, 0x37D, 1}, {0x37F, 0x37F, 1}, {0x386, 0x386, 1},
+    {0x388, 0x38A, 1}, {0x38C, 0x38C, 1}, {0x38E, 0x3A1, 1}, {0x3A3, 0x3F5, 1}, {0x3F7, 0x481, 1}, {0x48A, 0x52F, 1},
+    {0x531, 0x556, 1}, {0x559, 0x559, 1}, {0x560, 0x588, 1}, {0x5D0, 0x5EA, 1}, {0x5EF, 0x5F2, 1}, {0x620, 0x64A, 1},
+    {0x660, 0x669, 2}, {0x66E, 0x66F, 1}, {0x671, 0x6D3, 1}, {0x6D5, 0x6D5, 1}, {0x6E5, 0x6E6, 1}, {0x6EE, 0x6EF, 1},
+    {0x6F0, 0x6F9, 2}, {0x6FA, 0x6FC, 1}, {0x6FF, 0x6FF, 1}, {0x710, 0x710, 1}, {0x712, 0x72F, 1}, {0x74D, 0x7A5, 1},
+    {0x7B1, 0x7B1, 1}, {0x7C0, 0x7C9, 2}, {0x7CA, 0x7EA, 1}, {0x7F4, 0x7F5, 1}, {0x7FA, 0x7FA, 1}, {0x800, 0x815, 1},
+    {0x81A, 0x81A, 1}, {0x824, 0x824, 1}, {0x828, 0x828, 1}, {0x840, 0x858, 1}, {0x860, 0x86A, 1}, {0x870, 0x887, 1},
+    {0x889, 0x88E, 1}, {0x8A0, 0x8C9, 1}, {0x904, 0x939, 1}, {0x93D, 0x93D, 1}, {0x950, 0x950, 1}, {0x958, 0x961, 1},
+    {0x966, 0x96F, 2}, {0x971, 0x980, 1}, {0x985, 0x98C, 1}, {0x98F, 0x990, 1}, {0x993, 0x9A8, 1}, {0x9AA, 0x9B0, 1},
+    {0x9B2, 0x9B2, 1}, {0x9B6, 0x9B9, 1}, {0x9BD, 0x9BD, 1}, {0x9CE, 0x9CE, 1}, {0x9DC, 0x9DD, 1}, {0x9DF, 0x9E1, 1},
+    {0x9E6, 0x9EF, 2}, {0x9F0, 0x9F1, 1}, {0x9F4, 0x9F9, 2}, {0x9FC, 0x9FC, 1}, {0xA05, 0xA0A, 1}, {0xA0F, 0xA10, 1},
+    {0xA13, 0xA28, 1}, {0xA2A, 0xA30, 1}, {0xA32, 0xA33, 1}, {0xA35, 0xA36, 1}, {0xA38, 0xA39, 1}, {0xA59, 0xA5C, 1},
+    {0xA5E, 0xA5E, 1}, {0xA66, 0xA6F, 2}, {0xA72, 0xA74, 1}, {0xA85, 0xA8D, 1}, {0xA8F, 0xA91, 1}, {0xA93, 0xAA8, 1},
+    {0xAAA, 0xAB0, 1}, {0xAB2, 0xAB3, 1}, {0xAB5, 0xAB9, 1}, {0xABD, 0xABD, 1}, {0xAD0, 0xAD0, 1}, {0xAE0, 0xAE1, 1},
+    {0xAE6, 0xAEF, 2}, {0xAF9, 0xAF9, 1}, {0xB05, 0xB0C, 1}, {0xB0F, 0xB10, 1}, {0xB13, 0xB28, 1}, {0xB2A, 0xB30, 1},
+    {0xB32, 0xB33, 1}, {0xB35, 0xB39, 1}, {0xB3D, 0xB3D, 1}, {0xB5C, 0xB5D, 1}, {0xB5F, 0xB61, 1}, {0xB66, 0xB6F, 2},
+    {0xB71, 0xB71, 1}, {0xB72, 0xB77, 2}, {0xB83, 0xB83, 1}, {0xB85, 0xB8A, 1}, {0xB8E, 0xB90, 1}, {0xB92, 0xB95, 1},
+    {0xB99, 0xB9A, 1}, {0xB9C, 0xB9C, 1}, {0xB9E, 0xB9F, 1}, {0xBA3, 0xBA4, 1}, {0xBA8, 0xBAA, 1}, {0xBAE, 0xBB9, 1},
+    {0xBD0, 0xBD0, 1}, {0xBE6, 0xBF2, 2}, {0xC05, 0xC0C, 1}, {0xC0E, 0xC10, 1}, {0xC12, 0xC28, 1}, {0xC2A, 0xC39, 1},
+    {0xC3D, 0xC3D, 1}, {0xC58, 0xC5A, 1}, {0xC5D, 0xC5D, 1}, {0xC60, 0xC61, 1}, {0xC66, 0xC6F, 2}, {0xC78, 0xC7E, 2},
+    {0xC80, 0xC80, 1}, {0xC85, 0xC8C, 1}, {0xC8E, 0xC90, 1}, {0xC92, 0xCA8, 1}, {0xCAA, 0xCB3, 1}, {0xCB5, 0xCB9, 1},
+    {0xCBD, 0xCBD, 1}, {0xCDD, 0xCDE, 1}, {0xCE0, 0xCE1, 1}, {0xCE6, 0xCEF, 2}, {0xCF1, 0xCF2, 1}, {0xD04, 0xD0C, 1},
+    {0xD0E, 0xD10, 1}, {0xD12, 0xD3A, 1}, {0xD3D, 0xD3D, 1}, {0xD4E, 0xD4E, 1}, {0xD54, 0xD56, 1}, {0xD58, 0xD5E, 2},
+    {0xD5F, 0xD61, 1}, {0xD66, 0xD78, 2}, {0xD7A, 0xD7F, 1}, {0xD85, 0xD96, 1}, {0xD9A, 0xDB1, 1}, {0xDB3, 0xDBB, 1},
+    {0xDBD, 0xDBD, 1}, {0xDC0, 0xDC6, 1}, {0xDE6, 0xDEF, 2}, {0xE01, 0xE30, 1}, {0xE32, 0xE33, 1}, {0xE40, 0xE46, 1},
+    {0xE50, 0xE59, 2}, {0xE81, 0xE82, 1}, {0xE84, 0xE84, 1}, {0xE86, 0xE8A, 1}, {0xE8C, 0xEA3, 1}, {0xEA5, 0xEA5, 1},
+    {0xEA7, 0xEB0, 1}, {0xEB2, 0xEB3, 1}, {0xEBD, 0xEBD, 1}, {0xEC0, 0xEC4, 1}, {0xEC6, 0xEC6, 1}, {0xED0, 0xED9, 2},
+    {0xEDC, 0xEDF, 1}, {0xF00, 0xF00, 1}, {0xF20, 0xF33, 2}, {0xF40, 0xF47, 1}, {0xF49, 0xF6C, 1}, {0xF88, 0xF8C, 1},
+    {0x1000, 0x102A, 1}, {0x103F, 0x103F, 1}, {0x1040, 0x1049, 2}, {0x1050, 0x1055, 1}, {0x105A, 0x105D, 1}, {0x1061, 0x1061, 1},
+    {0x1065, 0x1066, 1}, {0x106E, 0x1070, 1}, {0x1075, 0x1081, 1}, {0x108E, 0x108E, 1}, {0x1090, 0x1099, 2}, {0x10A0, 0x10C5, 1},
+    {0x10C7, 0x10C7, 1}, {0x10CD, 0x10CD, 1}, {0x10D0, 0x10FA, 1}, {0x10FC, 0x1248, 1}, {0x124A, 0x124D, 1}, {0x1250, 0x1256, 1},
+    {0x1258, 0x1258, 1}, {0x125A, 0x125D, 1}, {0x1260, 0x1288, 1}, {0x128A, 0x128D, 1}, {0x1290, 0x12B0, 1}, {0x12B2, 0x12B5, 1},
+    {0x12B8, 0x12BE, 1}, {0x12C0, 0x12C0, 1}, {0x12C2, 0x12C5, 1}, {0x12C8, 0x12D6, 1}, {0x12D8, 0x1310, 1}, {0x1312, 0x1315, 1},
+    {0x1318, 0x135A, 1}, {0x1369, 0x137C, 2}, {0x1380, 0x138F, 1}, {0x13A0, 0x13F5, 1}, {0x13F8, 0x13FD, 1}, {0x1401, 0x166C, 1},
+    {0x166F, 0x167F, 1}, {0x1681, 0x169A, 1}, {0x16A0, 0x16EA, 1}, {0x16EE, 0x16F0, 2}, {0x16F1, 0x16F8, 1}, {0x1700, 0x1711, 1},
+    {0x171F, 0x1731, 1}, {0x1740, 0x1751, 1}, {0x1760, 0x176C, 1}, {0x176E, 0x1770, 1}, {0x1780, 0x17B3, 1}, {0x17D7, 0x17D7, 1},
+    {0x17DC, 0x17DC, 1}, {0x17E0, 0x17E9, 2}, {0x17F0, 0x17F9, 2}, {0x1810, 0x1819, 2}, {0x1820, 0x1878, 1}, {0x1880, 0x1884, 1},
+    {0x1887, 0x18A8, 1}, {0x18AA, 0x18AA, 1}, {0x18B0, 0x18F5, 1}, {0x1900, 0x191E, 1}, {0x1946, 0x194F, 2}, {0x1950, 0x196D, 1},
+    {0x1970, 0x1974, 1}, {0x1980, 0x19AB, 1}, {0x19B0, 0x19C9, 1}, {0x19D0, 0x19DA, 2}, {0x1A00, 0x1A16, 1}, {0x1A20, 0x1A54, 1},
+    {0x1A80, 0x1A89, 2}, {0x1A90, 0x1A99, 2}, {0x1AA7, 0x1AA7, 1}, {0x1B05, 0x1B33, 1}, {0x1B45, 0x1B4C, 1}, {0x1B50, 0x1B59, 2},
+    {0x1B83, 0x1BA0, 1}, {0x1BAE, 0x1BAF, 1}, {0x1BB0, 0x1BB9, 2}, {0x1BBA, 0x1BE5, 1}, {0x1C00, 0x1C23, 1}, {0x1C40, 0x1C49, 2},
+    {0x1C4D, 0x1C4F, 1}, {0x1C50, 0x1C59, 2}, {0x1C5A, 0x1C7D, 1}, {0x1C80, 0x1C88, 1}, {0x1C90, 0x1CBA, 1}, {0x1CBD, 0x1CBF, 1},
+    {0x1CE9, 0x1CEC, 1}, {0x1CEE, 0x1CF3, 1}, {0x1CF5, 0x1CF6, 1}, {0x1CFA, 0x1CFA, 1}, {0x1D00, 0x1DBF, 1}, {0x1E00, 0x1F15, 1},
+    {0x1F18, 0x1F1D, 1}, {0x1F20, 0x1F45, 1}, {0x1F48, 0x1F4D, 1}, {0x1F50, 0x1F57, 1}, {0x1F59, 0x1F59, 1}, {0x1F5B, 0x1F5B, 1},
+    {0x1F5D, 0x1F5D, 1}, {0x1F5F, 0x1F7D, 1}, {0x1F80, 0x1FB4, 1}, {0x1FB6, 0x1FBC, 1}, {0x1FBE, 0x1FBE, 1}, {0x1FC2, 0x1FC4, 1},
+    {0x1FC6, 0x1FCC, 1}, {0x1FD0, 0x1FD3, 1}, {0x1FD6, 0x1FDB, 1}, {0x1FE0, 0x1FEC, 1}, {0x1FF2, 0x1FF4, 1}, {0x1FF6, 0x1FFC, 1},
+    {0x2070, 0x2070, 2}, {0x2071, 0x2071, 1}, {0x2074, 0x2079, 2}, {0x207F, 0x207F, 1}, {0x2080, 0x2089, 2}, {0x2090, 0x209C, 1},
+    {0x2102, 0x2102, 1}, {0x2107, 0x2107, 1}, {0x210A, 0x2113, 1}, {0x2115, 0x2115, 1}, {0x2119, 0x211D, 1}, {0x2124, 0x2124, 1},
+    {0x2126, 0x2126, 1}, {0x2128, 0x2128, 1}, {0x212A, 0x212D, 1}, {0x212F, 0x2139, 1}, {0x213C, 0x213F, 1}, {0x2145, 0x2149, 1},
+    {0x214E, 0x214E, 1}, {0x2150, 0x2182, 2}, {0x2183, 0x2184, 1}, {0x2185, 0x2189, 2}, {0x2460, 0x249B, 2}, {0x24EA, 0x24FF, 2},
+    {0x2776, 0x2793, 2}, {0x2C00, 0x2CE4, 1}, {0x2CEB, 0x2CEE, 1}, {0x2CF2, 0x2CF3, 1}, {0x2CFD, 0x2CFD, 2}, {0x2D00, 0x2D25, 1},
+    {0x2D27, 0x2D27, 1}, {0x2D2D, 0x2D2D, 1}, {0x2D30, 0x2D67, 1}, {0x2D6F, 0x2D6F, 1}, {0x2D80, 0x2D96, 1}, {0x2DA0, 0x2DA6, 1},
+    {0x2DA8, 0x2DAE, 1}, {0x2DB0, 0x2DB6, 1}, {0x2DB8, 0x2DBE, 1}, {0x2DC0, 0x2DC6, 1}, {0x2DC8, 0x2DCE, 1}, {0x2DD0, 0x2DD6, 1},
+    {0x2DD8, 0x2DDE, 1}, {0x2E2F, 0x2E2F, 1}, {0x3005, 0x3006, 1}, {0x3007, 0x3007, 2}, {0x3021, 0x3029, 2}, {0x3031, 0x3035, 1},
+    {0x3038, 0x303A, 2}, {0x303B, 0x303C, 1}, {0x3041, 0x3096, 1}, {0x309D, 0x309F, 1}, {0x30A1, 0x30FA, 1}, {0x30FC, 0x30FF, 1},
+    {0x3105, 0x312F, 1}, {0x3131, 0x318E, 1}, {0x3192, 0x3195, 2}, {0x31A0, 0x31BF, 1}, {0x31F0, 0x31FF, 1}, {0x3220, 0x3229, 2},
+    {0x3248, 0x324F, 2}, {0x3251, 0x325F, 2}, {0x3280, 0x3289, 2}, {0x32B1, 0x32BF, 2}, {0x3400, 0x4DBF, 1}, {0x4E00, 0xA48C, 1},
+    {0xA4D0, 0xA4FD, 1}, {0xA500, 0xA60C, 1}, {0xA610, 0xA61F, 1}, {0xA620, 0xA629, 2}, {0xA62A, 0xA62B, 1}, {0xA640, 0xA66E, 1},
+    {0xA67F, 0xA69D, 1}, {0xA6A0, 0xA6E5, 1}, {0xA6E6, 0xA6EF, 2}, {0xA717, 0xA71F, 1}, {0xA722, 0xA788, 1}, {0xA78B, 0xA7CA, 1},
+    {0xA7D0, 0xA7D1, 1}, {0xA7D3, 0xA7D3, 1}, {0xA7D5, 0xA7D9, 1}, {0xA7F2, 0xA801, 1}, {0xA803, 0xA805, 1}, {0xA807, 0xA80A, 1},
+    {0xA80C, 0xA822, 1}, {0xA830, 0xA835, 2}, {0xA840, 0xA873, 1}, {0xA882, 0xA8B3, 1}, {0xA8D0, 0xA8D9, 2}, {0xA8F2, 0xA8F7, 1},
+    {0xA8FB, 0xA8FB, 1}, {0xA8FD, 0xA8FE, 1}, {0xA900, 0xA909, 2}, {0xA90A, 0xA925, 1}, {0xA930, 0xA946, 1}, {0xA960, 0xA97C, 1},
+    {0xA984, 0xA9B2, 1}, {0xA9CF, 0xA9CF, 1}, {0xA9D0, 0xA9D9, 2}, {0xA9E0, 0xA9E4, 1}, {0xA9E6, 0xA9EF, 1}, {0xA9F0, 0xA9F9, 2},
+    {0xA9FA, 0xA9FE, 1}, {0xAA00, 0xAA28, 1}, {0xAA40, 0xAA42, 1}, {0xAA44, 0xAA4B, 1}, {0xAA50, 0xAA59, 2}, {0xAA60, 0xAA76, 1},
+    {0xAA7A, 0xAA7A, 1}, {0xAA7E, 0xAAAF, 1}, {0xAAB1, 0xAAB1, 1}, {0xAAB5, 0xAAB6, 1}, {0xAAB9, 0xAABD, 1}, {0xAAC0, 0xAAC0, 1},
+    {0xAAC2, 0xAAC2, 1}, {0xAADB, 0xAADD, 1}, {0xAAE0, 0xAAEA, 1}, {0xAAF2, 0xAAF4, 1}, {0xAB01, 0xAB06, 1}, {0xAB09, 0xAB0E, 1},
+    {0xAB11, 0xAB16, 1}, {0xAB20, 0xAB26, 1}, {0xAB28, 0xAB2E, 1}, {0xAB30, 0xAB5A, 1}, {0xAB5C, 0xAB69, 1}, {0xAB70, 0xABE2, 1},
+    {0xABF0, 0xABF9, 2}, {0xAC00, 0xD7A3, 1}, {0xD7B0, 0xD7C6, 1}, {0xD7CB, 0xD7FB, 1}, {0xF900, 0xFA6D, 1}, {0xFA70, 0xFAD9, 1},
+    {0xFB00, 0xFB06, 1}, {0xFB13, 0xFB17, 1}, {0xFB1D, 0xFB1D, 1}, {0xFB1F, 0xFB28, 1}, {0xFB2A, 0xFB36, 1}, {0xFB38, 0xFB3C, 1},
+    {0xFB3E, 0xFB3E, 1}, {0xFB40, 0xFB41, 1}, {0xFB43, 0xFB44, 1}, {0xFB46, 0xFBB1, 1}, {0xFBD3, 0xFD3D, 1}, {0xFD50, 0xFD8F, 1},
+    {0xFD92, 0xFDC7, 1}, {0xFDF0, 0xFDFB, 1}, {0xFE70, 0xFE74, 1}, {0xFE76, 0xFEFC, 1}, {0xFF10, 0xFF19, 2}, {0xFF21, 0xFF3A, 1},
+    {0xFF41, 0xFF5A, 1}, {0xFF66, 0xFFBE, 1}, {0xFFC2, 0xFFC7, 1}, {0xFFCA, 0xFFCF, 1}, {0xFFD2, 0xFFD7, 1}, {0xFFDA, 0xFFDC, 1},
+    {0x10000, 0x1000B, 1}, {0x1000D, 0x10026, 1}, {0x10028, 0x1003A, 1}, {0x1003C, 0x1003D, 1}, {0x1003F, 0x1004D, 1}, {0x10050, 0x1005D, 1},
+    {0x10080, 0x100FA, 1}, {0x10107, 0x10133, 2}, {0x10140, 0x10178, 2}, {0x1018A, 0x1018B, 2}, {0x10280, 0x1029C, 1}, {0x102A0, 0x102D0, 1},
+    {0x102E1, 0x102FB, 2}, {0x10300, 0x1031F, 1}, {0x10320, 0x10323, 2}, {0x1032D, 0x10340, 1}, {0x10341, 0x10341, 2}, {0x10342, 0x10349, 1},
+    {0x1034A, 0x1034A, 2}, {0x10350, 0x10375, 1}, {0x10380, 0x1039D, 1}, {0x103A0, 0x103C3, 1}, {0x103C8, 0x103CF, 1}, {0x103D1, 0x103D5, 2},
+    {0x10400, 0x1049D, 1}, {0x104A0, 0x104A9, 2}, {0x104B0, 0x104D3, 1}, {0x104D8, 0x104FB, 1}, {0x10500, 0x10527, 1}, {0x10530, 0x10563, 1},
+    {0x10570, 0x1057A, 1}, {0x1057C, 0x1058A, 1}, {0x1058C, 0x10592, 1}, {0x10594, 0x10595, 1}, {0x10597, 0x105A1, 1}, {0x105A3, 0x105B1, 1},
+    {0x105B3, 0x105B9, 1}, {0x105BB, 0x105BC, 1}, {0x10600, 0x10736, 1}, {0x10740, 0x10755, 1}, {0x10760, 0x10767, 1}, {0x10780, 0x10785, 1},
+    {0x10787, 0x107B0, 1}, {0x107B2, 0x107BA, 1}, {0x10800, 0x10805, 1}, {0x10808, 0x10808, 1}, {0x1080A, 0x10835, 1}, {0x10837, 0x10838, 1},
+    {0x1083C, 0x1083C, 1}, {0x1083F, 0x10855, 1}, {0x10858, 0x1085F, 2}, {0x10860, 0x10876, 1}, {0x10879, 0x1087F, 2}, {0x10880, 0x1089E, 1},
+    {0x108A7, 0x108AF, 2}, {0x108E0, 0x108F2, 1}, {0x108F4, 0x108F5, 1}, {0x108FB, 0x108FF, 2}, {0x10900, 0x10915, 1}, {0x10916, 0x1091B, 2},
+    {0x10920, 0x10939, 1}, {0x10980, 0x109B7, 1}, {0x109BC, 0x109BD, 2}, {0x109BE, 0x109BF, 1}, {0x109C0, 0x109CF, 2}, {0x109D2, 0x109FF, 2},
+    {0x10A00, 0x10A00, 1}, {0x10A10, 0x10A13, 1}, {0x10A15, 0x10A17, 1}, {0x10A19, 0x10A35, 1}, {0x10A40, 0x10A48, 2}, {0x10A60, 0x10A7C, 1},
+    {0x10A7D, 0x10A7E, 2}, {0x10A80, 0x10A9C, 1}, {0x10A9D, 0x10A9F, 2}, {0x10AC0, 0x10AC7, 1}, {0x10AC9, 0x10AE4, 1}, {0x10AEB, 0x10AEF, 2},
+    {0x10B00, 0x10B35, 1}, {0x10B40, 0x10B55, 1}, {0x10B58, 0x10B5F, 2}, {0x10B60, 0x10B72, 1}, {0x10B78, 0x10B7F, 2}, {0x10B80, 0x10B91, 1},
+    {0x10BA9, 0x10BAF, 2}, {0x10C00, 0x10C48, 1}, {0x10C80, 0x10CB2, 1}, {0x10CC0, 0x10CF2, 1}, {0x10CFA, 0x10CFF, 2}, {0x10D00, 0x10D23, 1},
+    {0x10D30, 0x10D39, 2}, {0x10E60, 0x10E7E, 2}, {0x10E80, 0x10EA9, 1}, {0x10EB0, 0x10EB1, 1}, {0x10F00, 0x10F1C, 1}, {0x10F1D, 0x10F26, 2},
+    {0x10F27, 0x10F27, 1}, {0x10F30, 0x10F45, 1}, {0x10F51, 0x10F54, 2}, {0x10F70, 0x10F81, 1}, {0x10FB0, 0x10FC4, 1}, {0x10FC5, 0x10FCB, 2},
+    {0x10FE0, 0x10FF6, 1}, {0x11003, 0x11037, 1}, {0x11052, 0x1106F, 2}, {0x11071, 0x11072, 1}, {0x11075, 0x11075, 1}, {0x11083, 0x110AF, 1},
+    {0x110D0, 0x110E8, 1}, {0x110F0, 0x110F9, 2}, {0x11103, 0x11126, 1}, {0x11136, 0x1113F, 2}, {0x11144, 0x11144, 1}, {0x11147, 0x11147, 1},
+    {0x11150, 0x11172, 1}, {0x11176, 0x11176, 1}, {0x11183, 0x111B2, 1}, {0x111C1, 0x111C4, 1}, {0x111D0, 0x111D9, 2}, {0x111DA, 0x111DA, 1},
+    {0x111DC, 0x111DC, 1}, {0x111E1, 0x111F4, 2}, {0x11200, 0x11211, 1}, {0x11213, 0x1122B, 1}, {0x11280, 0x11286, 1}, {0x11288, 0x11288, 1},
+    {0x1128A, 0x1128D, 1}, {0x1128F, 0x1129D, 1}, {0x1129F, 0x112A8, 1}, {0x112B0, 0x112DE, 1}, {0x112F0, 0x112F9, 2}, {0x11305, 0x1130C, 1},
+    {0x1130F, 0x11310, 1}, {0x11313, 0x11328, 1}, {0x1132A, 0x11330, 1}, {0x11332, 0x11333, 1}, {0x11335, 0x11339, 1}, {0x1133D, 0x1133D, 1},
+    {0x11350, 0x11350, 1}, {0x1135D, 0x11361, 1}, {0x11400, 0x11434, 1}, {0x11447, 0x1144A, 1}, {0x11450, 0x11459, 2}, {0x1145F, 0x11461, 1},
+    {0x11480, 0x114AF, 1}, {0x114C4, 0x114C5, 1}, {0x114C7, 0x114C7, 1}, {0x114D0, 0x114D9, 2}, {0x11580, 0x115AE, 1}, {0x115D8, 0x115DB, 1},
+    {0x11600, 0x1162F, 1}, {0x11644, 0x11644, 1}, {0x11650, 0x11659, 2}, {0x11680, 0x116AA, 1}, {0x116B8, 0x116B8, 1}, {0x116C0, 0x116C9, 2},
+    {0x11700, 0x1171A, 1}, {0x11730, 0x1173B, 2}, {0x11740, 0x11746, 1}, {0x11800, 0x1182B, 1}, {0x118A0, 0x118DF, 1}, {0x118E0, 0x118F2, 2},
+    {0x118FF, 0x11906, 1}, {0x11909, 0x11909, 1}, {0x1190C, 0x11913, 1}, {0x11915, 0x11916, 1}, {0x11918, 0x1192F, 1}, {0x1193F, 0x1193F, 1},
+    {0x11941, 0x11941, 1}, {0x11950, 0x11959, 2}, {0x119A0, 0x119A7, 1}, {0x119AA, 0x119D0, 1}, {0x119E1, 0x119E1, 1}, {0x119E3, 0x119E3, 1},
+    {0x11A00, 0x11A00, 1}, {0x11A0B, 0x11A32, 1}, {0x11A3A, 0x11A3A, 1}, {0x11A50, 0x11A50, 1}, {0x11A5C, 0x11A89, 1}, {0x11A9D, 0x11A9D, 1},
+    {0x11AB0, 0x11AF8, 1}, {0x11C00, 0x11C08, 1}, {0x11C0A, 0x11C2E, 1}, {0x11C40, 0x11C40, 1}, {0x11C50, 0x11C6C, 2}, {0x11C72, 0x11C8F, 1},
+    {0x11D00, 0x11D06, 1}, {0x11D08, 0x11D09, 1}, {0x11D0B, 0x11D30, 1}, {0x11D46, 0x11D46, 1}, {0x11D50, 0x11D59, 2}, {0x11D60, 0x11D65, 1},
+    {0x11D67, 0x11D68, 1}, {0x11D6A, 0x11D89, 1}, {0x11D98, 0x11D98, 1}, {0x11DA0, 0x11DA9, 2}, {0x11EE0, 0x11EF2, 1}, {0x11FB0, 0x11FB0, 1},
+    {0x11FC0, 0x11FD4, 2}, {0x12000, 0x12399, 1}, {0x12400, 0x1246E, 2}, {0x12480, 0x12543, 1}, {0x12F90, 0x12FF0, 1}, {0x13000, 0x1342E, 1},
+    {0x14400, 0x14646, 1}, {0x16800, 0x16A38, 1}, {0x16A40, 0x16A5E, 1}, {0x16A60, 0x16A69, 2}, {0x16A70, 0x16ABE, 1}, {0x16AC0, 0x16AC9, 2},
+    {0x16AD0, 0x16AED, 1}, {0x16B00, 0x16B2F, 1}, {0x16B40, 0x16B43, 1}, {0x16B50, 0x16B59, 2}, {0x16B5B, 0x16B61, 2}, {0x16B63, 0x16B77, 1},
+    {0x16B7D, 0x16B8F, 1}, {0x16E40, 0x16E7F, 1}, {0x16E80, 0x16E96, 2}, {0x16F00, 0x16F4A, 1}, {0x16F50, 0x16F50, 1}, {0x16F93, 0x16F9F, 1},
+    {0x16FE0, 0x16FE1, 1}, {0x16FE3, 0x16FE3, 1}, {0x17000, 0x187F7, 1}, {0x18800, 0x18CD5, 1}, {0x18D00, 0x18D08, 1}, {0x1AFF0, 0x1AFF3, 1},
+    {0x1AFF5, 0x1AFFB, 1}, {0x1AFFD, 0x1AFFE, 1}, {0x1B000, 0x1B122, 1}, {0x1B150, 0x1B152, 1}, {0x1B164, 0x1B167, 1}, {0x1B170, 0x1B2FB, 1},
+    {0x1BC00, 0x1BC6A, 1}, {0x1BC70, 0x1BC7C, 1}, {0x1BC80, 0x1BC88, 1}, {0x1BC90, 0x1BC99, 1}, {0x1D2E0, 0x1D2F3, 2}, {0x1D360, 0x1D378, 2},
+    {0x1D400, 0x1D454, 1}, {0x1D456, 0x1D49C, 1}, {0x1D49E, 0x1D49F, 1}, {0x1D4A2, 0x1D4A2, 1}, {0x1D4A5, 0x1D4A6, 1}, {0x1D4A9, 0x1D4AC, 1},
+    {0x1D4AE, 0x1D4B9, 1}, {0x1D4BB, 0x1D4BB, 1}, {0x1D4BD, 0x1D4C3, 1}, {0x1D4C5, 0x1D505, 1}, {0x1D507, 0x1D50A, 1}, {0x1D50D, 0x1D514, 1},
+    {0x1D516, 0x1D51C, 1}, {0x1D51E, 0x1D539, 1}, {0x1D53B, 0x1D53E, 1}, {0x1D540, 0x1D544, 1}, {0x1D546, 0x1D546, 1}, {0x1D54A, 0x1D550, 1},
+    {0x1D552, 0x1D6A5, 1}, {0x1D6A8, 0x1D6C0, 1}, {0x1D6C2, 0x1D6DA, 1}, {0x1D6DC, 0x1D6FA, 1}, {0x1D6FC, 0x1D714, 1}, {0x1D716, 0x1D734, 1},
+    {0x1D736, 0x1D74E, 1}, {0x1D750, 0x1D76E, 1}, {0x1D770, 0x1D788, 1}, {0x1D78A, 0x1D7A8, 1}, {0x1D7AA, 0x1D7C2, 1}, {0x1D7C4, 0x1D7CB, 1},
+    {0x1D7CE, 0x1D7FF, 2}, {0x1DF00, 0x1DF1E, 1}, {0x1E100, 0x1E12C, 1}, {0x1E137, 0x1E13D, 1}, {0x1E140, 0x1E149, 2}, {0x1E14E, 0x1E14E, 1},
+    {0x1E290, 0x1E2AD, 1}, {0x1E2C0, 0x1E2EB, 1}, {0x1E2F0, 0x1E2F9, 2}, {0x1E7E0, 0x1E7E6, 1}, {0x1E7E8, 0x1E7EB, 1}, {0x1E7ED, 0x1E7EE, 1},
+    {0x1E7F0, 0x1E7FE, 1}, {0x1E800, 0x1E8C4, 1}, {0x1E8C7, 0x1E8CF, 2}, {0x1E900, 0x1E943, 1}, {0x1E94B, 0x1E94B, 1}, {0x1E950, 0x1E959, 2},
+    {0x1EC71, 0x1ECAB, 2}, {0x1ECAD, 0x1ECAF, 2}, {0x1ECB1, 0x1ECB4, 2}, {0x1ED01, 0x1ED2D, 2}, {0x1ED2F, 0x1ED3D, 2}, {0x1EE00, 0x1EE03, 1},
+    {0x1EE05, 0x1EE1F, 1}, {0x1EE21, 0x1EE22, 1}, {0x1EE24, 0x1EE24, 1}, {0x1EE27, 0x1EE27, 1}, {0x1EE29, 0x1EE32, 1}, {0x1EE34, 0x1EE37, 1},
+    {0x1EE39, 0x1EE39, 1}, {0x1EE3B, 0x1EE3B, 1}, {0x1EE42, 0x1EE42, 1}, {0x1EE47, 0x1EE47, 1}, {0x1EE49, 0x1EE49, 1}, {0x1EE4B, 0x1EE4B, 1},
+    {0x1EE4D, 0x1EE4F, 1}, {0x1EE51, 0x1EE52, 1}, {0x1EE54, 0x1EE54, 1}, {0x1EE57, 0x1EE57, 1}, {0x1EE59, 0x1EE59, 1}, {0x1EE5B, 0x1EE5B, 1},
+    {0x1EE5D, 0x1EE5D, 1}, {0x1EE5F, 0x1EE5F, 1}, {0x1EE61, 0x1EE62, 1}, {0x1EE64, 0x1EE64, 1}, {0x1EE67, 0x1EE6A, 1}, {0x1EE6C, 0x1EE72, 1},
+    {0x1EE74, 0x1EE77, 1}, {0x1EE79, 0x1EE7C, 1}, {0x1EE7E, 0x1EE7E, 1}, {0x1EE80, 0x1EE89, 1}, {0x1EE8B, 0x1EE9B, 1}, {0x1EEA1, 0x1EEA3, 1},
+    {0x1EEA5, 0x1EEA9, 1}, {0x1EEAB, 0x1EEBB, 1}, {0x1F100, 0x1F10C, 2}, {0x1FBF0, 0x1FBF9, 2}, {0x20000, 0x2A6DF, 1}, {0x2A700, 0x2B738, 1},
+    {0x2B740, 0x2B81D, 1}, {0x2B820, 0x2CEA1, 1}, {0x2CEB0, 0x2EBE0, 1}, {0x2F800, 0x2FA1D, 1}, {0x30000, 0x3134A, 1},
+};
+
+enum CharType {
+    CHAR_END = -1,
+    CHAR_OTHER = 0,
+    CHAR_LETTER = 1,
+    CHAR_NUMBER = 2,
+    CHAR_SPACE = 3
+};
+
+struct CodePoint {
+    uint32_t cp;
+    CharType type;
+    size_t len;
+};
+
+// \p{L}, \p{N} and \s (unicode White_Space) of a code point
+static inline CharType char_type(uint32_t cp) {
+    if (cp < 0x80) {
+        if ((cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z')) {
+            return CHAR_LETTER;
+        }
+        if (cp >= '0' && cp <= '9') {
+            return CHAR_NUMBER;
+        }
+        if ((cp >= 0x09 && cp <= 0x0d) || cp == ' ') {
+            return CHAR_SPACE;
+        }
+        return CHAR_OTHER;
+    }
+    if (cp == 0x85 || cp == 0xa0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200a) ||
+        cp == 0x2028 || cp == 0x2029 || cp == 0x202f || cp == 0x205f || cp == 0x3000) {
+        return CHAR_SPACE;
+    }
+    int lo = 0, hi = sizeof(unicode_ranges) / sizeof(unicode_ranges[0]) - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (cp < unicode_ranges[mid][0]) {
+            hi = mid - 1;
+        } else if (cp > unicode_ranges[mid][1]) {
+            lo = mid + 1;
+        } else {
+            return static_cast<CharType>(unicode_ranges[mid][2]);
+        }
+    }
+    return CHAR_OTHER;
+}
+
+// length of the utf-8 char at `pos < str.size()` and its code point in `cp`,
+// 0 for an invalid byte which is `cp`
+static inline size_t decode_utf8(std::string_view str, size_t pos, uint32_t& cp) {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(str.data()) + pos;
+    size_t len = one_char_len(str.data() + pos);
+    cp = s[0];
+    if (len == 1 || pos + len > str.size()) {
+        return s[0] < 0x80 ? 1 : 0;
+    }
+    uint32_t value = s[0] & (0xff >> (len + 1));
+    for (size_t i = 1; i < len; i++) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+        value = (value << 6) | (s[i] & 0x3f);
+    }
+    cp = value;
+    return len;
+}
+
+// code point at `pos`, an invalid utf-8 byte is a single CHAR_OTHER
+static inline CodePoint code_point(std::string_view str, size_t pos) {
+    if (pos >= str.size()) {
+        return {0, CHAR_END, 0};
+    }
+    uint32_t cp;
+    size_t len = decode_utf8(str, pos, cp);
+    if (len == 0) {
+        return {cp, CHAR_OTHER, 1};
+    }
+    return {cp, char_type(cp), len};
+}
+
+// end of the run of `type` code points starting at `pos`
+static inline size_t skip_type(std::string_view str, size_t pos, CharType type) {
+    while (true) {
+        auto c = code_point(str, pos);
+        if (c.type != type) {
+            return pos;
+        }
+        pos += c.len;
+    }
+}
+
+// 's|'t|'re|'ve|'m|'ll|'d
+static inline size_t contraction_len(std::string_view str, bool ignore_case) {
+    if (str.size() < 2 || str[0] != '\'') {
+        return 0;
+    }
+    auto lower = [ignore_case](char c) {
+        return (ignore_case && c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    };
+    char c1 = lower(str[1]);
+    if (c1 == 's' || c1 == 't' || c1 == 'm' || c1 == 'd') {
+        return 2;
+    }
+    if (str.size() < 3) {
+        return 0;
+    }
+    char c2 = lower(str[2]);
+    if ((c1 == 'r' && c2 == 'e') || (c1 == 'v' && c2 == 'e') || (c1 == 'l' && c2 == 'l')) {
+        return 3;
+    }
+    return 0;
+}
+
+// \s+(?!\S)|\s+ at the start of `str`
+static inline size_t whitespace_len(std::string_view str) {
+    size_t pos = 0, last = 0;
+    int count = 0;
+    while (true) {
+        auto c = code_point(str, pos);
+        if (c.type != CHAR_SPACE) {
+            // backtrack one space so it can lead the next pre-token
+            if (c.type != CHAR_END && count > 1) {
+                return last;
+            }
+            return pos;
+        }
+        last = pos;
+        pos += c.len;
+        count++;
+    }
+}
+
+size_t Tiktoken::pretokenize(std::string_view str) const {
+    auto c0 = code_point(str, 0);
+    if (pattern_ == GPT2) {
+        size_t len = contraction_len(str, false);
+        if (len) {
+            return len;
+        }
+        // ` ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+`
+        size_t pos = 0;
+        auto c = c0;
+        if (str[0] == ' ') {
+            auto c1 = code_point(str, 1);
+            if (c1.type != CHAR_SPACE && c1.type != CHAR_END) {
+                pos = 1;
+                c = c1;
+            }
+        }
+        if (c.type != CHAR_SPACE) {
+            return skip_type(str, pos, c.type);
+        }
+        return whitespace_len(str);
+    }
+    // QWEN
+    size_t len = contraction_len(str, true);
+    if (len) {
+        return len;
+    }
+    // [^\r\n\p{L}\p{N}]?\p{L}+
+    if (c0.type == CHAR_LETTER) {
+        return skip_type(str, 0, CHAR_LETTER);
+    }
+    if (c0.type != CHAR_NUMBER && str[0] != '\r' && str[0] != '\n' && code_point(str, c0.len).type == CHAR_LETTER) {
+        return skip_type(str, c0.len, CHAR_LETTER);
+    }
+    // \p{N}
+    if (c0.type == CHAR_NUMBER) {
+        return c0.len;
+    }
+    // ` ?[^\s\p{L}\p{N}]+[\r\n]*`
+    size_t pos = (str[0] == ' ' && code_point(str, 1).type == CHAR_OTHER) ? 1 : 0;
+    if (code_point(str, pos).type == CHAR_OTHER) {
+        pos = skip_type(str, pos, CHAR_OTHER);
+        while (pos < str.size() && (str[pos] == '\r' || str[pos] == '\n')) {
+            pos++;
+        }
+        return pos;
+    }
+    // \s*[\r\n]+
+    size_t end = skip_type(str, 0, CHAR_SPACE);
+    for (size_t i = end; i > 0; i--) {
+        if (str[i - 1] == '\r' || str[i - 1] == '\n') {
+            return i;
+        }
+    }
+    return whitespace_len(str);
 }
 
-bool Tiktoken::load(const std::string& filename) {
+bool Tiktoken::load_text(const std::string& filename, std::vector<char>& image) {
     std::ifstream tok_file(filename);
     std::string token;
+    std::vector<std::string> tokens;
     while (tok_file >> token) {
-        token = base64_decode(token);
-        encoder_[token] = static_cast<int>(decoder_.size());
-        decoder_.push_back(token);
+        tokens.push_back(base64_decode(token));
     }
     tok_file.close();
+    std::vector<std::pair<std::string_view, int>> keys;
+    keys.reserve(tokens.size());
+    for (size_t i = 0; i < tokens.size(); i++) {
+        keys.emplace_back(tokens[i], i);
+    }
+    Trie encoder;
+    encoder.build(keys);
+    write_tokens(tokens, image);
+    encoder.save(image);
     return true;
 }
 
-std::vector<int> Tiktoken::encode(const std::string& str) {
-    std::vector<int> ids;
-    if (str.empty()) {
-        return ids;
+bool Tiktoken::map(const char* image, size_t size, size_t& offset) {
+    return encoder_.map(image, size, offset);
+}
+
+void Tiktoken::greedy_encode(std::string_view str, IdSink& ids) const {
+    std::string_view rest(str);
+    while (!rest.empty()) {
+        size_t len = 0;
+        int id = encoder_.longest_match(rest, &len);
+        if (id < 0) {
+            // If no matching symbol is found, this typically means an error in the encoding
+            // or the input text contains characters that the encoder doesn't know how to handle
+            std::cerr << "Error: No encoding found for the sequence starting at position " << str.size() - rest.size() << std::endl;
+            ids.resize(0);
+            return;
+        }
+        ids.push(id);
+        rest.remove_prefix(len);
     }
-    size_t i = 0;
-    while (i < str.size()) {
-        bool found_pair = false;
-        // Attempt to match the longest possible symbol
-        size_t longest_match_len = 0;
-        std::string longest_match;
-
-        // Check substrings of decreasing length
-        for (size_t len = str.size() - i; len > 0; --len) {
-            std::string token = str.substr(i, len);
-            auto it = encoder_.find(token);
-            if (it != encoder_.end()) {
-                if (len > longest_match_len) {
-                    longest_match_len = len;
-                    longest_match = it->first;
-                }
+}
+
+// ref: https://github.com/openai/tiktoken/blob/main/src/lib.rs
+void Tiktoken::bpe_encode(std::string_view word, IdSink& ids) {
+    int id = encoder_.find(word);
+    if (id >= 0) {
+        ids.push(id);
+        return;
+    }
+    {
+        std::shared_lock<std::shared_mutex> lock(cache_mutex_);
+        auto it = cache_.find(word);
+        if (it != cache_.end()) {
+            ids.append(it->second.begin(), it->second.end());
+            return;
+        }
+    }
+    // byte symbols in a linked list, candidate pairs in a heap ordered by rank then position
+    struct Symbol {
+        int prev;
+        int next;
+        uint32_t start;
+        uint32_t len;
+    };
+    struct SymbolPair {
+        int rank;
+        int left;
+        uint32_t len;
+    };
+    auto pair_cmp = [](const SymbolPair& a, const SymbolPair& b) {
+        return a.rank > b.rank || (a.rank == b.rank && a.left > b.left);
+    };
+    int size = static_cast<int>(word.size());
+    // buffers are reused by the calls of one thread
+    thread_local std::vector<Symbol> symbols;
+    thread_local std::vector<SymbolPair> agenda;
+    symbols.resize(size);
+    agenda.clear();
+    for (int i = 0; i < size; i++) {
+        symbols[i] = {i - 1, i + 1 < size ? i + 1 : -1, static_cast<uint32_t>(i), 1};
+    }
+    auto add_pair = [&](int left) {
+        if (left < 0 || symbols[left].next < 0) {
+            return;
+        }
+        uint32_t len = symbols[left].len + symbols[symbols[left].next].len;
+        int rank = encoder_.find(word.substr(symbols[left].start, len));
+        if (rank >= 0) {
+            agenda.push_back({rank, left, len});
+            std::push_heap(agenda.begin(), agenda.end(), pair_cmp);
+        }
+    };
+    for (int i = 0; i + 1 < size; i++) {
+        add_pair(i);
+    }
+    while (!agenda.empty()) {
+        std::pop_heap(agenda.begin(), agenda.end(), pair_cmp);
+        auto top = agenda.back();
+        agenda.pop_back();
+        auto& left = symbols[top.left];
+        // `top` is no longer available.
+        if (left.len == 0 || left.next < 0 || left.len + symbols[left.next].len != top.len) {
+            continue;
+        }
+        auto& right = symbols[left.next];
+        left.len = top.len;
+        left.next = right.next;
+        if (right.next >= 0) {
+            symbols[right.next].prev = top.left;
+        }
+        right.len = 0;
+        add_pair(left.prev);
+        add_pair(top.left);
+    }
+    std::vector<int> word_ids;
+    for (int i = 0; i != -1; i = symbols[i].next) {
+        int sid = encoder_.find(word.substr(symbols[i].start, symbols[i].len));
+        if (sid < 0) {
+            std::cerr << "Error: No encoding found for byte " << static_cast<int>(static_cast<unsigned char>(word[symbols[i].start])) << std::endl;
+            continue;
+        }
+        word_ids.push_back(sid);
+    }
+    ids.append(word_ids.begin(), word_ids.end());
+    std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+    if (cache_.size() >= kMaxCacheSize) {
+        cache_.clear();
+        cache_words_.clear();
+    }
+    if (cache_.find(word) == cache_.end()) {
+        cache_words_.emplace_back(word);
+        cache_.emplace(cache_words_.back(), std::move(word_ids));
+    }
+}
+
+void Tiktoken::encode_text(std::string_view str, IdSink& ids) {
+    if (pattern_ == NONE) {
+        greedy_encode(str, ids);
+        return;
+    }
+    std::string_view rest(str);
+    while (!rest.empty()) {
+        size_t len = pretokenize(rest);
+        bpe_encode(rest.substr(0, len), ids);
+        rest.remove_prefix(len);
+    }
+}
+
+// greedy match never crosses a position no token crosses, bpe words never cross a pre-token boundary
+bool Tiktoken::is_split(std::string_view str, size_t pos) const {
+    return !key_crosses(encoder_, str, pos, max_token_len_);
+}
+
+// a whitespace run ending at a split sees the end instead of the next char when the part is
+// encoded alone, so its pre-tokens are checked again; non ascii bytes may be spaces
+bool Tiktoken::same_alone(std::string_view str, const std::vector<size_t>& bounds) const {
+    size_t pos = bounds.back();
+    size_t run = pos;
+    while (run > 0 && (::isspace(static_cast<unsigned char>(str[run - 1])) || (str[run - 1] & 0x80))) {
+        run--;
+    }
+    size_t i = std::upper_bound(bounds.begin(), bounds.end(), run) - bounds.begin() - 1;
+    for (; i + 1 < bounds.size(); i++) {
+        if (bounds[i] + pretokenize(str.substr(bounds[i], pos - bounds[i])) != bounds[i + 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<size_t> Tiktoken::split(std::string_view str, size_t chunk) const {
+    if (pattern_ == NONE) {
+        return split_points(str, chunk, [&](size_t pos) { return is_split(str, pos); });
+    }
+    std::vector<size_t> points;
+    std::vector<size_t> bounds(1, 0);
+    size_t next = chunk;
+    while (bounds.back() < str.size()) {
+        size_t pos = bounds.back() + pretokenize(str.substr(bounds.back()));
+        bounds.push_back(pos);
+        if (pos >= next && pos + chunk / 2 < str.size() && same_alone(str, bounds)) {
+            points.push_back(pos);
+            next = pos + chunk;
+        }
+    }
+    return points;
+}
+
+std::vector<size_t> Tiktoken::filter_splits(std::string_view str, const std::vector<size_t>& points) const {
+    std::vector<size_t> splits;
+    if (pattern_ == NONE) {
+        for (size_t pos : points) {
+            if (is_split(str, pos)) {
+                splits.push_back(pos);
             }
         }
+        return splits;
+    }
+    // pre-token boundaries which are points
+    std::vector<size_t> bounds(1, 0);
+    auto point = points.begin();
+    while (bounds.back() < str.size() && point != points.end()) {
+        size_t pos = bounds.back() + pretokenize(str.substr(bounds.back()));
+        bounds.push_back(pos);
+        while (point != points.end() && *point < pos) {
+            point++;
+        }
+        if (point != points.end() && *point == pos && same_alone(str, bounds)) {
+            splits.push_back(pos);
+        }
+    }
+    return splits;
+}
 
-        if (!longest_match.empty()) {
-            ids.push_back(encoder_.at(longest_match));
-            i += longest_match_len;
+// unicode 14.0.0 classes of bert basic tokenization above ascii: nonspacing mark (1), punctuation (2),
+// control (3) and whitespace (4), generated from python unicodedata
+static const uint32_t bert_ranges[][3] = {
+    {0x80, 0x9F, 3}, {0xA0, 0xA0, 4}, {0xA1, 0xA1, 2}, {0xA7, 0xA7, 2}, {0xAB, 0xAB, 2}, {0xAD, 0xAD, 3},
+    {0xB6, 0xB7, 2}, {0xBB, 0xBB, 2}, {0xBF, 0xBF, 2}, {0x300, 0x36F, 1}, {0x37E, 0x37E, 2}, {0x387, 0x387, 2},
+    {0x483, 0x487, 1}, {0x55A, 0x55F, 2}, {0x589, 0x58A, 2}, {0x591, 0x5BD, 1}, {0x5BE, 0x5BE, 2}, {0x5BF, 0x5BF, 1},
+    {0x5C0, 0x5C0, 2}, {0x5C1, 0x5C2, 1}, {0x5C3, 0x5C3, 2}, {0x5C4, 0x5C5, 1}, {0x5C6, 0x5C6, 2}, {0x5C7, 0x5C7, 1},
+    {0x5F3, 0x5F4, 2}, {0x600, 0x605, 3}, {0x609, 0x60A, 2}, {0x60C, 0x60D, 2}, {0x610, 0x61A, 1}, {0x61B, 0x61B, 2},
+    {0x61C, 0x61C, 3}, {0x61D, 0x61F, 2}, {0x64B, 0x65F, 1}, {0x66A, 0x66D, 2}, {0x670, 0x670, 1}, {0x6D4, 0x6D4, 2},
+    {0x6D6, 0x6DC, 1}, {0x6DD, 0x6DD, 3}, {0x6DF, 0x6E4, 1}, {0x6E7, 0x6E8, 1}, {0x6EA, 0x6ED, 1}, {0x700, 0x70D, 2},
+    {0x70F, 0x70F, 3}, {0x711, 0x711, 1}, {0x730, 0x74A, 1}, {0x7A6, 0x7B0, 1}, {0x7EB, 0x7F3, 1}, {0x7F7, 0x7F9, 2},
+    {0x7FD, 0x7FD, 1}, {0x816, 0x819, 1}, {0x81B, 0x823, 1}, {0x825, 0x827, 1}, {0x829, 0x82D, 1}, {0x830, 0x83E, 2},
+    {0x859, 0x85B, 1}, {0x85E, 0x85E, 2}, {0x890, 0x891, 3}, {0x898, 0x89F, 1}, {0x8CA, 0x8E1, 1}, {0x8E2, 0x8E2, 3},
+    {0x8E3, 0x902, 1}, {0x93A, 0x93A, 1}, {0x93C, 0x93C, 1}, {0x941, 0x948, 1}, {0x94D, 0x94D, 1}, {0x951, 0x957, 1},
+    {0x962, 0x963, 1}, {0x964, 0x965, 2}, {0x970, 0x970, 2}, {0x981, 0x981, 1}, {0x9BC, 0x9BC, 1}, {0x9C1, 0x9C4, 1},
+    {0x9CD, 0x9CD, 1}, {0x9E2, 0x9E3, 1}, {0x9FD, 0x9FD, 2}, {0x9FE, 0x9FE, 1}, {0xA01, 0xA02, 1}, {0xA3C, 0xA3C, 1},
+    {0xA41, 0xA42, 1}, {0xA47, 0xA48, 1}, {0xA4B, 0xA4D, 1}, {0xA51, 0xA51, 1}, {0xA70, 0xA71, 1}, {0xA75, 0xA75, 1},
+    {0xA76, 0xA76, 2}, {0xA81, 0xA82, 1}, {0xABC, 0xABC, 1}, {0xAC1, 0xAC5, 1}, {0xAC7, 0xAC8, 1}, {0xACD, 0xACD, 1},
+    {0xAE2, 0xAE3, 1}, {0xAF0, 0xAF0, 2}, {0xAFA, 0xAFF, 1}, {0xB01, 0xB01, 1}, {0xB3C, 0xB3C, 1}, {0xB3F, 0xB3F, 1},
+    {0xB41, 0xB44, 1}, {0xB4D, 0xB4D, 1}, {0xB55, 0xB56, 1}, {0xB62, 0xB63, 1}, {0xB82, 0xB82, 1}, {0xBC0, 0xBC0, 1},
+    {0xBCD, 0xBCD, 1}, {0xC00, 0xC00, 1}, {0xC04, 0xC04, 1}, {0xC3C, 0xC3C, 1}, {0xC3E, 0xC40, 1}, {0xC46, 0xC48, 1},
+    {0xC4A, 0xC4D, 1}, {0xC55, 0xC56, 1}, {0xC62, 0xC63, 1}, {0xC77, 0xC77, 2}, {0xC81, 0xC81, 1}, {0xC84, 0xC84, 2},
+    {0xCBC, 0xCBC, 1}, {0xCBF, 0xCBF, 1}, {0xCC6, 0xCC6, 1}, {0xCCC, 0xCCD, 1}, {0xCE2, 0xCE3, 1}, {0xD00, 0xD01, 1},
+    {0xD3B, 0xD3C, 1}, {0xD41, 0xD44, 1}, {0xD4D, 0xD4D, 1}, {0xD62, 0xD63, 1}, {0xD81, 0xD81, 1}, {0xDCA, 0xDCA, 1},
+    {0xDD2, 0xDD4, 1}, {0xDD6, 0xDD6, 1}, {0xDF4, 0xDF4, 2}, {0xE31, 0xE31, 1}, {0xE34, 0xE3A, 1}, {0xE47, 0xE4E, 1},
+    {0xE4F, 0xE4F, 2}, {0xE5A, 0xE5B, 2}, {0xEB1, 0xEB1, 1}, {0xEB4, 0xEBC, 1}, {0xEC8, 0xECD, 1}, {0xF04, 0xF12, 2},
+    {0xF14, 0xF14, 2}, {0xF18, 0xF19, 1}, {0xF35, 0xF35, 1}, {0xF37, 0xF37, 1}, {0xF39, 0xF39, 1}, {0xF3A, 0xF3D, 2},
+    {0xF71, 0xF7E, 1}, {0xF80, 0xF84, 1}, {0xF85, 0xF85, 2}, {0xF86, 0xF87, 1}, {0xF8D, 0xF97, 1}, {0xF99, 0xFBC, 1},
+    {0xFC6, 0xFC6, 1}, {0xFD0, 0xFD4, 2}, {0xFD9, 0xFDA, 2}, {0x102D, 0x1030, 1}, {0x1032, 0x1037, 1}, {0x1039, 0x103A, 1},
+    {0x103D, 0x103E, 1}, {0x104A, 0x104F, 2}, {0x1058, 0x1059, 1}, {0x105E, 0x1060, 1}, {0x1071, 0x1074, 1}, {0x1082, 0x1082, 1},
+    {0x1085, 0x1086, 1}, {0x108D, 0x108D, 1}, {0x109D, 0x109D, 1}, {0x10FB, 0x10FB, 2}, {0x135D, 0x135F, 1}, {0x1360, 0x1368, 2},
+    {0x1400, 0x1400, 2}, {0x166E, 0x166E, 2}, {0x1680, 0x1680, 4}, {0x169B, 0x169C, 2}, {0x16EB, 0x16ED, 2}, {0x1712, 0x1714, 1},
+    {0x1732, 0x1733, 1}, {0x1735, 0x1736, 2}, {0x1752, 0x1753, 1}, {0x1772, 0x1773, 1}, {0x17B4, 0x17B5, 1}, {0x17B7, 0x17BD, 1},
+    {0x17C6, 0x17C6, 1}, {0x17C9, 0x17D3, 1}, {0x17D4, 0x17D6, 2}, {0x17D8, 0x17DA, 2}, {0x17DD, 0x17DD, 1}, {0x1800, 0x180A, 2},
+    {0x180B, 0x180D, 1}, {0x180E, 0x180E, 3}, {0x180F, 0x180F, 1}, {0x1885, 0x1886, 1}, {0x18A9, 0x18A9, 1}, {0x1920, 0x1922, 1},
+    {0x1927, 0x1928, 1}, {0x1932, 0x1932, 1}, {0x1939, 0x193B, 1}, {0x1944, 0x1945, 2}, {0x1A17, 0x1A18, 1}, {0x1A1B, 0x1A1B, 1},
+    {0x1A1E, 0x1A1F, 2}, {0x1A56, 0x1A56, 1}, {0x1A58, 0x1A5E, 1}, {0x1A60, 0x1A60, 1}, {0x1A62, 0x1A62, 1}, {0x1A65, 0x1A6C, 1},
+    {0x1A73, 0x1A7C, 1}, {0x1A7F, 0x1A7F, 1}, {0x1AA0, 0x1AA6, 2}, {0x1AA8, 0x1AAD, 2}, {0x1AB0, 0x1ABD, 1}, {0x1ABF, 0x1ACE, 1},
+    {0x1B00, 0x1B03, 1}, {0x1B34, 0x1B34, 1}, {0x1B36, 0x1B3A, 1}, {0x1B3C, 0x1B3C, 1}, {0x1B42, 0x1B42, 1}, {0x1B5A, 0x1B60, 2},
+    {0x1B6B, 0x1B73, 1}, {0x1B7D, 0x1B7E, 2}, {0x1B80, 0x1B81, 1}, {0x1BA2, 0x1BA5, 1}, {0x1BA8, 0x1BA9, 1}, {0x1BAB, 0x1BAD, 1},
+    {0x1BE6, 0x1BE6, 1}, {0x1BE8, 0x1BE9, 1}, {0x1BED, 0x1BED, 1}, {0x1BEF, 0x1BF1, 1}, {0x1BFC, 0x1BFF, 2}, {0x1C2C, 0x1C33, 1},
+    {0x1C36, 0x1C37, 1}, {0x1C3B, 0x1C3F, 2}, {0x1C7E, 0x1C7F, 2}, {0x1CC0, 0x1CC7, 2}, {0x1CD0, 0x1CD2, 1}, {0x1CD3, 0x1CD3, 2},
+    {0x1CD4, 0x1CE0, 1}, {0x1CE2, 0x1CE8, 1}, {0x1CED, 0x1CED, 1}, {0x1CF4, 0x1CF4, 1}, {0x1CF8, 0x1CF9, 1}, {0x1DC0, 0x1DFF, 1},
+    {0x2000, 0x200A, 4}, {0x200B, 0x200F, 3}, {0x2010, 0x2027, 2}, {0x202A, 0x202E, 3}, {0x202F, 0x202F, 4}, {0x2030, 0x2043, 2},
+    {0x2045, 0x2051, 2}, {0x2053, 0x205E, 2}, {0x205F, 0x205F, 4}, {0x2060, 0x2064, 3}, {0x2066, 0x206F, 3}, {0x207D, 0x207E, 2},
+    {0x208D, 0x208E, 2}, {0x20D0, 0x20DC, 1}, {0x20E1, 0x20E1, 1}, {0x20E5, 0x20F0, 1}, {0x2308, 0x230B, 2}, {0x2329, 0x232A, 2},
+    {0x2768, 0x2775, 2}, {0x27C5, 0x27C6, 2}, {0x27E6, 0x27EF, 2}, {0x2983, 0x2998, 2}, {0x29D8, 0x29DB, 2}, {0x29FC, 0x29FD, 2},
+    {0x2CEF, 0x2CF1, 1}, {0x2CF9, 0x2CFC, 2}, {0x2CFE, 0x2CFF, 2}, {0x2D70, 0x2D70, 2}, {0x2D7F, 0x2D7F, 1}, {0x2DE0, 0x2DFF, 1},
+    {0x2E00, 0x2E2E, 2}, {0x2E30, 0x2E4F, 2}, {0x2E52, 0x2E5D, 2}, {0x3000, 0x3000, 4}, {0x3001, 0x3003, 2}, {0x3008, 0x3011, 2},
+    {0x3014, 0x301F, 2}, {0x302A, 0x302D, 1}, {0x3030, 0x3030, 2}, {0x303D, 0x303D, 2}, {0x3099, 0x309A, 1}, {0x30A0, 0x30A0, 2},
+    {0x30FB, 0x30FB, 2}, {0xA4FE, 0xA4FF, 2}, {0xA60D, 0xA60F, 2}, {0xA66F, 0xA66F, 1}, {0xA673, 0xA673, 2}, {0xA674, 0xA67D, 1},
+    {0xA67E, 0xA67E, 2}, {0xA69E, 0xA69F, 1}, {0xA6F0, 0xA6F1, 1}, {0xA6F2, 0xA6F7, 2}, {0xA802, 0xA802, 1}, {0xA806, 0xA806, 1},
+    {0xA80B, 0xA80B, 1}, {0xA825, 0xA826, 1}, {0xA82C, 0xA82C, 1}, {0xA874, 0xA877, 2}, {0xA8C4, 0xA8C5, 1}, {0xA8CE, 0xA8CF, 2},
+    {0xA8E0, 0xA8F1, 1}, {0xA8F8, 0xA8FA, 2}, {0xA8FC, 0xA8FC, 2}, {0xA8FF, 0xA8FF, 1}, {0xA926, 0xA92D, 1}, {0xA92E, 0xA92F, 2},
+    {0xA947, 0xA951, 1}, {0xA95F, 0xA95F, 2}, {0xA980, 0xA982, 1}, {0xA9B3, 0xA9B3, 1}, {0xA9B6, 0xA9B9, 1}, {0xA9BC, 0xA9BD, 1},
+    {0xA9C1, 0xA9CD, 2}, {0xA9DE, 0xA9DF, 2}, {0xA9E5, 0xA9E5, 1}, {0xAA29, 0xAA2E, 1}, {0xAA31, 0xAA32, 1}, {0xAA35, 0xAA36, 1},
+    {0xAA43, 0xAA43, 1}, {0xAA4C, 0xAA4C, 1}, {0xAA5C, 0xAA5F, 2}, {0xAA7C, 0xAA7C, 1}, {0xAAB0, 0xAAB0, 1}, {0xAAB2, 0xAAB4, 1},
+    {0xAAB7, 0xAAB8, 1}, {0xAABE, 0xAABF, 1}, {0xAAC1, 0xAAC1, 1}, {0xAADE, 0xAADF, 2}, {0xAAEC, 0xAAED, 1}, {0xAAF0, 0xAAF1, 2},
+    {0xAAF6, 0xAAF6, 1}, {0xABE5, 0xABE5, 1}, {0xABE8, 0xABE8, 1}, {0xABEB, 0xABEB, 2}, {0xABED, 0xABED, 1}, {0xFB1E, 0xFB1E, 1},
+    {0xFD3E, 0xFD3F, 2}, {0xFE00, 0xFE0F, 1}, {0xFE10, 0xFE19, 2}, {0xFE20, 0xFE2F, 1}, {0xFE30, 0xFE52, 2}, {0xFE54, 0xFE61, 2},
+    {0xFE63, 0xFE63, 2}, {0xFE68, 0xFE68, 2}, {0xFE6A, 0xFE6B, 2}, {0xFEFF, 0xFEFF, 3}, {0xFF01, 0xFF03, 2}, {0xFF05, 0xFF0A, 2},
+    {0xFF0C, 0xFF0F, 2}, {0xFF1A, 0xFF1B, 2}, {0xFF1F, 0xFF20, 2}, {0xFF3B, 0xFF3D, 2}, {0xFF3F, 0xFF3F, 2}, {0xFF5B, 0xFF5B, 2},
+    {0xFF5D, 0xFF5D, 2}, {0xFF5F, 0xFF65, 2}, {0xFFF9, 0xFFFB, 3}, {0x10100, 0x10102, 2}, {0x101FD, 0x101FD, 1}, {0x102E0, 0x102E0, 1},
+    {0x10376, 0x1037A, 1}, {0x1039F, 0x1039F, 2}, {0x103D0, 0x103D0, 2}, {0x1056F, 0x1056F, 2}, {0x10857, 0x10857, 2}, {0x1091F, 0x1091F, 2},
+    {0x1093F, 0x1093F, 2}, {0x10A01, 0x10A03, 1}, {0x10A05, 0x10A06, 1}, {0x10A0C, 0x10A0F, 1}, {0x10A38, 0x10A3A, 1}, {0x10A3F, 0x10A3F, 1},
+    {0x10A50, 0x10A58, 2}, {0x10A7F, 0x10A7F, 2}, {0x10AE5, 0x10AE6, 1}, {0x10AF0, 0x10AF6, 2}, {0x10B39, 0x10B3F, 2}, {0x10B99, 0x10B9C, 2},
+    {0x10D24, 0x10D27, 1}, {0x10EAB, 0x10EAC, 1}, {0x10EAD, 0x10EAD, 2}, {0x10F46, 0x10F50, 1}, {0x10F55, 0x10F59, 2}, {0x10F82, 0x10F85, 1},
+    {0x10F86, 0x10F89, 2}, {0x11001, 0x11001, 1}, {0x11038, 0x11046, 1}, {0x11047, 0x1104D, 2}, {0x11070, 0x11070, 1}, {0x11073, 0x11074, 1},
+    {0x1107F, 0x11081, 1}, {0x110B3, 0x110B6, 1}, {0x110B9, 0x110BA, 1}, {0x110BB, 0x110BC, 2}, {0x110BD, 0x110BD, 3}, {0x110BE, 0x110C1, 2},
+    {0x110C2, 0x110C2, 1}, {0x110CD, 0x110CD, 3}, {0x11100, 0x11102, 1}, {0x11127, 0x1112B, 1}, {0x1112D, 0x11134, 1}, {0x11140, 0x11143, 2},
+    {0x11173, 0x11173, 1}, {0x11174, 0x11175, 2}, {0x11180, 0x11181, 1}, {0x111B6, 0x111BE, 1}, {0x111C5, 0x111C8, 2}, {0x111C9, 0x111CC, 1},
+    {0x111CD, 0x111CD, 2}, {0x111CF, 0x111CF, 1}, {0x111DB, 0x111DB, 2}, {0x111DD, 0x111DF, 2}, {0x1122F, 0x11231, 1}, {0x11234, 0x11234, 1},
+    {0x11236, 0x11237, 1}, {0x11238, 0x1123D, 2}, {0x1123E, 0x1123E, 1}, {0x112A9, 0x112A9, 2}, {0x112DF, 0x112DF, 1}, {0x112E3, 0x112EA, 1},
+    {0x11300, 0x11301, 1}, {0x1133B, 0x1133C, 1}, {0x11340, 0x11340, 1}, {0x11366, 0x1136C, 1}, {0x11370, 0x11374, 1}, {0x11438, 0x1143F, 1},
+    {0x11442, 0x11444, 1}, {0x11446, 0x11446, 1}, {0x1144B, 0x1144F, 2}, {0x1145A, 0x1145B, 2}, {0x1145D, 0x1145D, 2}, {0x1145E, 0x1145E, 1},
+    {0x114B3, 0x114B8, 1}, {0x114BA, 0x114BA, 1}, {0x114BF, 0x114C0, 1}, {0x114C2, 0x114C3, 1}, {0x114C6, 0x114C6, 2}, {0x115B2, 0x115B5, 1},
+    {0x115BC, 0x115BD, 1}, {0x115BF, 0x115C0, 1}, {0x115C1, 0x115D7, 2}, {0x115DC, 0x115DD, 1}, {0x11633, 0x1163A, 1}, {0x1163D, 0x1163D, 1},
+    {0x1163F, 0x11640, 1}, {0x11641, 0x11643, 2}, {0x11660, 0x1166C, 2}, {0x116AB, 0x116AB, 1}, {0x116AD, 0x116AD, 1}, {0x116B0, 0x116B5, 1},
+    {0x116B7, 0x116B7, 1}, {0x116B9, 0x116B9, 2}, {0x1171D, 0x1171F, 1}, {0x11722, 0x11725, 1}, {0x11727, 0x1172B, 1}, {0x1173C, 0x1173E, 2},
+    {0x1182F, 0x11837, 1}, {0x11839, 0x1183A, 1}, {0x1183B, 0x1183B, 2}, {0x1193B, 0x1193C, 1}, {0x1193E, 0x1193E, 1}, {0x11943, 0x11943, 1},
+    {0x11944, 0x11946, 2}, {0x119D4, 0x119D7, 1}, {0x119DA, 0x119DB, 1}, {0x119E0, 0x119E0, 1}, {0x119E2, 0x119E2, 2}, {0x11A01, 0x11A0A, 1},
+    {0x11A33, 0x11A38, 1}, {0x11A3B, 0x11A3E, 1}, {0x11A3F, 0x11A46, 2}, {0x11A47, 0x11A47, 1}, {0x11A51, 0x11A56, 1}, {0x11A59, 0x11A5B, 1},
+    {0x11A8A, 0x11A96, 1}, {0x11A98, 0x11A99, 1}, {0x11A9A, 0x11A9C, 2}, {0x11A9E, 0x11AA2, 2}, {0x11C30, 0x11C36, 1}, {0x11C38, 0x11C3D, 1},
+    {0x11C3F, 0x11C3F, 1}, {0x11C41, 0x11C45, 2}, {0x11C70, 0x11C71, 2}, {0x11C92, 0x11CA7, 1}, {0x11CAA, 0x11CB0, 1}, {0x11CB2, 0x11CB3, 1},
+    {0x11CB5, 0x11CB6, 1}, {0x11D31, 0x11D36, 1}, {0x11D3A, 0x11D3A, 1}, {0x11D3C, 0x11D3D, 1}, {0x11D3F, 0x11D45, 1}, {0x11D47, 0x11D47, 1},
+    {0x11D90, 0x11D91, 1}, {0x11D95, 0x11D95, 1}, {0x11D97, 0x11D97, 1}, {0x11EF3, 0x11EF4, 1}, {0x11EF7, 0x11EF8, 2}, {0x11FFF, 0x11FFF, 2},
+    {0x12470, 0x12474, 2}, {0x12FF1, 0x12FF2, 2}, {0x13430, 0x13438, 3}, {0x16A6E, 0x16A6F, 2}, {0x16AF0, 0x16AF4, 1}, {0x16AF5, 0x16AF5, 2},
+    {0x16B30, 0x16B36, 1}, {0x16B37, 0x16B3B, 2}, {0x16B44, 0x16B44, 2}, {0x16E97, 0x16E9A, 2}, {0x16F4F, 0x16F4F, 1}, {0x16F8F, 0x16F92, 1},
+    {0x16FE2, 0x16FE2, 2}, {0x16FE4, 0x16FE4, 1}, {0x1BC9D, 0x1BC9E, 1}, {0x1BC9F, 0x1BC9F, 2}, {0x1BCA0, 0x1BCA3, 3}, {0x1CF00, 0x1CF2D, 1},
+    {0x1CF30, 0x1CF46, 1}, {0x1D167, 0x1D169, 1}, {0x1D173, 0x1D17A, 3}, {0x1D17B, 0x1D182, 1}, {0x1D185, 0x1D18B, 1}, {0x1D1AA, 0x1D1AD, 1},
+    {0x1D242, 0x1D244, 1}, {0x1DA00, 0x1DA36, 1}, {0x1DA3B, 0x1DA6C, 1}, {0x1DA75, 0x1DA75, 1}, {0x1DA84, 0x1DA84, 1}, {0x1DA87, 0x1DA8B, 2},
+    {0x1DA9B, 0x1DA9F, 1}, {0x1DAA1, 0x1DAAF, 1}, {0x1E000, 0x1E006, 1}, {0x1E008, 0x1E018, 1}, {0x1E01B, 0x1E021, 1}, {0x1E023, 0x1E024, 1},
+    {0x1E026, 0x1E02A, 1}, {0x1E130, 0x1E136, 1}, {0x1E2AE, 0x1E2AE, 1}, {0x1E2EC, 0x1E2EF, 1}, {0x1E8D0, 0x1E8D6, 1}, {0x1E944, 0x1E94A, 1},
+    {0x1E95E, 0x1E95F, 2}, {0xE0001, 0xE0001, 3}, {0xE0020, 0xE007F, 3}, {0xE0100, 0xE01EF, 1},
+};
+
+// lower case and nfd without nonspacing marks of bmp code points, hangul syllables are decomposed apart
+static const uint32_t bert_folds[][2] = {
+    {0xC0, 0x61}, {0xC1, 0x61}, {0xC2, 0x61}, {0xC3, 0x61}, {0xC4, 0x61}, {0xC5, 0x61}, {0xC6, 0xE6}, {0xC7, 0x63}, {0xC8, 0x65}, {0xC9, 0x65},
+    {0xCA, 0x65}, {0xCB, 0x65}, {0xCC, 0x69}, {0xCD, 0x69}, {0xCE, 0x69}, {0xCF, 0x69}, {0xD0, 0xF0}, {0xD1, 0x6E}, {0xD2, 0x6F}, {0xD3, 0x6F},
+    {0xD4, 0x6F}, {0xD5, 0x6F}, {0xD6, 0x6F}, {0xD8, 0xF8}, {0xD9, 0x75}, {0xDA, 0x75}, {0xDB, 0x75}, {0xDC, 0x75}, {0xDD, 0x79}, {0xDE, 0xFE},
+    {0xE0, 0x61}, {0xE1, 0x61}, {0xE2, 0x61}, {0xE3, 0x61}, {0xE4, 0x61}, {0xE5, 0x61}, {0xE7, 0x63}, {0xE8, 0x65}, {0xE9, 0x65}, {0xEA, 0x65},
+    {0xEB, 0x65}, {0xEC, 0x69}, {0xED, 0x69}, {0xEE, 0x69}, {0xEF, 0x69}, {0xF1, 0x6E}, {0xF2, 0x6F}, {0xF3, 0x6F}, {0xF4, 0x6F}, {0xF5, 0x6F},
+    {0xF6, 0x6F}, {0xF9, 0x75}, {0xFA, 0x75}, {0xFB, 0x75}, {0xFC, 0x75}, {0xFD, 0x79}, {0xFF, 0x79}, {0x100, 0x61}, {0x101, 0x61}, {0x102, 0x61},
+    {0x103, 0x61}, {0x104, 0x61}, {0x105, 0x61}, {0x106, 0x63}, {0x107, 0x63}, {0x108, 0x63}, {0x109, 0x63}, {0x10A, 0x63}, {0x10B, 0x63}, {0x10C, 0x63},
+    {0x10D, 0x63}, {0x10E, 0x64}, {0x10F, 0x64}, {0x110, 0x111}, {0x112, 0x65}, {0x113, 0x65}, {0x114, 0x65}, {0x115, 0x65}, {0x116, 0x65}, {0x117, 0x65},
+    {0x118, 0x65}, {0x119, 0x65}, {0x11A, 0x65}, {0x11B, 0x65}, {0x11C, 0x67}, {0x11D, 0x67}, {0x11E, 0x67}, {0x11F, 0x67}, {0x120, 0x67}, {0x121, 0x67},
+    {0x122, 0x67}, {0x123, 0x67}, {0x124, 0x68}, {0x125, 0x68}, {0x126, 0x127}, {0x128, 0x69}, {0x129, 0x69}, {0x12A, 0x69}, {0x12B, 0x69}, {0x12C, 0x69},
+    {0x12D, 0x69}, {0x12E, 0x69}, {0x12F, 0x69}, {0x130, 0x69}, {0x132, 0x133}, {0x134, 0x6A}, {0x135, 0x6A}, {0x136, 0x6B}, {0x137, 0x6B}, {0x139, 0x6C},
+    {0x13A, 0x6C}, {0x13B, 0x6C}, {0x13C, 0x6C}, {0x13D, 0x6C}, {0x13E, 0x6C}, {0x13F, 0x140}, {0x141, 0x142}, {0x143, 0x6E}, {0x144, 0x6E}, {0x145, 0x6E},
+    {0x146, 0x6E}, {0x147, 0x6E}, {0x148, 0x6E}, {0x14A, 0x14B}, {0x14C, 0x6F}, {0x14D, 0x6F}, {0x14E, 0x6F}, {0x14F, 0x6F}, {0x150, 0x6F}, {0x151, 0x6F},
+    {0x152, 0x153}, {0x154, 0x72}, {0x155, 0x72}, {0x156, 0x72}, {0x157, 0x72}, {0x158, 0x72}, {0x159, 0x72}, {0x15A, 0x73}, {0x15B, 0x73}, {0x15C, 0x73},
+    {0x15D, 0x73}, {0x15E, 0x73}, {0x15F, 0x73}, {0x160, 0x73}, {0x161, 0x73}, {0x162, 0x74}, {0x163, 0x74}, {0x164, 0x74}, {0x165, 0x74}, {0x166, 0x167},
+    {0x168, 0x75}, {0x169, 0x75}, {0x16A, 0x75}, {0x16B, 0x75}, {0x16C, 0x75}, {0x16D, 0x75}, {0x16E, 0x75}, {0x16F, 0x75}, {0x170, 0x75}, {0x171, 0x75},
+    {0x172, 0x75}, {0x173, 0x75}, {0x174, 0x77}, {0x175, 0x77}, {0x176, 0x79}, {0x177, 0x79}, {0x178, 0x79}, {0x179, 0x7A}, {0x17A, 0x7A}, {0x17B, 0x7A},
+    {0x17C, 0x7A}, {0x17D, 0x7A}, {0x17E, 0x7A}, {0x181, 0x253}, {0x182, 0x183}, {0x184, 0x185}, {0x186, 0x254}, {0x187, 0x188}, {0x189, 0x256}, {0x18A, 0x257},
+    {0x18B, 0x18C}, {0x18E, 0x1DD}, {0x18F, 0x259}, {0x190, 0x25B}, {0x191, 0x192}, {0x193, 0x260}, {0x194, 0x263}, {0x196, 0x269}, {0x197, 0x268}, {0x198, 0x199},
+    {0x19C, 0x26F}, {0x19D, 0x272}, {0x19F, 0x275}, {0x1A0, 0x6F}, {0x1A1, 0x6F}, {0x1A2, 0x1A3}, {0x1A4, 0x1A5}, {0x1A6, 0x280}, {0x1A7, 0x1A8}, {0x1A9, 0x283},
+    {0x1AC, 0x1AD}, {0x1AE, 0x288}, {0x1AF, 0x75}, {0x1B0, 0x75}, {0x1B1, 0x28A}, {0x1B2, 0x28B}, {0x1B3, 0x1B4}, {0x1B5, 0x1B6}, {0x1B7, 0x292}, {0x1B8, 0x1B9},
+    {0x1BC, 0x1BD}, {0x1C4, 0x1C6}, {0x1C5, 0x1C6}, {0x1C7, 0x1C9}, {0x1C8, 0x1C9}, {0x1CA, 0x1CC}, {0x1CB, 0x1CC}, {0x1CD, 0x61}, {0x1CE, 0x61}, {0x1CF, 0x69},
+    {0x1D0, 0x69}, {0x1D1, 0x6F}, {0x1D2, 0x6F}, {0x1D3, 0x75}, {0x1D4, 0x75}, {0x1D5, 0x75}, {0x1D6, 0x75}, {0x1D7, 0x75}, {0x1D8, 0x75}, {0x1D9, 0x75},
+    {0x1DA, 0x75}, {0x1DB, 0x75}, {0x1DC, 0x75}, {0x1DE, 0x61}, {0x1DF, 0x61}, {0x1E0, 0x61}, {0x1E1, 0x61}, {0x1E2, 0xE6}, {0x1E3, 0xE6}, {0x1E4, 0x1E5},
+    {0x1E6, 0x67}, {0x1E7, 0x67}, {0x1E8, 0x6B}, {0x1E9, 0x6B}, {0x1EA, 0x6F}, {0x1EB, 0x6F}, {0x1EC, 0x6F}, {0x1ED, 0x6F}, {0x1EE, 0x292}, {0x1EF, 0x292},
+    {0x1F0, 0x6A}, {0x1F1, 0x1F3}, {0x1F2, 0x1F3}, {0x1F4, 0x67}, {0x1F5, 0x67}, {0x1F6, 0x195}, {0x1F7, 0x1BF}, {0x1F8, 0x6E}, {0x1F9, 0x6E}, {0x1FA, 0x61},
+    {0x1FB, 0x61}, {0x1FC, 0xE6}, {0x1FD, 0xE6}, {0x1FE, 0xF8}, {0x1FF, 0xF8}, {0x200, 0x61}, {0x201, 0x61}, {0x202, 0x61}, {0x203, 0x61}, {0x204, 0x65},
+    {0x205, 0x65}, {0x206, 0x65}, {0x207, 0x65}, {0x208, 0x69}, {0x209, 0x69}, {0x20A, 0x69}, {0x20B, 0x69}, {0x20C, 0x6F}, {0x20D, 0x6F}, {0x20E, 0x6F},
+    {0x20F, 0x6F}, {0x210, 0x72}, {0x211, 0x72}, {0x212, 0x72}, {0x213, 0x72}, {0x214, 0x75}, {0x215, 0x75}, {0x216, 0x75}, {0x217, 0x75}, {0x218, 0x73},
+    {0x219, 0x73}, {0x21A, 0x74}, {0x21B, 0x74}, {0x21C, 0x21D}, {0x21E, 0x68}, {0x21F, 0x68}, {0x220, 0x19E}, {0x222, 0x223}, {0x224, 0x225}, {0x226, 0x61},
+    {0x227, 0x61}, {0x228, 0x65}, {0x229, 0x65}, {0x22A, 0x6F}, {0x22B, 0x6F}, {0x22C, 0x6F}, {0x22D, 0x6F}, {0x22E, 0x6F}, {0x22F, 0x6F}, {0x230, 0x6F},
+    {0x231, 0x6F}, {0x232, 0x79}, {0x233, 0x79}, {0x23A, 0x2C65}, {0x23B, 0x23C}, {0x23D, 0x19A}, {0x23E, 0x2C66}, {0x241, 0x242}, {0x243, 0x180}, {0x244, 0x289},
+    {0x245, 0x28C}, {0x246, 0x247}, {0x248, 0x249}, {0x24A, 0x24B}, {0x24C, 0x24D}, {0x24E, 0x24F}, {0x370, 0x371}, {0x372, 0x373}, {0x374, 0x2B9}, {0x376, 0x377},
+    {0x37E, 0x3B}, {0x37F, 0x3F3}, {0x385, 0xA8}, {0x386, 0x3B1}, {0x387, 0xB7}, {0x388, 0x3B5}, {0x389, 0x3B7}, {0x38A, 0x3B9}, {0x38C, 0x3BF}, {0x38E, 0x3C5},
+    {0x38F, 0x3C9}, {0x390, 0x3B9}, {0x391, 0x3B1}, {0x392, 0x3B2}, {0x393, 0x3B3}, {0x394, 0x3B4}, {0x395, 0x3B5}, {0x396, 0x3B6}, {0x397, 0x3B7}, {0x398, 0x3B8},
+    {0x399, 0x3B9}, {0x39A, 0x3BA}, {0x39B, 0x3BB}, {0x39C, 0x3BC}, {0x39D, 0x3BD}, {0x39E, 0x3BE}, {0x39F, 0x3BF}, {0x3A0, 0x3C0}, {0x3A1, 0x3C1}, {0x3A3, 0x3C3},
+    {0x3A4, 0x3C4}, {0x3A5, 0x3C5}, {0x3A6, 0x3C6}, {0x3A7, 0x3C7}, {0x3A8, 0x3C8}, {0x3A9, 0x3C9}, {0x3AA, 0x3B9}, {0x3AB, 0x3C5}, {0x3AC, 0x3B1}, {0x3AD, 0x3B5},
+    {0x3AE, 0x3B7}, {0x3AF, 0x3B9}, {0x3B0, 0x3C5}, {0x3CA, 0x3B9}, {0x3CB, 0x3C5}, {0x3CC, 0x3BF}, {0x3CD, 0x3C5}, {0x3CE, 0x3C9}, {0x3CF, 0x3D7}, {0x3D3, 0x3D2},
+    {0x3D4, 0x3D2}, {0x3D8, 0x3D9}, {0x3DA, 0x3DB}, {0x3DC, 0x3DD}, {0x3DE, 0x3DF}, {0x3E0, 0x3E1}, {0x3E2, 0x3E3}, {0x3E4, 0x3E5}, {0x3E6, 0x3E7}, {0x3E8, 0x3E9},
+    {0x3EA, 0x3EB}, {0x3EC, 0x3ED}, {0x3EE, 0x3EF}, {0x3F4, 0x3B8}, {0x3F7, 0x3F8}, {0x3F9, 0x3F2}, {0x3FA, 0x3FB}, {0x3FD, 0x37B}, {0x3FE, 0x37C}, {0x3FF, 0x37D},
+    {0x400, 0x435}, {0x401, 0x435}, {0x402, 0x452}, {0x403, 0x433}, {0x404, 0x454}, {0x405, 0x455}, {0x406, 0x456}, {0x407, 0x456}, {0x408, 0x458}, {0x409, 0x459},
+    {0x40A, 0x45A}, {0x40B, 0x45B}, {0x40C, 0x43A}, {0x40D, 0x438}, {0x40E, 0x443}, {0x40F, 0x45F}, {0x410, 0x430}, {0x411, 0x431}, {0x412, 0x432}, {0x413, 0x433},
+    {0x414, 0x434}, {0x415, 0x435}, {0x416, 0x436}, {0x417, 0x437}, {0x418, 0x438}, {0x419, 0x438}, {0x41A, 0x43A}, {0x41B, 0x43B}, {0x41C, 0x43C}, {0x41D, 0x43D},
+    {0x41E, 0x43E}, {0x41F, 0x43F}, {0x420, 0x440}, {0x421, 0x441}, {0x422, 0x442}, {0x423, 0x443}, {0x424, 0x444}, {0x425, 0x445}, {0x426, 0x446}, {0x427, 0x447},
+    {0x428, 0x448}, {0x429, 0x449}, {0x42A, 0x44A}, {0x42B, 0x44B}, {0x42C, 0x44C}, {0x42D, 0x44D}, {0x42E, 0x44E}, {0x42F, 0x44F}, {0x439, 0x438}, {0x450, 0x435},
+    {0x451, 0x435}, {0x453, 0x433}, {0x457, 0x456}, {0x45C, 0x43A}, {0x45D, 0x438}, {0x45E, 0x443}, {0x460, 0x461}, {0x462, 0x463}, {0x464, 0x465}, {0x466, 0x467},
+    {0x468, 0x469}, {0x46A, 0x46B}, {0x46C, 0x46D}, {0x46E, 0x46F}, {0x470, 0x471}, {0x472, 0x473}, {0x474, 0x475}, {0x476, 0x475}, {0x477, 0x475}, {0x478, 0x479},
+    {0x47A, 0x47B}, {0x47C, 0x47D}, {0x47E, 0x47F}, {0x480, 0x481}, {0x48A, 0x48B}, {0x48C, 0x48D}, {0x48E, 0x48F}, {0x490, 0x491}, {0x492, 0x493}, {0x494, 0x495},
+    {0x496, 0x497}, {0x498, 0x499}, {0x49A, 0x49B}, {0x49C, 0x49D}, {0x49E, 0x49F}, {0x4A0, 0x4A1}, {0x4A2, 0x4A3}, {0x4A4, 0x4A5}, {0x4A6, 0x4A7}, {0x4A8, 0x4A9},
+    {0x4AA, 0x4AB}, {0x4AC, 0x4AD}, {0x4AE, 0x4AF}, {0x4B0, 0x4B1}, {0x4B2, 0x4B3}, {0x4B4, 0x4B5}, {0x4B6, 0x4B7}, {0x4B8, 0x4B9}, {0x4BA, 0x4BB}, {0x4BC, 0x4BD},
+    {0x4BE, 0x4BF}, {0x4C0, 0x4CF}, {0x4C1, 0x436}, {0x4C2, 0x436}, {0x4C3, 0x4C4}, {0x4C5, 0x4C6}, {0x4C7, 0x4C8}, {0x4C9, 0x4CA}, {0x4CB, 0x4CC}, {0x4CD, 0x4CE},
+    {0x4D0, 0x430}, {0x4D1, 0x430}, {0x4D2, 0x430}, {0x4D3, 0x430}, {0x4D4, 0x4D5}, {0x4D6, 0x435}, {0x4D7, 0x435}, {0x4D8, 0x4D9}, {0x4DA, 0x4D9}, {0x4DB, 0x4D9},
+    {0x4DC, 0x436}, {0x4DD, 0x436}, {0x4DE, 0x437}, {0x4DF, 0x437}, {0x4E0, 0x4E1}, {0x4E2, 0x438}, {0x4E3, 0x438}, {0x4E4, 0x438}, {0x4E5, 0x438}, {0x4E6, 0x43E},
+    {0x4E7, 0x43E}, {0x4E8, 0x4E9}, {0x4EA, 0x4E9}, {0x4EB, 0x4E9}, {0x4EC, 0x44D}, {0x4ED, 0x44D}, {0x4EE, 0x443}, {0x4EF, 0x443}, {0x4F0, 0x443}, {0x4F1, 0x443},
+    {0x4F2, 0x443}, {0x4F3, 0x443}, {0x4F4, 0x447}, {0x4F5, 0x447}, {0x4F6, 0x4F7}, {0x4F8, 0x44B}, {0x4F9, 0x44B}, {0x4FA, 0x4FB}, {0x4FC, 0x4FD}, {0x4FE, 0x4FF},
+    {0x500, 0x501}, {0x502, 0x503}, {0x504, 0x505}, {0x506, 0x507}, {0x508, 0x509}, {0x50A, 0x50B}, {0x50C, 0x50D}, {0x50E, 0x50F}, {0x510, 0x511}, {0x512, 0x513},
+    {0x514, 0x515}, {0x516, 0x517}, {0x518, 0x519}, {0x51A, 0x51B}, {0x51C, 0x51D}, {0x51E, 0x51F}, {0x520, 0x521}, {0x522, 0x523}, {0x524, 0x525}, {0x526, 0x527},
+    {0x528, 0x529}, {0x52A, 0x52B}, {0x52C, 0x52D}, {0x52E, 0x52F}, {0x531, 0x561}, {0x532, 0x562}, {0x533, 0x563}, {0x534, 0x564}, {0x535, 0x565}, {0x536, 0x566},
+    {0x537, 0x567}, {0x538, 0x568}, {0x539, 0x569}, {0x53A, 0x56A}, {0x53B, 0x56B}, {0x53C, 0x56C}, {0x53D, 0x56D}, {0x53E, 0x56E}, {0x53F, 0x56F}, {0x540, 0x570},
+    {0x541, 0x571}, {0x542, 0x572}, {0x543, 0x573}, {0x544, 0x574}, {0x545, 0x575}, {0x546, 0x576}, {0x547, 0x577}, {0x548, 0x578}, {0x549, 0x579}, {0x54A, 0x57A},
+    {0x54B, 0x57B}, {0x54C, 0x57C}, {0x54D, 0x57D}, {0x54E, 0x57E}, {0x54F, 0x57F}, {0x550, 0x580}, {0x551, 0x581}, {0x552, 0x582}, {0x553, 0x583}, {0x554, 0x584},
+    {0x555, 0x585}, {0x556, 0x586}, {0x622, 0x627}, {0x623, 0x627}, {0x624, 0x648}, {0x625, 0x627}, {0x626, 0x64A}, {0x6C0, 0x6D5}, {0x6C2, 0x6C1}, {0x6D3, 0x6D2},
+    {0x929, 0x928}, {0x931, 0x930}, {0x934, 0x933}, {0x958, 0x915}, {0x959, 0x916}, {0x95A, 0x917}, {0x95B, 0x91C}, {0x95C, 0x921}, {0x95D, 0x922}, {0x95E, 0x92B},
+    {0x95F, 0x92F}, {0x9DC, 0x9A1}, {0x9DD, 0x9A2}, {0x9DF, 0x9AF}, {0xA33, 0xA32}, {0xA36, 0xA38}, {0xA59, 0xA16}, {0xA5A, 0xA17}, {0xA5B, 0xA1C}, {0xA5E, 0xA2B},
+    {0xB48, 0xB47}, {0xB5C, 0xB21}, {0xB5D, 0xB22}, {0xCC0, 0xCD5}, {0xCC7, 0xCD5}, {0xCC8, 0xCD6}, {0xCCA, 0xCC2}, {0xDDA, 0xDD9}, {0xF43, 0xF42}, {0xF4D, 0xF4C},
+    {0xF52, 0xF51}, {0xF57, 0xF56}, {0xF5C, 0xF5B}, {0xF69, 0xF40}, {0x1026, 0x1025}, {0x10A0, 0x2D00}, {0x10A1, 0x2D01}, {0x10A2, 0x2D02}, {0x10A3, 0x2D03}, {0x10A4, 0x2D04},
+    {0x10A5, 0x2D05}, {0x10A6, 0x2D06}, {0x10A7, 0x2D07}, {0x10A8, 0x2D08}, {0x10A9, 0x2D09}, {0x10AA, 0x2D0A}, {0x10AB, 0x2D0B}, {0x10AC, 0x2D0C}, {0x10AD, 0x2D0D}, {0x10AE, 0x2D0E},
+    {0x10AF, 0x2D0F}, {0x10B0, 0x2D10}, {0x10B1, 0x2D11}, {0x10B2, 0x2D12}, {0x10B3, 0x2D13}, {0x10B4, 0x2D14}, {0x10B5, 0x2D15}, {0x10B6, 0x2D16}, {0x10B7, 0x2D17}, {0x10B8, 0x2D18},
+    {0x10B9, 0x2D19}, {0x10BA, 0x2D1A}, {0x10BB, 0x2D1B}, {0x10BC, 0x2D1C}, {0x10BD, 0x2D1D}, {0x10BE, 0x2D1E}, {0x10BF, 0x2D1F}, {0x10C0, 0x2D20}, {0x10C1, 0x2D21}, {0x10C2, 0x2D22},
+    {0x10C3, 0x2D23}, {0x10C4, 0x2D24}, {0x10C5, 0x2D25}, {0x10C7, 0x2D27}, {0x10CD, 0x2D2D}, {0x13A0, 0xAB70}, {0x13A1, 0xAB71}, {0x13A2, 0xAB72}, {0x13A3, 0xAB73}, {0x13A4, 0xAB74},
+    {0x13A5, 0xAB75}, {0x13A6, 0xAB76}, {0x13A7, 0xAB77}, {0x13A8, 0xAB78}, {0x13A9, 0xAB79}, {0x13AA, 0xAB7A}, {0x13AB, 0xAB7B}, {0x13AC, 0xAB7C}, {0x13AD, 0xAB7D}, {0x13AE, 0xAB7E},
+    {0x13AF, 0xAB7F}, {0x13B0, 0xAB80}, {0x13B1, 0xAB81}, {0x13B2, 0xAB82}, {0x13B3, 0xAB83}, {0x13B4, 0xAB84}, {0x13B5, 0xAB85}, {0x13B6, 0xAB86}, {0x13B7, 0xAB87}, {0x13B8, 0xAB88},
+    {0x13B9, 0xAB89}, {0x13BA, 0xAB8A}, {0x13BB, 0xAB8B}, {0x13BC, 0xAB8C}, {0x13BD, 0xAB8D}, {0x13BE, 0xAB8E}, {0x13BF, 0xAB8F}, {0x13C0, 0xAB90}, {0x13C1, 0xAB91}, {0x13C2, 0xAB92},
+    {0x13C3, 0xAB93}, {0x13C4, 0xAB94}, {0x13C5, 0xAB95}, {0x13C6, 0xAB96}, {0x13C7, 0xAB97}, {0x13C8, 0xAB98}, {0x13C9, 0xAB99}, {0x13CA, 0xAB9A}, {0x13CB, 0xAB9B}, {0x13CC, 0xAB9C},
+    {0x13CD, 0xAB9D}, {0x13CE, 0xAB9E}, {0x13CF, 0xAB9F}, {0x13D0, 0xABA0}, {0x13D1, 0xABA1}, {0x13D2, 0xABA2}, {0x13D3, 0xABA3}, {0x13D4, 0xABA4}, {0x13D5, 0xABA5}, {0x13D6, 0xABA6},
+    {0x13D7, 0xABA7}, {0x13D8, 0xABA8}, {0x13D9, 0xABA9}, {0x13DA, 0xABAA}, {0x13DB, 0xABAB}, {0x13DC, 0xABAC}, {0x13DD, 0xABAD}, {0x13DE, 0xABAE}, {0x13DF, 0xABAF}, {0x13E0, 0xABB0},
+    {0x13E1, 0xABB1}, {0x13E2, 0xABB2}, {0x13E3, 0xABB3}, {0x13E4, 0xABB4}, {0x13E5, 0xABB5}, {0x13E6, 0xABB6}, {0x13E7, 0xABB7}, {0x13E8, 0xABB8}, {0x13E9, 0xABB9}, {0x13EA, 0xABBA},
+    {0x13EB, 0xABBB}, {0x13EC, 0xABBC}, {0x13ED, 0xABBD}, {0x13EE, 0xABBE}, {0x13EF, 0xABBF}, {0x13F0, 0x13F8}, {0x13F1, 0x13F9}, {0x13F2, 0x13FA}, {0x13F3, 0x13FB}, {0x13F4, 0x13FC},
+    {0x13F5, 0x13FD}, {0x1B3B, 0x1B35}, {0x1B3D, 0x1B35}, {0x1B43, 0x1B35}, {0x1C90, 0x10D0}, {0x1C91, 0x10D1}, {0x1C92, 0x10D2}, {0x1C93, 0x10D3}, {0x1C94, 0x10D4}, {0x1C95, 0x10D5},
+    {0x1C96, 0x10D6}, {0x1C97, 0x10D7}, {0x1C98, 0x10D8}, {0x1C99, 0x10D9}, {0x1C9A, 0x10DA}, {0x1C9B, 0x10DB}, {0x1C9C, 0x10DC}, {0x1C9D, 0x10DD}, {0x1C9E, 0x10DE}, {0x1C9F, 0x10DF},
+    {0x1CA0, 0x10E0}, {0x1CA1, 0x10E1}, {0x1CA2, 0x10E2}, {0x1CA3, 0x10E3}, {0x1CA4, 0x10E4}, {0x1CA5, 0x10E5}, {0x1CA6, 0x10E6}, {0x1CA7, 0x10E7}, {0x1CA8, 0x10E8}, {0x1CA9, 0x10E9},
+    {0x1CAA, 0x10EA}, {0x1CAB, 0x10EB}, {0x1CAC, 0x10EC}, {0x1CAD, 0x10ED}, {0x1CAE, 0x10EE}, {0x1CAF, 0x10EF}, {0x1CB0, 0x10F0}, {0x1CB1, 0x10F1}, {0x1CB2, 0x10F2}, {0x1CB3, 0x10F3},
+    {0x1CB4, 0x10F4}, {0x1CB5, 0x10F5}, {0x1CB6, 0x10F6}, {0x1CB7, 0x10F7}, {0x1CB8, 0x10F8}, {0x1CB9, 0x10F9}, {0x1CBA, 0x10FA}, {0x1CBD, 0x10FD}, {0x1CBE, 0x10FE}, {0x1CBF, 0x10FF},
+    {0x1E00, 0x61}, {0x1E01, 0x61}, {0x1E02, 0x62}, {0x1E03, 0x62}, {0x1E04, 0x62}, {0x1E05, 0x62}, {0x1E06, 0x62}, {0x1E07, 0x62}, {0x1E08, 0x63}, {0x1E09, 0x63},
+    {0x1E0A, 0x64}, {0x1E0B, 0x64}, {0x1E0C, 0x64}, {0x1E0D, 0x64}, {0x1E0E, 0x64}, {0x1E0F, 0x64}, {0x1E10, 0x64}, {0x1E11, 0x64}, {0x1E12, 0x64}, {0x1E13, 0x64},
+    {0x1E14, 0x65}, {0x1E15, 0x65}, {0x1E16, 0x65}, {0x1E17, 0x65}, {0x1E18, 0x65}, {0x1E19, 0x65}, {0x1E1A, 0x65}, {0x1E1B, 0x65}, {0x1E1C, 0x65}, {0x1E1D, 0x65},
+    {0x1E1E, 0x66}, {0x1E1F, 0x66}, {0x1E20, 0x67}, {0x1E21, 0x67}, {0x1E22, 0x68}, {0x1E23, 0x68}, {0x1E24, 0x68}, {0x1E25, 0x68}, {0x1E26, 0x68}, {0x1E27, 0x68},
+    {0x1E28, 0x68}, {0x1E29, 0x68}, {0x1E2A, 0x68}, {0x1E2B, 0x68}, {0x1E2C, 0x69}, {0x1E2D, 0x69}, {0x1E2E, 0x69}, {0x1E2F, 0x69}, {0x1E30, 0x6B}, {0x1E31, 0x6B},
+    {0x1E32, 0x6B}, {0x1E33, 0x6B}, {0x1E34, 0x6B}, {0x1E35, 0x6B}, {0x1E36, 0x6C}, {0x1E37, 0x6C}, {0x1E38, 0x6C}, {0x1E39, 0x6C}, {0x1E3A, 0x6C}, {0x1E3B, 0x6C},
+    {0x1E3C, 0x6C}, {0x1E3D, 0x6C}, {0x1E3E, 0x6D}, {0x1E3F, 0x6D}, {0x1E40, 0x6D}, {0x1E41, 0x6D}, {0x1E42, 0x6D}, {0x1E43, 0x6D}, {0x1E44, 0x6E}, {0x1E45, 0x6E},
+    {0x1E46, 0x6E}, {0x1E47, 0x6E}, {0x1E48, 0x6E}, {0x1E49, 0x6E}, {0x1E4A, 0x6E}, {0x1E4B, 0x6E}, {0x1E4C, 0x6F}, {0x1E4D, 0x6F}, {0x1E4E, 0x6F}, {0x1E4F, 0x6F},
+    {0x1E50, 0x6F}, {0x1E51, 0x6F}, {0x1E52, 0x6F}, {0x1E53, 0x6F}, {0x1E54, 0x70}, {0x1E55, 0x70}, {0x1E56, 0x70}, {0x1E57, 0x70}, {0x1E58, 0x72}, {0x1E59, 0x72},
+    {0x1E5A, 0x72}, {0x1E5B, 0x72}, {0x1E5C, 0x72}, {0x1E5D, 0x72}, {0x1E5E, 0x72}, {0x1E5F, 0x72}, {0x1E60, 0x73}, {0x1E61, 0x73}, {0x1E62, 0x73}, {0x1E63, 0x73},
+    {0x1E64, 0x73}, {0x1E65, 0x73}, {0x1E66, 0x73}, {0x1E67, 0x73}, {0x1E68, 0x73}, {0x1E69, 0x73}, {0x1E6A, 0x74}, {0x1E6B, 0x74}, {0x1E6C, 0x74}, {0x1E6D, 0x74},
+    {0x1E6E, 0x74}, {0x1E6F, 0x74}, {0x1E70, 0x74}, {0x1E71, 0x74}, {0x1E72, 0x75}, {0x1E73, 0x75}, {0x1E74, 0x75}, {0x1E75, 0x75}, {0x1E76, 0x75}, {0x1E77, 0x75},
+    {0x1E78, 0x75}, {0x1E79, 0x75}, {0x1E7A, 0x75}, {0x1E7B, 0x75}, {0x1E7C, 0x76}, {0x1E7D, 0x76}, {0x1E7E, 0x76}, {0x1E7F, 0x76}, {0x1E80, 0x77}, {0x1E81, 0x77},
+    {0x1E82, 0x77}, {0x1E83, 0x77}, {0x1E84, 0x77}, {0x1E85, 0x77}, {0x1E86, 0x77}, {0x1E87, 0x77}, {0x1E88, 0x77}, {0x1E89, 0x77}, {0x1E8A, 0x78}, {0x1E8B, 0x78},
+    {0x1E8C, 0x78}, {0x1E8D, 0x78}, {0x1E8E, 0x79}, {0x1E8F, 0x79}, {0x1E90, 0x7A}, {0x1E91, 0x7A}, {0x1E92, 0x7A}, {0x1E93, 0x7A}, {0x1E94, 0x7A}, {0x1E95, 0x7A},
+    {0x1E96, 0x68}, {0x1E97, 0x74}, {0x1E98, 0x77}, {0x1E99, 0x79}, {0x1E9B, 0x17F}, {0x1E9E, 0xDF}, {0x1EA0, 0x61}, {0x1EA1, 0x61}, {0x1EA2, 0x61}, {0x1EA3, 0x61},
+    {0x1EA4, 0x61}, {0x1EA5, 0x61}, {0x1EA6, 0x61}, {0x1EA7, 0x61}, {0x1EA8, 0x61}, {0x1EA9, 0x61}, {0x1EAA, 0x61}, {0x1EAB, 0x61}, {0x1EAC, 0x61}, {0x1EAD, 0x61},
+    {0x1EAE, 0x61}, {0x1EAF, 0x61}, {0x1EB0, 0x61}, {0x1EB1, 0x61}, {0x1EB2, 0x61}, {0x1EB3, 0x61}, {0x1EB4, 0x61}, {0x1EB5, 0x61}, {0x1EB6, 0x61}, {0x1EB7, 0x61},
+    {0x1EB8, 0x65}, {0x1EB9, 0x65}, {0x1EBA, 0x65}, {0x1EBB, 0x65}, {0x1EBC, 0x65}, {0x1EBD, 0x65}, {0x1EBE, 0x65}, {0x1EBF, 0x65}, {0x1EC0, 0x65}, {0x1EC1, 0x65},
+    {0x1EC2, 0x65}, {0x1EC3, 0x65}, {0x1EC4, 0x65}, {0x1EC5, 0x65}, {0x1EC6, 0x65}, {0x1EC7, 0x65}, {0x1EC8, 0x69}, {0x1EC9, 0x69}, {0x1ECA, 0x69}, {0x1ECB, 0x69},
+    {0x1ECC, 0x6F}, {0x1ECD, 0x6F}, {0x1ECE, 0x6F}, {0x1ECF, 0x6F}, {0x1ED0, 0x6F}, {0x1ED1, 0x6F}, {0x1ED2, 0x6F}, {0x1ED3, 0x6F}, {0x1ED4, 0x6F}, {0x1ED5, 0x6F},
+    {0x1ED6, 0x6F}, {0x1ED7, 0x6F}, {0x1ED8, 0x6F}, {0x1ED9, 0x6F}, {0x1EDA, 0x6F}, {0x1EDB, 0x6F}, {0x1EDC, 0x6F}, {0x1EDD, 0x6F}, {0x1EDE, 0x6F}, {0x1EDF, 0x6F},
+    {0x1EE0, 0x6F}, {0x1EE1, 0x6F}, {0x1EE2, 0x6F}, {0x1EE3, 0x6F}, {0x1EE4, 0x75}, {0x1EE5, 0x75}, {0x1EE6, 0x75}, {0x1EE7, 0x75}, {0x1EE8, 0x75}, {0x1EE9, 0x75},
+    {0x1EEA, 0x75}, {0x1EEB, 0x75}, {0x1EEC, 0x75}, {0x1EED, 0x75}, {0x1EEE, 0x75}, {0x1EEF, 0x75}, {0x1EF0, 0x75}, {0x1EF1, 0x75}, {0x1EF2, 0x79}, {0x1EF3, 0x79},
+    {0x1EF4, 0x79}, {0x1EF5, 0x79}, {0x1EF6, 0x79}, {0x1EF7, 0x79}, {0x1EF8, 0x79}, {0x1EF9, 0x79}, {0x1EFA, 0x1EFB}, {0x1EFC, 0x1EFD}, {0x1EFE, 0x1EFF}, {0x1F00, 0x3B1},
+    {0x1F01, 0x3B1}, {0x1F02, 0x3B1}, {0x1F03, 0x3B1}, {0x1F04, 0x3B1}, {0x1F05, 0x3B1}, {0x1F06, 0x3B1}, {0x1F07, 0x3B1}, {0x1F08, 0x3B1}, {0x1F09, 0x3B1}, {0x1F0A, 0x3B1},
+    {0x1F0B, 0x3B1}, {0x1F0C, 0x3B1}, {0x1F0D, 0x3B1}, {0x1F0E, 0x3B1}, {0x1F0F, 0x3B1}, {0x1F10, 0x3B5}, {0x1F11, 0x3B5}, {0x1F12, 0x3B5}, {0x1F13, 0x3B5}, {0x1F14, 0x3B5},
+    {0x1F15, 0x3B5}, {0x1F18, 0x3B5}, {0x1F19, 0x3B5}, {0x1F1A, 0x3B5}, {0x1F1B, 0x3B5}, {0x1F1C, 0x3B5}, {0x1F1D, 0x3B5}, {0x1F20, 0x3B7}, {0x1F21, 0x3B7}, {0x1F22, 0x3B7},
+    {0x1F23, 0x3B7}, {0x1F24, 0x3B7}, {0x1F25, 0x3B7}, {0x1F26, 0x3B7}, {0x1F27, 0x3B7}, {0x1F28, 0x3B7}, {0x1F29, 0x3B7}, {0x1F2A, 0x3B7}, {0x1F2B, 0x3B7}, {0x1F2C, 0x3B7},
+    {0x1F2D, 0x3B7}, {0x1F2E, 0x3B7}, {0x1F2F, 0x3B7}, {0x1F30, 0x3B9}, {0x1F31, 0x3B9}, {0x1F32, 0x3B9}, {0x1F33, 0x3B9}, {0x1F34, 0x3B9}, {0x1F35, 0x3B9}, {0x1F36, 0x3B9},
+    {0x1F37, 0x3B9}, {0x1F38, 0x3B9}, {0x1F39, 0x3B9}, {0x1F3A, 0x3B9}, {0x1F3B, 0x3B9}, {0x1F3C, 0x3B9}, {0x1F3D, 0x3B9}, {0x1F3E, 0x3B9}, {0x1F3F, 0x3B9}, {0x1F40, 0x3BF},
+    {0x1F41, 0x3BF}, {0x1F42, 0x3BF}, {0x1F43, 0x3BF}, {0x1F44, 0x3BF}, {0x1F45, 0x3BF}, {0x1F48, 0x3BF}, {0x1F49, 0x3BF}, {0x1F4A, 0x3BF}, {0x1F4B, 0x3BF}, {0x1F4C, 0x3BF},
+    {0x1F4D, 0x3BF}, {0x1F50, 0x3C5}, {0x1F51, 0x3C5}, {0x1F52, 0x3C5}, {0x1F53, 0x3C5}, {0x1F54, 0x3C5}, {0x1F55, 0x3C5}, {0x1F56, 0x3C5}, {0x1F57, 0x3C5}, {0x1F59, 0x3C5},
+    {0x1F5B, 0x3C5}, {0x1F5D, 0x3C5}, {0x1F5F, 0x3C5}, {0x1F60, 0x3C9}, {0x1F61, 0x3C9}, {0x1F62, 0x3C9}, {0x1F63, 0x3C9}, {0x1F64, 0x3C9}, {0x1F65, 0x3C9}, {0x1F66, 0x3C9},
+    {0x1F67, 0x3C9}, {0x1F68, 0x3C9}, {0x1F69, 0x3C9}, {0x1F6A, 0x3C9}, {0x1F6B, 0x3C9}, {0x1F6C, 0x3C9}, {0x1F6D, 0x3C9}, {0x1F6E, 0x3C9}, {0x1F6F, 0x3C9}, {0x1F70, 0x3B1},
+    {0x1F71, 0x3B1}, {0x1F72, 0x3B5}, {0x1F73, 0x3B5}, {0x1F74, 0x3B7}, {0x1F75, 0x3B7}, {0x1F76, 0x3B9}, {0x1F77, 0x3B9}, {0x1F78, 0x3BF}, {0x1F79, 0x3BF}, {0x1F7A, 0x3C5},
+    {0x1F7B, 0x3C5}, {0x1F7C, 0x3C9}, {0x1F7D, 0x3C9}, {0x1F80, 0x3B1}, {0x1F81, 0x3B1}, {0x1F82, 0x3B1}, {0x1F83, 0x3B1}, {0x1F84, 0x3B1}, {0x1F85, 0x3B1}, {0x1F86, 0x3B1},
+    {0x1F87, 0x3B1}, {0x1F88, 0x3B1}, {0x1F89, 0x3B1}, {0x1F8A, 0x3B1}, {0x1F8B, 0x3B1}, {0x1F8C, 0x3B1}, {0x1F8D, 0x3B1}, {0x1F8E, 0x3B1}, {0x1F8F, 0x3B1}, {0x1F90, 0x3B7},
+    {0x1F91, 0x3B7}, {0x1F92, 0x3B7}, {0x1F93, 0x3B7}, {0x1F94, 0x3B7}, {0x1F95, 0x3B7}, {0x1F96, 0x3B7}, {0x1F97, 0x3B7}, {0x1F98, 0x3B7}, {0x1F99, 0x3B7}, {0x1F9A, 0x3B7},
+    {0x1F9B, 0x3B7}, {0x1F9C, 0x3B7}, {0x1F9D, 0x3B7}, {0x1F9E, 0x3B7}, {0x1F9F, 0x3B7}, {0x1FA0, 0x3C9}, {0x1FA1, 0x3C9}, {0x1FA2, 0x3C9}, {0x1FA3, 0x3C9}, {0x1FA4, 0x3C9},
+    {0x1FA5, 0x3C9}, {0x1FA6, 0x3C9}, {0x1FA7, 0x3C9}, {0x1FA8, 0x3C9}, {0x1FA9, 0x3C9}, {0x1FAA, 0x3C9}, {0x1FAB, 0x3C9}, {0x1FAC, 0x3C9}, {0x1FAD, 0x3C9}, {0x1FAE, 0x3C9},
+    {0x1FAF, 0x3C9}, {0x1FB0, 0x3B1}, {0x1FB1, 0x3B1}, {0x1FB2, 0x3B1}, {0x1FB3, 0x3B1}, {0x1FB4, 0x3B1}, {0x1FB6, 0x3B1}, {0x1FB7, 0x3B1}, {0x1FB8, 0x3B1}, {0x1FB9, 0x3B1},
+    {0x1FBA, 0x3B1}, {0x1FBB, 0x3B1}, {0x1FBC, 0x3B1}, {0x1FBE, 0x3B9}, {0x1FC1, 0xA8}, {0x1FC2, 0x3B7}, {0x1FC3, 0x3B7}, {0x1FC4, 0x3B7}, {0x1FC6, 0x3B7}, {0x1FC7, 0x3B7},
+    {0x1FC8, 0x3B5}, {0x1FC9, 0x3B5}, {0x1FCA, 0x3B7}, {0x1FCB, 0x3B7}, {0x1FCC, 0x3B7}, {0x1FCD, 0x1FBF}, {0x1FCE, 0x1FBF}, {0x1FCF, 0x1FBF}, {0x1FD0, 0x3B9}, {0x1FD1, 0x3B9},
+    {0x1FD2, 0x3B9}, {0x1FD3, 0x3B9}, {0x1FD6, 0x3B9}, {0x1FD7, 0x3B9}, {0x1FD8, 0x3B9}, {0x1FD9, 0x3B9}, {0x1FDA, 0x3B9}, {0x1FDB, 0x3B9}, {0x1FDD, 0x1FFE}, {0x1FDE, 0x1FFE},
+    {0x1FDF, 0x1FFE}, {0x1FE0, 0x3C5}, {0x1FE1, 0x3C5}, {0x1FE2, 0x3C5}, {0x1FE3, 0x3C5}, {0x1FE4, 0x3C1}, {0x1FE5, 0x3C1}, {0x1FE6, 0x3C5}, {0x1FE7, 0x3C5}, {0x1FE8, 0x3C5},
+    {0x1FE9, 0x3C5}, {0x1FEA, 0x3C5}, {0x1FEB, 0x3C5}, {0x1FEC, 0x3C1}, {0x1FED, 0xA8}, {0x1FEE, 0xA8}, {0x1FEF, 0x60}, {0x1FF2, 0x3C9}, {0x1FF3, 0x3C9}, {0x1FF4, 0x3C9},
+    {0x1FF6, 0x3C9}, {0x1FF7, 0x3C9}, {0x1FF8, 0x3BF}, {0x1FF9, 0x3BF}, {0x1FFA, 0x3C9}, {0x1FFB, 0x3C9}, {0x1FFC, 0x3C9}, {0x1FFD, 0xB4}, {0x2000, 0x2002}, {0x2001, 0x2003},
+    {0x2126, 0x3C9}, {0x212A, 0x6B}, {0x212B, 0x61}, {0x2132, 0x214E}, {0x2160, 0x2170}, {0x2161, 0x2171}, {0x2162, 0x2172}, {0x2163, 0x2173}, {0x2164, 0x2174}, {0x2165, 0x2175},
+    {0x2166, 0x2176}, {0x2167, 0x2177}, {0x2168, 0x2178}, {0x2169, 0x2179}, {0x216A, 0x217A}, {0x216B, 0x217B}, {0x216C, 0x217C}, {0x216D, 0x217D}, {0x216E, 0x217E}, {0x216F, 0x217F},
+    {0x2183, 0x2184}, {0x219A, 0x2190}, {0x219B, 0x2192}, {0x21AE, 0x2194}, {0x21CD, 0x21D0}, {0x21CE, 0x21D4}, {0x21CF, 0x21D2}, {0x2204, 0x2203}, {0x2209, 0x2208}, {0x220C, 0x220B},
+    {0x2224, 0x2223}, {0x2226, 0x2225}, {0x2241, 0x223C}, {0x2244, 0x2243}, {0x2247, 0x2245}, {0x2249, 0x2248}, {0x2260, 0x3D}, {0x2262, 0x2261}, {0x226D, 0x224D}, {0x226E, 0x3C},
+    {0x226F, 0x3E}, {0x2270, 0x2264}, {0x2271, 0x2265}, {0x2274, 0x2272}, {0x2275, 0x2273}, {0x2278, 0x2276}, {0x2279, 0x2277}, {0x2280, 0x227A}, {0x2281, 0x227B}, {0x2284, 0x2282},
+    {0x2285, 0x2283}, {0x2288, 0x2286}, {0x2289, 0x2287}, {0x22AC, 0x22A2}, {0x22AD, 0x22A8}, {0x22AE, 0x22A9}, {0x22AF, 0x22AB}, {0x22E0, 0x227C}, {0x22E1, 0x227D}, {0x22E2, 0x2291},
+    {0x22E3, 0x2292}, {0x22EA, 0x22B2}, {0x22EB, 0x22B3}, {0x22EC, 0x22B4}, {0x22ED, 0x22B5}, {0x2329, 0x3008}, {0x232A, 0x3009}, {0x24B6, 0x24D0}, {0x24B7, 0x24D1}, {0x24B8, 0x24D2},
+    {0x24B9, 0x24D3}, {0x24BA, 0x24D4}, {0x24BB, 0x24D5}, {0x24BC, 0x24D6}, {0x24BD, 0x24D7}, {0x24BE, 0x24D8}, {0x24BF, 0x24D9}, {0x24C0, 0x24DA}, {0x24C1, 0x24DB}, {0x24C2, 0x24DC},
+    {0x24C3, 0x24DD}, {0x24C4, 0x24DE}, {0x24C5, 0x24DF}, {0x24C6, 0x24E0}, {0x24C7, 0x24E1}, {0x24C8, 0x24E2}, {0x24C9, 0x24E3}, {0x24CA, 0x24E4}, {0x24CB, 0x24E5}, {0x24CC, 0x24E6},
+    {0x24CD, 0x24E7}, {0x24CE, 0x24E8}, {0x24CF, 0x24E9}, {0x2ADC, 0x2ADD}, {0x2C00, 0x2C30}, {0x2C01, 0x2C31}, {0x2C02, 0x2C32}, {0x2C03, 0x2C33}, {0x2C04, 0x2C34}, {0x2C05, 0x2C35},
+    {0x2C06, 0x2C36}, {0x2C07, 0x2C37}, {0x2C08, 0x2C38}, {0x2C09, 0x2C39}, {0x2C0A, 0x2C3A}, {0x2C0B, 0x2C3B}, {0x2C0C, 0x2C3C}, {0x2C0D, 0x2C3D}, {0x2C0E, 0x2C3E}, {0x2C0F, 0x2C3F},
+    {0x2C10, 0x2C40}, {0x2C11, 0x2C41}, {0x2C12, 0x2C42}, {0x2C13, 0x2C43}, {0x2C14, 0x2C44}, {0x2C15, 0x2C45}, {0x2C16, 0x2C46}, {0x2C17, 0x2C47}, {0x2C18, 0x2C48}, {0x2C19, 0x2C49},
+    {0x2C1A, 0x2C4A}, {0x2C1B, 0x2C4B}, {0x2C1C, 0x2C4C}, {0x2C1D, 0x2C4D}, {0x2C1E, 0x2C4E}, {0x2C1F, 0x2C4F}, {0x2C20, 0x2C50}, {0x2C21, 0x2C51}, {0x2C22, 0x2C52}, {0x2C23, 0x2C53},
+    {0x2C24, 0x2C54}, {0x2C25, 0x2C55}, {0x2C26, 0x2C56}, {0x2C27, 0x2C57}, {0x2C28, 0x2C58}, {0x2C29, 0x2C59}, {0x2C2A, 0x2C5A}, {0x2C2B, 0x2C5B}, {0x2C2C, 0x2C5C}, {0x2C2D, 0x2C5D},
+    {0x2C2E, 0x2C5E}, {0x2C2F, 0x2C5F}, {0x2C60, 0x2C61}, {0x2C62, 0x26B}, {0x2C63, 0x1D7D}, {0x2C64, 0x27D}, {0x2C67, 0x2C68}, {0x2C69, 0x2C6A}, {0x2C6B, 0x2C6C}, {0x2C6D, 0x251},
+    {0x2C6E, 0x271}, {0x2C6F, 0x250}, {0x2C70, 0x252}, {0x2C72, 0x2C73}, {0x2C75, 0x2C76}, {0x2C7E, 0x23F}, {0x2C7F, 0x240}, {0x2C80, 0x2C81}, {0x2C82, 0x2C83}, {0x2C84, 0x2C85},
+    {0x2C86, 0x2C87}, {0x2C88, 0x2C89}, {0x2C8A, 0x2C8B}, {0x2C8C, 0x2C8D}, {0x2C8E, 0x2C8F}, {0x2C90, 0x2C91}, {0x2C92, 0x2C93}, {0x2C94, 0x2C95}, {0x2C96, 0x2C97}, {0x2C98, 0x2C99},
+    {0x2C9A, 0x2C9B}, {0x2C9C, 0x2C9D}, {0x2C9E, 0x2C9F}, {0x2CA0, 0x2CA1}, {0x2CA2, 0x2CA3}, {0x2CA4, 0x2CA5}, {0x2CA6, 0x2CA7}, {0x2CA8, 0x2CA9}, {0x2CAA, 0x2CAB}, {0x2CAC, 0x2CAD},
+    {0x2CAE, 0x2CAF}, {0x2CB0, 0x2CB1}, {0x2CB2, 0x2CB3}, {0x2CB4, 0x2CB5}, {0x2CB6, 0x2CB7}, {0x2CB8, 0x2CB9}, {0x2CBA, 0x2CBB}, {0x2CBC, 0x2CBD}, {0x2CBE, 0x2CBF}, {0x2CC0, 0x2CC1},
+    {0x2CC2, 0x2CC3}, {0x2CC4, 0x2CC5}, {0x2CC6, 0x2CC7}, {0x2CC8, 0x2CC9}, {0x2CCA, 0x2CCB}, {0x2CCC, 0x2CCD}, {0x2CCE, 0x2CCF}, {0x2CD0, 0x2CD1}, {0x2CD2, 0x2CD3}, {0x2CD4, 0x2CD5},
+    {0x2CD6, 0x2CD7}, {0x2CD8, 0x2CD9}, {0x2CDA, 0x2CDB}, {0x2CDC, 0x2CDD}, {0x2CDE, 0x2CDF}, {0x2CE0, 0x2CE1}, {0x2CE2, 0x2CE3}, {0x2CEB, 0x2CEC}, {0x2CED, 0x2CEE}, {0x2CF2, 0x2CF3},
+    {0x304C, 0x304B}, {0x304E, 0x304D}, {0x3050, 0x304F}, {0x3052, 0x3051}, {0x3054, 0x3053}, {0x3056, 0x3055}, {0x3058, 0x3057}, {0x305A, 0x3059}, {0x305C, 0x305B}, {0x305E, 0x305D},
+    {0x3060, 0x305F}, {0x3062, 0x3061}, {0x3065, 0x3064}, {0x3067, 0x3066}, {0x3069, 0x3068}, {0x3070, 0x306F}, {0x3071, 0x306F}, {0x3073, 0x3072}, {0x3074, 0x3072}, {0x3076, 0x3075},
+    {0x3077, 0x3075}, {0x3079, 0x3078}, {0x307A, 0x3078}, {0x307C, 0x307B}, {0x307D, 0x307B}, {0x3094, 0x3046}, {0x309E, 0x309D}, {0x30AC, 0x30AB}, {0x30AE, 0x30AD}, {0x30B0, 0x30AF},
+    {0x30B2, 0x30B1}, {0x30B4, 0x30B3}, {0x30B6, 0x30B5}, {0x30B8, 0x30B7}, {0x30BA, 0x30B9}, {0x30BC, 0x30BB}, {0x30BE, 0x30BD}, {0x30C0, 0x30BF}, {0x30C2, 0x30C1}, {0x30C5, 0x30C4},
+    {0x30C7, 0x30C6}, {0x30C9, 0x30C8}, {0x30D0, 0x30CF}, {0x30D1, 0x30CF}, {0x30D3, 0x30D2}, {0x30D4, 0x30D2}, {0x30D6, 0x30D5}, {0x30D7, 0x30D5}, {0x30D9, 0x30D8}, {0x30DA, 0x30D8},
+    {0x30DC, 0x30DB}, {0x30DD, 0x30DB}, {0x30F4, 0x30A6}, {0x30F7, 0x30EF}, {0x30F8, 0x30F0}, {0x30F9, 0x30F1}, {0x30FA, 0x30F2}, {0x30FE, 0x30FD}, {0xA640, 0xA641}, {0xA642, 0xA643},
+    {0xA644, 0xA645}, {0xA646, 0xA647}, {0xA648, 0xA649}, {0xA64A, 0xA64B}, {0xA64C, 0xA64D}, {0xA64E, 0xA64F}, {0xA650, 0xA651}, {0xA652, 0xA653}, {0xA654, 0xA655}, {0xA656, 0xA657},
+    {0xA658, 0xA659}, {0xA65A, 0xA65B}, {0xA65C, 0xA65D}, {0xA65E, 0xA65F}, {0xA660, 0xA661}, {0xA662, 0xA663}, {0xA664, 0xA665}, {0xA666, 0xA667}, {0xA668, 0xA669}, {0xA66A, 0xA66B},
+    {0xA66C, 0xA66D}, {0xA680, 0xA681}, {0xA682, 0xA683}, {0xA684, 0xA685}, {0xA686, 0xA687}, {0xA688, 0xA689}, {0xA68A, 0xA68B}, {0xA68C, 0xA68D}, {0xA68E, 0xA68F}, {0xA690, 0xA691},
+    {0xA692, 0xA693}, {0xA694, 0xA695}, {0xA696, 0xA697}, {0xA698, 0xA699}, {0xA69A, 0xA69B}, {0xA722, 0xA723}, {0xA724, 0xA725}, {0xA726, 0xA727}, {0xA728, 0xA729}, {0xA72A, 0xA72B},
+    {0xA72C, 0xA72D}, {0xA72E, 0xA72F}, {0xA732, 0xA733}, {0xA734, 0xA735}, {0xA736, 0xA737}, {0xA738, 0xA739}, {0xA73A, 0xA73B}, {0xA73C, 0xA73D}, {0xA73E, 0xA73F}, {0xA740, 0xA741},
+    {0xA742, 0xA743}, {0xA744, 0xA745}, {0xA746, 0xA747}, {0xA748, 0xA749}, {0xA74A, 0xA74B}, {0xA74C, 0xA74D}, {0xA74E, 0xA74F}, {0xA750, 0xA751}, {0xA752, 0xA753}, {0xA754, 0xA755},
+    {0xA756, 0xA757}, {0xA758, 0xA759}, {0xA75A, 0xA75B}, {0xA75C, 0xA75D}, {0xA75E, 0xA75F}, {0xA760, 0xA761}, {0xA762, 0xA763}, {0xA764, 0xA765}, {0xA766, 0xA767}, {0xA768, 0xA769},
+    {0xA76A, 0xA76B}, {0xA76C, 0xA76D}, {0xA76E, 0xA76F}, {0xA779, 0xA77A}, {0xA77B, 0xA77C}, {0xA77D, 0x1D79}, {0xA77E, 0xA77F}, {0xA780, 0xA781}, {0xA782, 0xA783}, {0xA784, 0xA785},
+    {0xA786, 0xA787}, {0xA78B, 0xA78C}, {0xA78D, 0x265}, {0xA790, 0xA791}, {0xA792, 0xA793}, {0xA796, 0xA797}, {0xA798, 0xA799}, {0xA79A, 0xA79B}, {0xA79C, 0xA79D}, {0xA79E, 0xA79F},
+    {0xA7A0, 0xA7A1}, {0xA7A2, 0xA7A3}, {0xA7A4, 0xA7A5}, {0xA7A6, 0xA7A7}, {0xA7A8, 0xA7A9}, {0xA7AA, 0x266}, {0xA7AB, 0x25C}, {0xA7AC, 0x261}, {0xA7AD, 0x26C}, {0xA7AE, 0x26A},
+    {0xA7B0, 0x29E}, {0xA7B1, 0x287}, {0xA7B2, 0x29D}, {0xA7B3, 0xAB53}, {0xA7B4, 0xA7B5}, {0xA7B6, 0xA7B7}, {0xA7B8, 0xA7B9}, {0xA7BA, 0xA7BB}, {0xA7BC, 0xA7BD}, {0xA7BE, 0xA7BF},
+    {0xA7C0, 0xA7C1}, {0xA7C2, 0xA7C3}, {0xA7C4, 0xA794}, {0xA7C5, 0x282}, {0xA7C6, 0x1D8E}, {0xA7C7, 0xA7C8}, {0xA7C9, 0xA7CA}, {0xA7D0, 0xA7D1}, {0xA7D6, 0xA7D7}, {0xA7D8, 0xA7D9},
+    {0xA7F5, 0xA7F6}, {0xF900, 0x8C48}, {0xF901, 0x66F4}, {0xF902, 0x8ECA}, {0xF903, 0x8CC8}, {0xF904, 0x6ED1}, {0xF905, 0x4E32}, {0xF906, 0x53E5}, {0xF907, 0x9F9C}, {0xF908, 0x9F9C},
+    {0xF909, 0x5951}, {0xF90A, 0x91D1}, {0xF90B, 0x5587}, {0xF90C, 0x5948}, {0xF90D, 0x61F6}, {0xF90E, 0x7669}, {0xF90F, 0x7F85}, {0xF910, 0x863F}, {0xF911, 0x87BA}, {0xF912, 0x88F8},
+    {0xF913, 0x908F}, {0xF914, 0x6A02}, {0xF915, 0x6D1B}, {0xF916, 0x70D9}, {0xF917, 0x73DE}, {0xF918, 0x843D}, {0xF919, 0x916A}, {0xF91A, 0x99F1}, {0xF91B, 0x4E82}, {0xF91C, 0x5375},
+    {0xF91D, 0x6B04}, {0xF91E, 0x721B}, {0xF91F, 0x862D}, {0xF920, 0x9E1E}, {0xF921, 0x5D50}, {0xF922, 0x6FEB}, {0xF923, 0x85CD}, {0xF924, 0x8964}, {0xF925, 0x62C9}, {0xF926, 0x81D8},
+    {0xF927, 0x881F}, {0xF928, 0x5ECA}, {0xF929, 0x6717}, {0xF92A, 0x6D6A}, {0xF92B, 0x72FC}, {0xF92C, 0x90CE}, {0xF92D, 0x4F86}, {0xF92E, 0x51B7}, {0xF92F, 0x52DE}, {0xF930, 0x64C4},
+    {0xF931, 0x6AD3}, {0xF932, 0x7210}, {0xF933, 0x76E7}, {0xF934, 0x8001}, {0xF935, 0x8606}, {0xF936, 0x865C}, {0xF937, 0x8DEF}, {0xF938, 0x9732}, {0xF939, 0x9B6F}, {0xF93A, 0x9DFA},
+    {0xF93B, 0x788C}, {0xF93C, 0x797F}, {0xF93D, 0x7DA0}, {0xF93E, 0x83C9}, {0xF93F, 0x9304}, {0xF940, 0x9E7F}, {0xF941, 0x8AD6}, {0xF942, 0x58DF}, {0xF943, 0x5F04}, {0xF944, 0x7C60},
+    {0xF945, 0x807E}, {0xF946, 0x7262}, {0xF947, 0x78CA}, {0xF948, 0x8CC2}, {0xF949, 0x96F7}, {0xF94A, 0x58D8}, {0xF94B, 0x5C62}, {0xF94C, 0x6A13}, {0xF94D, 0x6DDA}, {0xF94E, 0x6F0F},
+    {0xF94F, 0x7D2F}, {0xF950, 0x7E37}, {0xF951, 0x964B}, {0xF952, 0x52D2}, {0xF953, 0x808B}, {0xF954, 0x51DC}, {0xF955, 0x51CC}, {0xF956, 0x7A1C}, {0xF957, 0x7DBE}, {0xF958, 0x83F1},
+    {0xF959, 0x9675}, {0xF95A, 0x8B80}, {0xF95B, 0x62CF}, {0xF95C, 0x6A02}, {0xF95D, 0x8AFE}, {0xF95E, 0x4E39}, {0xF95F, 0x5BE7}, {0xF960, 0x6012}, {0xF961, 0x7387}, {0xF962, 0x7570},
+    {0xF963, 0x5317}, {0xF964, 0x78FB}, {0xF965, 0x4FBF}, {0xF966, 0x5FA9}, {0xF967, 0x4E0D}, {0xF968, 0x6CCC}, {0xF969, 0x6578}, {0xF96A, 0x7D22}, {0xF96B, 0x53C3}, {0xF96C, 0x585E},
+    {0xF96D, 0x7701}, {0xF96E, 0x8449}, {0xF96F, 0x8AAA}, {0xF970, 0x6BBA}, {0xF971, 0x8FB0}, {0xF972, 0x6C88}, {0xF973, 0x62FE}, {0xF974, 0x82E5}, {0xF975, 0x63A0}, {0xF976, 0x7565},
+    {0xF977, 0x4EAE}, {0xF978, 0x5169}, {0xF979, 0x51C9}, {0xF97A, 0x6881}, {0xF97B, 0x7CE7}, {0xF97C, 0x826F}, {0xF97D, 0x8AD2}, {0xF97E, 0x91CF}, {0xF97F, 0x52F5}, {0xF980, 0x5442},
+    {0xF981, 0x5973}, {0xF982, 0x5EEC}, {0xF983, 0x65C5}, {0xF984, 0x6FFE}, {0xF985, 0x792A}, {0xF986, 0x95AD}, {0xF987, 0x9A6A}, {0xF988, 0x9E97}, {0xF989, 0x9ECE}, {0xF98A, 0x529B},
+    {0xF98B, 0x66C6}, {0xF98C, 0x6B77}, {0xF98D, 0x8F62}, {0xF98E, 0x5E74}, {0xF98F, 0x6190}, {0xF990, 0x6200}, {0xF991, 0x649A}, {0xF992, 0x6F23}, {0xF993, 0x7149}, {0xF994, 0x7489},
+    {0xF995, 0x79CA}, {0xF996, 0x7DF4}, {0xF997, 0x806F}, {0xF998, 0x8F26}, {0xF999, 0x84EE}, {0xF99A, 0x9023}, {0xF99B, 0x934A}, {0xF99C, 0x5217}, {0xF99D, 0x52A3}, {0xF99E, 0x54BD},
+    {0xF99F, 0x70C8}, {0xF9A0, 0x88C2}, {0xF9A1, 0x8AAA}, {0xF9A2, 0x5EC9}, {0xF9A3, 0x5FF5}, {0xF9A4, 0x637B}, {0xF9A5, 0x6BAE}, {0xF9A6, 0x7C3E}, {0xF9A7, 0x7375}, {0xF9A8, 0x4EE4},
+    {0xF9A9, 0x56F9}, {0xF9AA, 0x5BE7}, {0xF9AB, 0x5DBA}, {0xF9AC, 0x601C}, {0xF9AD, 0x73B2}, {0xF9AE, 0x7469}, {0xF9AF, 0x7F9A}, {0xF9B0, 0x8046}, {0xF9B1, 0x9234}, {0xF9B2, 0x96F6},
+    {0xF9B3, 0x9748}, {0xF9B4, 0x9818}, {0xF9B5, 0x4F8B}, {0xF9B6, 0x79AE}, {0xF9B7, 0x91B4}, {0xF9B8, 0x96B8}, {0xF9B9, 0x60E1}, {0xF9BA, 0x4E86}, {0xF9BB, 0x50DA}, {0xF9BC, 0x5BEE},
+    {0xF9BD, 0x5C3F}, {0xF9BE, 0x6599}, {0xF9BF, 0x6A02}, {0xF9C0, 0x71CE}, {0xF9C1, 0x7642}, {0xF9C2, 0x84FC}, {0xF9C3, 0x907C}, {0xF9C4, 0x9F8D}, {0xF9C5, 0x6688}, {0xF9C6, 0x962E},
+    {0xF9C7, 0x5289}, {0xF9C8, 0x677B}, {0xF9C9, 0x67F3}, {0xF9CA, 0x6D41}, {0xF9CB, 0x6E9C}, {0xF9CC, 0x7409}, {0xF9CD, 0x7559}, {0xF9CE, 0x786B}, {0xF9CF, 0x7D10}, {0xF9D0, 0x985E},
+    {0xF9D1, 0x516D}, {0xF9D2, 0x622E}, {0xF9D3, 0x9678}, {0xF9D4, 0x502B}, {0xF9D5, 0x5D19}, {0xF9D6, 0x6DEA}, {0xF9D7, 0x8F2A}, {0xF9D8, 0x5F8B}, {0xF9D9, 0x6144}, {0xF9DA, 0x6817},
+    {0xF9DB, 0x7387}, {0xF9DC, 0x9686}, {0xF9DD, 0x5229}, {0xF9DE, 0x540F}, {0xF9DF, 0x5C65}, {0xF9E0, 0x6613}, {0xF9E1, 0x674E}, {0xF9E2, 0x68A8}, {0xF9E3, 0x6CE5}, {0xF9E4, 0x7406},
+    {0xF9E5, 0x75E2}, {0xF9E6, 0x7F79}, {0xF9E7, 0x88CF}, {0xF9E8, 0x88E1}, {0xF9E9, 0x91CC}, {0xF9EA, 0x96E2}, {0xF9EB, 0x533F}, {0xF9EC, 0x6EBA}, {0xF9ED, 0x541D}, {0xF9EE, 0x71D0},
+    {0xF9EF, 0x7498}, {0xF9F0, 0x85FA}, {0xF9F1, 0x96A3}, {0xF9F2, 0x9C57}, {0xF9F3, 0x9E9F}, {0xF9F4, 0x6797}, {0xF9F5, 0x6DCB}, {0xF9F6, 0x81E8}, {0xF9F7, 0x7ACB}, {0xF9F8, 0x7B20},
+    {0xF9F9, 0x7C92}, {0xF9FA, 0x72C0}, {0xF9FB, 0x7099}, {0xF9FC, 0x8B58}, {0xF9FD, 0x4EC0}, {0xF9FE, 0x8336}, {0xF9FF, 0x523A}, {0xFA00, 0x5207}, {0xFA01, 0x5EA6}, {0xFA02, 0x62D3},
+    {0xFA03, 0x7CD6}, {0xFA04, 0x5B85}, {0xFA05, 0x6D1E}, {0xFA06, 0x66B4}, {0xFA07, 0x8F3B}, {0xFA08, 0x884C}, {0xFA09, 0x964D}, {0xFA0A, 0x898B}, {0xFA0B, 0x5ED3}, {0xFA0C, 0x5140},
+    {0xFA0D, 0x55C0}, {0xFA10, 0x585A}, {0xFA12, 0x6674}, {0xFA15, 0x51DE}, {0xFA16, 0x732A}, {0xFA17, 0x76CA}, {0xFA18, 0x793C}, {0xFA19, 0x795E}, {0xFA1A, 0x7965}, {0xFA1B, 0x798F},
+    {0xFA1C, 0x9756}, {0xFA1D, 0x7CBE}, {0xFA1E, 0x7FBD}, {0xFA20, 0x8612}, {0xFA22, 0x8AF8}, {0xFA25, 0x9038}, {0xFA26, 0x90FD}, {0xFA2A, 0x98EF}, {0xFA2B, 0x98FC}, {0xFA2C, 0x9928},
+    {0xFA2D, 0x9DB4}, {0xFA2E, 0x90DE}, {0xFA2F, 0x96B7}, {0xFA30, 0x4FAE}, {0xFA31, 0x50E7}, {0xFA32, 0x514D}, {0xFA33, 0x52C9}, {0xFA34, 0x52E4}, {0xFA35, 0x5351}, {0xFA36, 0x559D},
+    {0xFA37, 0x5606}, {0xFA38, 0x5668}, {0xFA39, 0x5840}, {0xFA3A, 0x58A8}, {0xFA3B, 0x5C64}, {0xFA3C, 0x5C6E}, {0xFA3D, 0x6094}, {0xFA3E, 0x6168}, {0xFA3F, 0x618E}, {0xFA40, 0x61F2},
+    {0xFA41, 0x654F}, {0xFA42, 0x65E2}, {0xFA43, 0x6691}, {0xFA44, 0x6885}, {0xFA45, 0x6D77}, {0xFA46, 0x6E1A}, {0xFA47, 0x6F22}, {0xFA48, 0x716E}, {0xFA49, 0x722B}, {0xFA4A, 0x7422},
+    {0xFA4B, 0x7891}, {0xFA4C, 0x793E}, {0xFA4D, 0x7949}, {0xFA4E, 0x7948}, {0xFA4F, 0x7950}, {0xFA50, 0x7956}, {0xFA51, 0x795D}, {0xFA52, 0x798D}, {0xFA53, 0x798E}, {0xFA54, 0x7A40},
+    {0xFA55, 0x7A81}, {0xFA56, 0x7BC0}, {0xFA57, 0x7DF4}, {0xFA58, 0x7E09}, {0xFA59, 0x7E41}, {0xFA5A, 0x7F72}, {0xFA5B, 0x8005}, {0xFA5C, 0x81ED}, {0xFA5D, 0x8279}, {0xFA5E, 0x8279},
+    {0xFA5F, 0x8457}, {0xFA60, 0x8910}, {0xFA61, 0x8996}, {0xFA62, 0x8B01}, {0xFA63, 0x8B39}, {0xFA64, 0x8CD3}, {0xFA65, 0x8D08}, {0xFA66, 0x8FB6}, {0xFA67, 0x9038}, {0xFA68, 0x96E3},
+    {0xFA69, 0x97FF}, {0xFA6A, 0x983B}, {0xFA6B, 0x6075}, {0xFA6C, 0x242EE}, {0xFA6D, 0x8218}, {0xFA70, 0x4E26}, {0xFA71, 0x51B5}, {0xFA72, 0x5168}, {0xFA73, 0x4F80}, {0xFA74, 0x5145},
+    {0xFA75, 0x5180}, {0xFA76, 0x52C7}, {0xFA77, 0x52FA}, {0xFA78, 0x559D}, {0xFA79, 0x5555}, {0xFA7A, 0x5599}, {0xFA7B, 0x55E2}, {0xFA7C, 0x585A}, {0xFA7D, 0x58B3}, {0xFA7E, 0x5944},
+    {0xFA7F, 0x5954}, {0xFA80, 0x5A62}, {0xFA81, 0x5B28}, {0xFA82, 0x5ED2}, {0xFA83, 0x5ED9}, {0xFA84, 0x5F69}, {0xFA85, 0x5FAD}, {0xFA86, 0x60D8}, {0xFA87, 0x614E}, {0xFA88, 0x6108},
+    {0xFA89, 0x618E}, {0xFA8A, 0x6160}, {0xFA8B, 0x61F2}, {0xFA8C, 0x6234}, {0xFA8D, 0x63C4}, {0xFA8E, 0x641C}, {0xFA8F, 0x6452}, {0xFA90, 0x6556}, {0xFA91, 0x6674}, {0xFA92, 0x6717},
+    {0xFA93, 0x671B}, {0xFA94, 0x6756}, {0xFA95, 0x6B79}, {0xFA96, 0x6BBA}, {0xFA97, 0x6D41}, {0xFA98, 0x6EDB}, {0xFA99, 0x6ECB}, {0xFA9A, 0x6F22}, {0xFA9B, 0x701E}, {0xFA9C, 0x716E},
+    {0xFA9D, 0x77A7}, {0xFA9E, 0x7235}, {0xFA9F, 0x72AF}, {0xFAA0, 0x732A}, {0xFAA1, 0x7471}, {0xFAA2, 0x7506}, {0xFAA3, 0x753B}, {0xFAA4, 0x761D}, {0xFAA5, 0x761F}, {0xFAA6, 0x76CA},
+    {0xFAA7, 0x76DB}, {0xFAA8, 0x76F4}, {0xFAA9, 0x774A}, {0xFAAA, 0x7740}, {0xFAAB, 0x78CC}, {0xFAAC, 0x7AB1}, {0xFAAD, 0x7BC0}, {0xFAAE, 0x7C7B}, {0xFAAF, 0x7D5B}, {0xFAB0, 0x7DF4},
+    {0xFAB1, 0x7F3E}, {0xFAB2, 0x8005}, {0xFAB3, 0x8352}, {0xFAB4, 0x83EF}, {0xFAB5, 0x8779}, {0xFAB6, 0x8941}, {0xFAB7, 0x8986}, {0xFAB8, 0x8996}, {0xFAB9, 0x8ABF}, {0xFABA, 0x8AF8},
+    {0xFABB, 0x8ACB}, {0xFABC, 0x8B01}, {0xFABD, 0x8AFE}, {0xFABE, 0x8AED}, {0xFABF, 0x8B39}, {0xFAC0, 0x8B8A}, {0xFAC1, 0x8D08}, {0xFAC2, 0x8F38}, {0xFAC3, 0x9072}, {0xFAC4, 0x9199},
+    {0xFAC5, 0x9276}, {0xFAC6, 0x967C}, {0xFAC7, 0x96E3}, {0xFAC8, 0x9756}, {0xFAC9, 0x97DB}, {0xFACA, 0x97FF}, {0xFACB, 0x980B}, {0xFACC, 0x983B}, {0xFACD, 0x9B12}, {0xFACE, 0x9F9C},
+    {0xFACF, 0x2284A}, {0xFAD0, 0x22844}, {0xFAD1, 0x233D5}, {0xFAD2, 0x3B9D}, {0xFAD3, 0x4018}, {0xFAD4, 0x4039}, {0xFAD5, 0x25249}, {0xFAD6, 0x25CD0}, {0xFAD7, 0x27ED3}, {0xFAD8, 0x9F43},
+    {0xFAD9, 0x9F8E}, {0xFB1D, 0x5D9}, {0xFB1F, 0x5F2}, {0xFB2A, 0x5E9}, {0xFB2B, 0x5E9}, {0xFB2C, 0x5E9}, {0xFB2D, 0x5E9}, {0xFB2E, 0x5D0}, {0xFB2F, 0x5D0}, {0xFB30, 0x5D0},
+    {0xFB31, 0x5D1}, {0xFB32, 0x5D2}, {0xFB33, 0x5D3}, {0xFB34, 0x5D4}, {0xFB35, 0x5D5}, {0xFB36, 0x5D6}, {0xFB38, 0x5D8}, {0xFB39, 0x5D9}, {0xFB3A, 0x5DA}, {0xFB3B, 0x5DB},
+    {0xFB3C, 0x5DC}, {0xFB3E, 0x5DE}, {0xFB40, 0x5E0}, {0xFB41, 0x5E1}, {0xFB43, 0x5E3}, {0xFB44, 0x5E4}, {0xFB46, 0x5E6}, {0xFB47, 0x5E7}, {0xFB48, 0x5E8}, {0xFB49, 0x5E9},
+    {0xFB4A, 0x5EA}, {0xFB4B, 0x5D5}, {0xFB4C, 0x5D1}, {0xFB4D, 0x5DB}, {0xFB4E, 0x5E4}, {0xFF21, 0xFF41}, {0xFF22, 0xFF42}, {0xFF23, 0xFF43}, {0xFF24, 0xFF44}, {0xFF25, 0xFF45},
+    {0xFF26, 0xFF46}, {0xFF27, 0xFF47}, {0xFF28, 0xFF48}, {0xFF29, 0xFF49}, {0xFF2A, 0xFF4A}, {0xFF2B, 0xFF4B}, {0xFF2C, 0xFF4C}, {0xFF2D, 0xFF4D}, {0xFF2E, 0xFF4E}, {0xFF2F, 0xFF4F},
+    {0xFF30, 0xFF50}, {0xFF31, 0xFF51}, {0xFF32, 0xFF52}, {0xFF33, 0xFF53}, {0xFF34, 0xFF54}, {0xFF35, 0xFF55}, {0xFF36, 0xFF56}, {0xFF37, 0xFF57}, {0xFF38, 0xFF58}, {0xFF39, 0xFF59},
+    {0xFF3A, 0xFF5A},
+};
+static const uint32_t bert_fold_pairs[][3] = {
+    {0x9CB, 0x9C7, 0x9BE}, {0x9CC, 0x9C7, 0x9D7}, {0xB4B, 0xB47, 0xB3E}, {0xB4C, 0xB47, 0xB57}, {0xB94, 0xB92, 0xBD7}, {0xBCA, 0xBC6, 0xBBE}, {0xBCB, 0xBC7, 0xBBE}, {0xBCC, 0xBC6, 0xBD7},
+    {0xCCB, 0xCC2, 0xCD5}, {0xD4A, 0xD46, 0xD3E}, {0xD4B, 0xD47, 0xD3E}, {0xD4C, 0xD46, 0xD57}, {0xDDC, 0xDD9, 0xDCF}, {0xDDD, 0xDD9, 0xDCF}, {0xDDE, 0xDD9, 0xDDF}, {0x1B06, 0x1B05, 0x1B35},
+    {0x1B08, 0x1B07, 0x1B35}, {0x1B0A, 0x1B09, 0x1B35}, {0x1B0C, 0x1B0B, 0x1B35}, {0x1B0E, 0x1B0D, 0x1B35}, {0x1B12, 0x1B11, 0x1B35}, {0x1B40, 0x1B3E, 0x1B35}, {0x1B41, 0x1B3F, 0x1B35},
+};
+
+enum BertClass {
+    BERT_OTHER = 0,
+    BERT_MARK = 1,
+    BERT_PUNCT = 2,
+    BERT_CONTROL = 3,
+    BERT_SPACE = 4
+};
+
+static inline BertClass bert_class(uint32_t cp) {
+    if (cp < 0x80) {
+        if (cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r') {
+            return BERT_SPACE;
+        }
+        if (cp < 0x20 || cp == 0x7F) {
+            return BERT_CONTROL;
+        }
+        if ((cp >= 33 && cp <= 47) || (cp >= 58 && cp <= 64) || (cp >= 91 && cp <= 96) || (cp >= 123 && cp <= 126)) {
+            return BERT_PUNCT;
+        }
+        return BERT_OTHER;
+    }
+    int lo = 0, hi = sizeof(bert_ranges) / sizeof(bert_ranges[0]) - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (cp < bert_ranges[mid][0]) {
+            hi = mid - 1;
+        } else if (cp > bert_ranges[mid][1]) {
+            lo = mid + 1;
         } else {
-            // If no matching symbol is found, this typically means an error in the encoding
-            // or the input text contains characters that the encoder doesn't know how to handle
-            std::cerr << "Error: No encoding found for the sequence starting at position " << i << std::endl;
-            return {};
+            return static_cast<BertClass>(bert_ranges[mid][2]);
         }
     }
-    return ids;
+    return BERT_OTHER;
+}
+
+// the cjk unified ideograph blocks bert tokenizes char by char
+static inline bool is_cjk(uint32_t cp) {
+    return (cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0x3400 && cp <= 0x4DBF) || (cp >= 0x20000 && cp <= 0x2A6DF) ||
+           (cp >= 0x2A700 && cp <= 0x2B73F) || (cp >= 0x2B740 && cp <= 0x2B81F) || (cp >= 0x2B820 && cp <= 0x2CEAF) ||
+           (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0x2F800 && cp <= 0x2FA1F);
+}
+
+// lower case and accent stripped code points of `cp` which is not a nonspacing mark, returns the count
+static inline int bert_fold(uint32_t cp, uint32_t* out) {
+    if (cp >= 'A' && cp <= 'Z') {
+        out[0] = cp + ('a' - 'A');
+        return 1;
+    }
+    if (cp < 0x80 || cp > 0xFFFF) {
+        out[0] = cp;
+        return 1;
+    }
+    // hangul syllable is L V (T) jamo in nfd
+    if (cp >= 0xAC00 && cp <= 0xD7A3) {
+        uint32_t index = cp - 0xAC00;
+        out[0] = 0x1100 + index / (21 * 28);
+        out[1] = 0x1161 + index % (21 * 28) / 28;
+        if (index % 28 == 0) {
+            return 2;
+        }
+        out[2] = 0x11A7 + index % 28;
+        return 3;
+    }
+    auto fold = std::lower_bound(std::begin(bert_folds), std::end(bert_folds), cp,
+                                 [](const uint32_t* entry, uint32_t value) { return entry[0] < value; });
+    if (fold != std::end(bert_folds) && (*fold)[0] == cp) {
+        out[0] = (*fold)[1];
+        return 1;
+    }
+    auto pair = std::lower_bound(std::begin(bert_fold_pairs), std::end(bert_fold_pairs), cp,
+                                 [](const uint32_t* entry, uint32_t value) { return entry[0] < value; });
+    if (pair != std::end(bert_fold_pairs) && (*pair)[0] == cp) {
+        out[0] = (*pair)[1];
+        out[1] = (*pair)[2];
+        return 2;
+    }
+    out[0] = cp;
+    return 1;
+}
+
+static inline void append_utf8(std::string& str, uint32_t cp) {
+    if (cp < 0x80) {
+        str.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        str.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        str.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        str.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+struct WordPieceHeader {
+    int32_t unk_id;
+};
+
+bool WordPiece::load_text(const std::string& filename, std::vector<char>& image) {
+    std::ifstream tok_file(filename);
+    std::string token;
+    std::vector<std::string> tokens;
+    while (tok_file >> token) {
+        tokens.push_back(base64_decode(token));
+    }
+    tok_file.close();
+    WordPieceHeader header;
+    header.unk_id = 100;
+    std::vector<std::pair<std::string_view, int>> pieces, suffixes;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        std::string_view piece(tokens[i]);
+        if (piece.size() > 2 && piece.substr(0, 2) == "##") {
+            suffixes.emplace_back(piece.substr(2), i);
+        } else {
+            pieces.emplace_back(piece, i);
+        }
+        if (piece == "[UNK]") {
+            header.unk_id = i;
+        }
+    }
+    Trie pieces_trie, suffixes_trie;
+    pieces_trie.build(pieces);
+    suffixes_trie.build(suffixes);
+    write_tokens(tokens, image);
+    append_section(image, &header, 1);
+    pieces_trie.save(image);
+    suffixes_trie.save(image);
+    return true;
 }
 
-std::string Tiktoken::decode(int id) {
-    if (id >= decoder_.size()) {
-        return "";
+bool WordPiece::map(const char* image, size_t size, size_t& offset) {
+    auto header = view_section<WordPieceHeader>(image, size, offset, 1);
+    if (header == nullptr) {
+        return false;
+    }
+    unk_id_ = header->unk_id;
+    return pieces_.map(image, size, offset) && suffixes_.map(image, size, offset);
+}
+
+// ref: https://github.com/google-research/bert/blob/master/tokenization.py
+void WordPiece::word_encode(std::string_view word, size_t chars, IdSink& ids) const {
+    const size_t max_chars = 100;
+    if (chars > max_chars) {
+        ids.push(unk_id_);
+        return;
+    }
+    size_t start = ids.size();
+    for (size_t pos = 0; pos < word.size();) {
+        size_t len = 0;
+        int id = pos == 0 ? pieces_.longest_match(word, &len) : suffixes_.longest_match(word.substr(pos), &len);
+        if (id < 0) {
+            ids.resize(start);
+            ids.push(unk_id_);
+            return;
+        }
+        ids.push(id);
+        pos += len;
+    }
+}
+
+// basic tokenization is one pass over the code points: control chars are dropped, whitespace
+// ends a word, cjk chars and punctuation are words of their own, the rest is folded into the word
+void WordPiece::encode_text(std::string_view str, IdSink& ids) {
+    thread_local std::string word;
+    word.clear();
+    size_t chars = 0;
+    auto end_word = [&]() {
+        if (!word.empty()) {
+            word_encode(word, chars, ids);
+            word.clear();
+            chars = 0;
+        }
+    };
+    auto alone = [&](uint32_t cp) {
+        end_word();
+        append_utf8(word, cp);
+        chars = 1;
+        end_word();
+    };
+    uint32_t folded[3];
+    for (size_t pos = 0; pos < str.size();) {
+        uint32_t cp;
+        size_t len = decode_utf8(str, pos, cp);
+        pos += std::max<size_t>(len, 1);
+        if (len == 0 || cp == 0 || cp == 0xFFFD) {
+            continue;
+        }
+        auto type = bert_class(cp);
+        if (type == BERT_CONTROL) {
+            continue;
+        }
+        if (type == BERT_SPACE) {
+            end_word();
+            continue;
+        }
+        if (is_cjk(cp)) {
+            if (lower_case_) {
+                bert_fold(cp, folded);
+                cp = folded[0];
+            }
+            alone(cp);
+            continue;
+        }
+        int count = 1;
+        folded[0] = cp;
+        if (lower_case_) {
+            if (type == BERT_MARK) {
+                continue;
+            }
+            count = bert_fold(cp, folded);
+            if (folded[0] != cp) {
+                type = bert_class(folded[0]);
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            if (type == BERT_PUNCT) {
+                alone(folded[i]);
+            } else {
+                append_utf8(word, folded[i]);
+                chars++;
+            }
+        }
+    }
+    end_word();
+}
+
+size_t WordPiece::max_count(std::string_view str) const {
+    size_t count = 0;
+    uint32_t folded[3];
+    for (size_t pos = 0; pos < str.size();) {
+        uint32_t cp;
+        size_t len = decode_utf8(str, pos, cp);
+        count += (lower_case_ && len > 1) ? bert_fold(cp, folded) : 1;
+        pos += std::max<size_t>(len, 1);
+    }
+    return count;
+}
+
+// words never cross ascii whitespace
+bool WordPiece::is_split(std::string_view str, size_t pos) const {
+    auto space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+    return space(str[pos]) || space(str[pos - 1]);
+}
+
+std::vector<size_t> WordPiece::split(std::string_view str, size_t chunk) const {
+    return split_points(str, chunk, [&](size_t pos) { return is_split(str, pos); });
+}
+
+std::vector<size_t> WordPiece::filter_splits(std::string_view str, const std::vector<size_t>& points) const {
+    std::vector<size_t> splits;
+    for (size_t pos : points) {
+        if (is_split(str, pos)) {
+            splits.push_back(pos);
+        }
     }
-    return decoder_[id];
+    return splits;
 }
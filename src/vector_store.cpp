@@ -0,0 +1,3540 @@
+//
+//  vector_store.cpp
+//
+
+#include <new>
+#include <chrono>
+#include <queue>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include "vector_store.hpp"
+#include "thread_pool.hpp"
+
+// Distance kernels start
+// `n` is a multiple of 16 and the pointers are rows of VectorMatrix, whose padding is zero.
+// x86 kernels are compiled for their own targets and picked by the cpu at runtime.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VECTOR_X86
+#include <immintrin.h>
+#if defined(__GNUC__)
+// cpus with avx2 and fma also have f16c and popcnt
+#define VECTOR_TARGET_AVX2 __attribute__((target("avx2,fma,f16c,popcnt")))
+#define VECTOR_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#define VECTOR_TARGET_POPCNT512 __attribute__((target("avx512f,avx512vpopcntdq")))
+#else
+#include <intrin.h>
+#define VECTOR_TARGET_AVX2
+#define VECTOR_TARGET_AVX512
+#define VECTOR_TARGET_POPCNT512
+#endif
+#elif defined(__aarch64__)
+#define VECTOR_NEON
+#include <arm_neon.h>
+#endif
+
+static float dot_generic(const float* a, const float* b, size_t n) {
+    float sum[8] = {0.f};
+    for (size_t i = 0; i < n; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            sum[j] += a[i + j] * b[i + j];
+        }
+    }
+    return ((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+}
+
+static float l2_generic(const float* a, const float* b, size_t n) {
+    float sum[8] = {0.f};
+    for (size_t i = 0; i < n; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            float diff = a[i + j] - b[i + j];
+            sum[j] += diff * diff;
+        }
+    }
+    return ((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+}
+
+// `columns` is a `dim` x `k` matrix with a vector in every column, `k` is a multiple of 16
+static void l2_columns_generic(const float* vector, const float* columns, size_t dim, size_t k, float* out) {
+    std::fill(out, out + k, 0.f);
+    for (size_t t = 0; t < dim; t++) {
+        const float* row = columns + t * k;
+        for (size_t c = 0; c < k; c++) {
+            float diff = vector[t] - row[c];
+            out[c] += diff * diff;
+        }
+    }
+}
+
+static void dot_columns_generic(const float* vector, const float* columns, size_t dim, size_t k, float* out) {
+    std::fill(out, out + k, 0.f);
+    for (size_t t = 0; t < dim; t++) {
+        const float* row = columns + t * k;
+        for (size_t c = 0; c < k; c++) {
+            out[c] += vector[t] * row[c];
+        }
+    }
+}
+
+// index of the smallest of `k` values, the first one of ties, `k` is a multiple of 16
+static size_t argmin_generic(const float* values, size_t k) {
+    size_t best = 0;
+    for (size_t i = 1; i < k; i++) {
+        if (values[i] < values[best]) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// the lane minimums kept by the simd argmin, reduced to the first smallest index
+static size_t argmin_lanes(const float* values, const int32_t* indices, int lanes) {
+    int best = 0;
+    for (int i = 1; i < lanes; i++) {
+        if (values[i] < values[best] || (values[i] == values[best] && indices[i] < indices[best])) {
+            best = i;
+        }
+    }
+    return indices[best];
+}
+
+// `codes` is a block of 16 rows coded by `m` bytes, interleaved so byte j of the rows is at [j * 16, j * 16 + 16).
+// The distance of a row is the sum of its entries of the m x 256 `table`.
+static void adc_generic(const float* table, const uint8_t* codes, size_t m, float* out) {
+    std::fill(out, out + 16, 0.f);
+    for (size_t j = 0; j < m; j++) {
+        for (int r = 0; r < 16; r++) {
+            out[r] += table[j * 256 + codes[j * 16 + r]];
+        }
+    }
+}
+
+static inline float half_to_float(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0) {
+        // zero or subnormal
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    ::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// rounded to the nearest half, ties to even
+static inline uint16_t float_to_half(float value) {
+    uint32_t bits;
+    ::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t mantissa = bits & 0x7fffff;
+    int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+    if (((bits >> 23) & 0xff) == 0xff) {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    uint32_t half, rest, halfway;
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        rest = mantissa & 0x1fff;
+        halfway = 0x1000;
+    }
+    // a carry into the exponent is still the right half
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+        half++;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+static inline int popcount64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return static_cast<int>((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+// index of the lowest set bit, `x` is not 0
+static inline int trailing_zeros64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    return popcount64((x & (~x + 1)) - 1);
+#endif
+}
+
+static float dot_f16_generic(const uint16_t* a, const float* b, size_t n) {
+    float sum[8] = {0.f};
+    for (size_t i = 0; i < n; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            sum[j] += half_to_float(a[i + j]) * b[i + j];
+        }
+    }
+    return ((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+}
+
+static float l2_f16_generic(const uint16_t* a, const float* b, size_t n) {
+    float sum[8] = {0.f};
+    for (size_t i = 0; i < n; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            float diff = half_to_float(a[i + j]) - b[i + j];
+            sum[j] += diff * diff;
+        }
+    }
+    return ((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+}
+
+static int32_t dot_u8s8_generic(const uint8_t* a, const int8_t* b, size_t n) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += static_cast<int32_t>(a[i]) * b[i];
+    }
+    return sum;
+}
+
+// bits that differ, `words` is a multiple of 8
+static uint32_t hamming_generic(const uint64_t* a, const uint64_t* b, size_t words) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < words; i++) {
+        sum += popcount64(a[i] ^ b[i]);
+    }
+    return sum;
+}
+
+// rows of a gemm tile
+static const size_t kTile = 4;
+
+// products of the kTile rows `a` and the kTile rows `b` of `n` floats, added to the kTile x kTile `out` of row stride `ldo`
+static void dot_tile_generic(const float* const* a, const float* const* b, size_t n, float* out, size_t ldo) {
+    for (size_t i = 0; i < kTile; i++) {
+        for (size_t j = 0; j < kTile; j++) {
+            out[i * ldo + j] += dot_generic(a[i], b[j], n);
+        }
+    }
+}
+
+#ifdef VECTOR_X86
+VECTOR_TARGET_AVX2 static inline float reduce_avx2(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+VECTOR_TARGET_AVX2 static float dot_avx2(const float* a, const float* b, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+        s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), s2);
+        s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), s3);
+    }
+    if (i < n) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+    }
+    return reduce_avx2(_mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+}
+
+VECTOR_TARGET_AVX2 static float l2_avx2(const float* a, const float* b, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        __m256 d2 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16));
+        __m256 d3 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24));
+        s0 = _mm256_fmadd_ps(d0, d0, s0);
+        s1 = _mm256_fmadd_ps(d1, d1, s1);
+        s2 = _mm256_fmadd_ps(d2, d2, s2);
+        s3 = _mm256_fmadd_ps(d3, d3, s3);
+    }
+    if (i < n) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        s0 = _mm256_fmadd_ps(d0, d0, s0);
+        s1 = _mm256_fmadd_ps(d1, d1, s1);
+    }
+    return reduce_avx2(_mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+}
+
+VECTOR_TARGET_AVX2 static void l2_columns_avx2(const float* vector, const float* columns, size_t dim, size_t k, float* out) {
+    size_t c = 0;
+    for (; c + 32 <= k; c += 32) {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        for (size_t t = 0; t < dim; t++) {
+            const float* row = columns + t * k + c;
+            __m256 q = _mm256_set1_ps(vector[t]);
+            __m256 d0 = _mm256_sub_ps(q, _mm256_loadu_ps(row));
+            __m256 d1 = _mm256_sub_ps(q, _mm256_loadu_ps(row + 8));
+            __m256 d2 = _mm256_sub_ps(q, _mm256_loadu_ps(row + 16));
+            __m256 d3 = _mm256_sub_ps(q, _mm256_loadu_ps(row + 24));
+            s0 = _mm256_fmadd_ps(d0, d0, s0);
+            s1 = _mm256_fmadd_ps(d1, d1, s1);
+            s2 = _mm256_fmadd_ps(d2, d2, s2);
+            s3 = _mm256_fmadd_ps(d3, d3, s3);
+        }
+        _mm256_storeu_ps(out + c, s0);
+        _mm256_storeu_ps(out + c + 8, s1);
+        _mm256_storeu_ps(out + c + 16, s2);
+        _mm256_storeu_ps(out + c + 24, s3);
+    }
+    if (c < k) {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        for (size_t t = 0; t < dim; t++) {
+            const float* row = columns + t * k + c;
+            __m256 q = _mm256_set1_ps(vector[t]);
+            __m256 d0 = _mm256_sub_ps(q, _mm256_loadu_ps(row));
+            __m256 d1 = _mm256_sub_ps(q, _mm256_loadu_ps(row + 8));
+            s0 = _mm256_fmadd_ps(d0, d0, s0);
+            s1 = _mm256_fmadd_ps(d1, d1, s1);
+        }
+        _mm256_storeu_ps(out + c, s0);
+        _mm256_storeu_ps(out + c + 8, s1);
+    }
+}
+
+VECTOR_TARGET_AVX2 static void dot_columns_avx2(const float* vector, const float* columns, size_t dim, size_t k, float* out) {
+    size_t c = 0;
+    for (; c + 32 <= k; c += 32) {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        for (size_t t = 0; t < dim; t++) {
+            const float* row = columns + t * k + c;
+            __m256 q = _mm256_set1_ps(vector[t]);
+            s0 = _mm256_fmadd_ps(q, _mm256_loadu_ps(row), s0);
+            s1 = _mm256_fmadd_ps(q, _mm256_loadu_ps(row + 8), s1);
+            s2 = _mm256_fmadd_ps(q, _mm256_loadu_ps(row + 16), s2);
+            s3 = _mm256_fmadd_ps(q, _mm256_loadu_ps(row + 24), s3);
+        }
+        _mm256_storeu_ps(out + c, s0);
+        _mm256_storeu_ps(out + c + 8, s1);
+        _mm256_storeu_ps(out + c + 16, s2);
+        _mm256_storeu_ps(out + c + 24, s3);
+    }
+    if (c < k) {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        for (size_t t = 0; t < dim; t++) {
+            const float* row = columns + t * k + c;
+            __m256 q = _mm256_set1_ps(vector[t]);
+            s0 = _mm256_fmadd_ps(q, _mm256_loadu_ps(row), s0);
+            s1 = _mm256_fmadd_ps(q, _mm256_loadu_ps(row + 8), s1);
+        }
+        _mm256_storeu_ps(out + c, s0);
+        _mm256_storeu_ps(out + c + 8, s1);
+    }
+}
+
+VECTOR_TARGET_AVX2 static size_t argmin_avx2(const float* values, size_t k) {
+    __m256 best = _mm256_loadu_ps(values);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i best_index = index;
+    const __m256i step = _mm256_set1_epi32(8);
+    for (size_t i = 8; i < k; i += 8) {
+        index = _mm256_add_epi32(index, step);
+        __m256 value = _mm256_loadu_ps(values + i);
+        __m256 less = _mm256_cmp_ps(value, best, _CMP_LT_OQ);
+        best = _mm256_blendv_ps(best, value, less);
+        best_index = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_index), _mm256_castsi256_ps(index), less));
+    }
+    float lane_values[8];
+    int32_t lane_indices[8];
+    _mm256_storeu_ps(lane_values, best);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_indices), best_index);
+    return argmin_lanes(lane_values, lane_indices, 8);
+}
+
+VECTOR_TARGET_AVX2 static void adc_avx2(const float* table, const uint8_t* codes, size_t m, float* out) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    for (size_t j = 0; j < m; j++) {
+        const uint8_t* block = codes + j * 16;
+        __m256i i0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(block)));
+        __m256i i1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(block + 8)));
+        s0 = _mm256_add_ps(s0, _mm256_i32gather_ps(table + j * 256, i0, 4));
+        s1 = _mm256_add_ps(s1, _mm256_i32gather_ps(table + j * 256, i1, 4));
+    }
+    _mm256_storeu_ps(out, s0);
+    _mm256_storeu_ps(out + 8, s1);
+}
+
+VECTOR_TARGET_AVX2 static float dot_f16_avx2(const uint16_t* a, const float* b, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    for (size_t i = 0; i < n; i += 16) {
+        __m256 a0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256 a1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 8)));
+        s0 = _mm256_fmadd_ps(a0, _mm256_loadu_ps(b + i), s0);
+        s1 = _mm256_fmadd_ps(a1, _mm256_loadu_ps(b + i + 8), s1);
+    }
+    return reduce_avx2(_mm256_add_ps(s0, s1));
+}
+
+VECTOR_TARGET_AVX2 static float l2_f16_avx2(const uint16_t* a, const float* b, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    for (size_t i = 0; i < n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i))), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 8))), _mm256_loadu_ps(b + i + 8));
+        s0 = _mm256_fmadd_ps(d0, d0, s0);
+        s1 = _mm256_fmadd_ps(d1, d1, s1);
+    }
+    return reduce_avx2(_mm256_add_ps(s0, s1));
+}
+
+VECTOR_TARGET_AVX2 static inline int32_t reduce_epi32_avx2(__m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+// bytes are widened to 16 bits before madd, so the products never saturate
+VECTOR_TARGET_AVX2 static int32_t dot_u8s8_avx2(const uint8_t* a, const int8_t* b, size_t n) {
+    __m256i s0 = _mm256_setzero_si256();
+    for (size_t i = 0; i < n; i += 16) {
+        __m256i a0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(a0, b0));
+    }
+    return reduce_epi32_avx2(s0);
+}
+
+VECTOR_TARGET_AVX2 static uint32_t hamming_popcnt(const uint64_t* a, const uint64_t* b, size_t words) {
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (size_t i = 0; i < words; i += 4) {
+        s0 += popcount64(a[i] ^ b[i]);
+        s1 += popcount64(a[i + 1] ^ b[i + 1]);
+        s2 += popcount64(a[i + 2] ^ b[i + 2]);
+        s3 += popcount64(a[i + 3] ^ b[i + 3]);
+    }
+    return static_cast<uint32_t>(s0 + s1 + s2 + s3);
+}
+
+// sums of 8 vectors in one, [s0, s1, s2, s3] in the low half and [s4, s5, s6, s7] in the high half
+VECTOR_TARGET_AVX2 static inline __m256 reduce8_avx2(__m256 s0, __m256 s1, __m256 s2, __m256 s3,
+                                                     __m256 s4, __m256 s5, __m256 s6, __m256 s7) {
+    __m256 low = _mm256_hadd_ps(_mm256_hadd_ps(s0, s1), _mm256_hadd_ps(s2, s3));
+    __m256 high = _mm256_hadd_ps(_mm256_hadd_ps(s4, s5), _mm256_hadd_ps(s6, s7));
+    return _mm256_add_ps(_mm256_permute2f128_ps(low, high, 0x20), _mm256_permute2f128_ps(low, high, 0x31));
+}
+
+// two rows of the tile at a time, so the 8 sums and the loads fit the 16 registers
+VECTOR_TARGET_AVX2 static void dot_tile_avx2(const float* const* a, const float* const* b, size_t n, float* out, size_t ldo) {
+    for (size_t i = 0; i < kTile; i += 2) {
+        __m256 s00 = _mm256_setzero_ps(), s01 = _mm256_setzero_ps(), s02 = _mm256_setzero_ps(), s03 = _mm256_setzero_ps();
+        __m256 s10 = _mm256_setzero_ps(), s11 = _mm256_setzero_ps(), s12 = _mm256_setzero_ps(), s13 = _mm256_setzero_ps();
+        const float *a0 = a[i], *a1 = a[i + 1];
+        for (size_t k = 0; k < n; k += 8) {
+            __m256 x0 = _mm256_loadu_ps(a0 + k), x1 = _mm256_loadu_ps(a1 + k);
+            __m256 y = _mm256_loadu_ps(b[0] + k);
+            s00 = _mm256_fmadd_ps(x0, y, s00);
+            s10 = _mm256_fmadd_ps(x1, y, s10);
+            y = _mm256_loadu_ps(b[1] + k);
+            s01 = _mm256_fmadd_ps(x0, y, s01);
+            s11 = _mm256_fmadd_ps(x1, y, s11);
+            y = _mm256_loadu_ps(b[2] + k);
+            s02 = _mm256_fmadd_ps(x0, y, s02);
+            s12 = _mm256_fmadd_ps(x1, y, s12);
+            y = _mm256_loadu_ps(b[3] + k);
+            s03 = _mm256_fmadd_ps(x0, y, s03);
+            s13 = _mm256_fmadd_ps(x1, y, s13);
+        }
+        __m256 sums = reduce8_avx2(s00, s01, s02, s03, s10, s11, s12, s13);
+        float* o0 = out + i * ldo;
+        float* o1 = o0 + ldo;
+        _mm_storeu_ps(o0, _mm_add_ps(_mm_loadu_ps(o0), _mm256_castps256_ps128(sums)));
+        _mm_storeu_ps(o1, _mm_add_ps(_mm_loadu_ps(o1), _mm256_extractf128_ps(sums, 1)));
+    }
+}
+
+VECTOR_TARGET_AVX512 static float dot_avx512(const float* a, const float* b, size_t n) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+        s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), s1);
+    }
+    if (i < n) {
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+VECTOR_TARGET_AVX512 static float l2_avx512(const float* a, const float* b, size_t n) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        s0 = _mm512_fmadd_ps(d0, d0, s0);
+        s1 = _mm512_fmadd_ps(d1, d1, s1);
+    }
+    if (i < n) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        s0 = _mm512_fmadd_ps(d0, d0, s0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+VECTOR_TARGET_AVX512 static void l2_columns_avx512(const float* vector, const float* columns, size_t dim, size_t k, float* out) {
+    size_t c = 0;
+    for (; c + 64 <= k; c += 64) {
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+        __m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+        for (size_t t = 0; t < dim; t++) {
+            const float* row = columns + t * k + c;
+            __m512 q = _mm512_set1_ps(vector[t]);
+            __m512 d0 = _mm512_sub_ps(q, _mm512_loadu_ps(row));
+            __m512 d1 = _mm512_sub_ps(q, _mm512_loadu_ps(row + 16));
+            __m512 d2 = _mm512_sub_ps(q, _mm512_loadu_ps(row + 32));
+            __m512 d3 = _mm512_sub_ps(q, _mm512_loadu_ps(row + 48));
+            s0 = _mm512_fmadd_ps(d0, d0, s0);
+            s1 = _mm512_fmadd_ps(d1, d1, s1);
+            s2 = _mm512_fmadd_ps(d2, d2, s2);
+            s3 = _mm512_fmadd_ps(d3, d3, s3);
+        }
+        _mm512_storeu_ps(out + c, s0);
+        _mm512_storeu_ps(out + c + 16, s1);
+        _mm512_storeu_ps(out + c + 32, s2);
+        _mm512_storeu_ps(out + c + 48, s3);
+    }
+    for (; c < k; c += 16) {
+        __m512 s0 = _mm512_setzero_ps();
+        for (size_t t = 0; t < dim; t++) {
+            __m512 d0 = _mm512_sub_ps(_mm512_set1_ps(vector[t]), _mm512_loadu_ps(columns + t * k + c));
+            s0 = _mm512_fmadd_ps(d0, d0, s0);
+        }
+        _mm512_storeu_ps(out + c, s0);
+    }
+}
+
+VECTOR_TARGET_AVX512 static void dot_columns_avx512(const float* vector, const float* columns, size_t dim, size_t k, float* out) {
+    size_t c = 0;
+    for (; c + 64 <= k; c += 64) {
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+        __m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+        for (size_t t = 0; t < dim; t++) {
+            const float* row = columns + t * k + c;
+            __m512 q = _mm512_set1_ps(vector[t]);
+            s0 = _mm512_fmadd_ps(q, _mm512_loadu_ps(row), s0);
+            s1 = _mm512_fmadd_ps(q, _mm512_loadu_ps(row + 16), s1);
+            s2 = _mm512_fmadd_ps(q, _mm512_loadu_ps(row + 32), s2);
+            s3 = _mm512_fmadd_ps(q, _mm512_loadu_ps(row + 48), s3);
+        }
+        _mm512_storeu_ps(out + c, s0);
+        _mm512_storeu_ps(out + c + 16, s1);
+        _mm512_storeu_ps(out + c + 32, s2);
+        _mm512_storeu_ps(out + c + 48, s3);
+    }
+    for (; c < k; c += 16) {
+        __m512 s0 = _mm512_setzero_ps();
+        for (size_t t = 0; t < dim; t++) {
+            s0 = _mm512_fmadd_ps(_mm512_set1_ps(vector[t]), _mm512_loadu_ps(columns + t * k + c), s0);
+        }
+        _mm512_storeu_ps(out + c, s0);
+    }
+}
+
+VECTOR_TARGET_AVX512 static size_t argmin_avx512(const float* values, size_t k) {
+    __m512 best = _mm512_loadu_ps(values);
+    __m512i index = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i best_index = index;
+    const __m512i step = _mm512_set1_epi32(16);
+    for (size_t i = 16; i < k; i += 16) {
+        index = _mm512_add_epi32(index, step);
+        __m512 value = _mm512_loadu_ps(values + i);
+        __mmask16 less = _mm512_cmp_ps_mask(value, best, _CMP_LT_OQ);
+        best = _mm512_mask_mov_ps(best, less, value);
+        best_index = _mm512_mask_mov_epi32(best_index, less, index);
+    }
+    float lane_values[16];
+    int32_t lane_indices[16];
+    _mm512_storeu_ps(lane_values, best);
+    _mm512_storeu_si512(lane_indices, best_index);
+    return argmin_lanes(lane_values, lane_indices, 16);
+}
+
+VECTOR_TARGET_AVX512 static void adc_avx512(const float* table, const uint8_t* codes, size_t m, float* out) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t j = 0;
+    for (; j + 2 <= m; j += 2) {
+        __m512i i0 = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j * 16)));
+        __m512i i1 = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j * 16 + 16)));
+        s0 = _mm512_add_ps(s0, _mm512_i32gather_ps(i0, table + j * 256, 4));
+        s1 = _mm512_add_ps(s1, _mm512_i32gather_ps(i1, table + j * 256 + 256, 4));
+    }
+    if (j < m) {
+        __m512i i0 = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j * 16)));
+        s0 = _mm512_add_ps(s0, _mm512_i32gather_ps(i0, table + j * 256, 4));
+    }
+    _mm512_storeu_ps(out, _mm512_add_ps(s0, s1));
+}
+
+VECTOR_TARGET_AVX512 static float dot_f16_avx512(const uint16_t* a, const float* b, size_t n) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 a0 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        __m512 a1 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 16)));
+        s0 = _mm512_fmadd_ps(a0, _mm512_loadu_ps(b + i), s0);
+        s1 = _mm512_fmadd_ps(a1, _mm512_loadu_ps(b + i + 16), s1);
+    }
+    if (i < n) {
+        __m512 a0 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        s0 = _mm512_fmadd_ps(a0, _mm512_loadu_ps(b + i), s0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+VECTOR_TARGET_AVX512 static float l2_f16_avx512(const uint16_t* a, const float* b, size_t n) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i))), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 16))), _mm512_loadu_ps(b + i + 16));
+        s0 = _mm512_fmadd_ps(d0, d0, s0);
+        s1 = _mm512_fmadd_ps(d1, d1, s1);
+    }
+    if (i < n) {
+        __m512 d0 = _mm512_sub_ps(_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i))), _mm512_loadu_ps(b + i));
+        s0 = _mm512_fmadd_ps(d0, d0, s0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+VECTOR_TARGET_AVX512 static int32_t dot_u8s8_avx512(const uint8_t* a, const int8_t* b, size_t n) {
+    __m512i s0 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512i a0 = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        __m512i b0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        s0 = _mm512_add_epi32(s0, _mm512_madd_epi16(a0, b0));
+    }
+    if (i < n) {
+        __m256i a0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        s0 = _mm512_add_epi32(s0, _mm512_zextsi256_si512(_mm256_madd_epi16(a0, b0)));
+    }
+    return _mm512_reduce_add_epi32(s0);
+}
+
+// sums of the 4 vectors in every 128 bit lane, [s0, s1, s2, s3] in each
+VECTOR_TARGET_AVX512 static inline __m512 reduce4_avx512(__m512 s0, __m512 s1, __m512 s2, __m512 s3) {
+    __m512 s01 = _mm512_add_ps(_mm512_unpacklo_ps(s0, s1), _mm512_unpackhi_ps(s0, s1));
+    __m512 s23 = _mm512_add_ps(_mm512_unpacklo_ps(s2, s3), _mm512_unpackhi_ps(s2, s3));
+    return _mm512_add_ps(_mm512_shuffle_ps(s01, s23, 0x44), _mm512_shuffle_ps(s01, s23, 0xee));
+}
+
+// the 16 sums are reduced in one vector, lane i holds row i of the tile
+VECTOR_TARGET_AVX512 static void dot_tile_avx512(const float* const* a, const float* const* b, size_t n, float* out, size_t ldo) {
+    __m512 s00 = _mm512_setzero_ps(), s01 = _mm512_setzero_ps(), s02 = _mm512_setzero_ps(), s03 = _mm512_setzero_ps();
+    __m512 s10 = _mm512_setzero_ps(), s11 = _mm512_setzero_ps(), s12 = _mm512_setzero_ps(), s13 = _mm512_setzero_ps();
+    __m512 s20 = _mm512_setzero_ps(), s21 = _mm512_setzero_ps(), s22 = _mm512_setzero_ps(), s23 = _mm512_setzero_ps();
+    __m512 s30 = _mm512_setzero_ps(), s31 = _mm512_setzero_ps(), s32 = _mm512_setzero_ps(), s33 = _mm512_setzero_ps();
+    const float *a0 = a[0], *a1 = a[1], *a2 = a[2], *a3 = a[3];
+    const float *b0 = b[0], *b1 = b[1], *b2 = b[2], *b3 = b[3];
+    for (size_t k = 0; k < n; k += 16) {
+        __m512 y0 = _mm512_loadu_ps(b0 + k), y1 = _mm512_loadu_ps(b1 + k);
+        __m512 y2 = _mm512_loadu_ps(b2 + k), y3 = _mm512_loadu_ps(b3 + k);
+        __m512 x = _mm512_loadu_ps(a0 + k);
+        s00 = _mm512_fmadd_ps(x, y0, s00);
+        s01 = _mm512_fmadd_ps(x, y1, s01);
+        s02 = _mm512_fmadd_ps(x, y2, s02);
+        s03 = _mm512_fmadd_ps(x, y3, s03);
+        x = _mm512_loadu_ps(a1 + k);
+        s10 = _mm512_fmadd_ps(x, y0, s10);
+        s11 = _mm512_fmadd_ps(x, y1, s11);
+        s12 = _mm512_fmadd_ps(x, y2, s12);
+        s13 = _mm512_fmadd_ps(x, y3, s13);
+        x = _mm512_loadu_ps(a2 + k);
+        s20 = _mm512_fmadd_ps(x, y0, s20);
+        s21 = _mm512_fmadd_ps(x, y1, s21);
+        s22 = _mm512_fmadd_ps(x, y2, s22);
+        s23 = _mm512_fmadd_ps(x, y3, s23);
+        x = _mm512_loadu_ps(a3 + k);
+        s30 = _mm512_fmadd_ps(x, y0, s30);
+        s31 = _mm512_fmadd_ps(x, y1, s31);
+        s32 = _mm512_fmadd_ps(x, y2, s32);
+        s33 = _mm512_fmadd_ps(x, y3, s33);
+    }
+    __m512 r0 = reduce4_avx512(s00, s01, s02, s03), r1 = reduce4_avx512(s10, s11, s12, s13);
+    __m512 r2 = reduce4_avx512(s20, s21, s22, s23), r3 = reduce4_avx512(s30, s31, s32, s33);
+    // lanes of r0 and r1 paired, then the pairs summed
+    __m512 r01 = _mm512_add_ps(_mm512_shuffle_f32x4(r0, r1, 0x44), _mm512_shuffle_f32x4(r0, r1, 0xee));
+    __m512 r23 = _mm512_add_ps(_mm512_shuffle_f32x4(r2, r3, 0x44), _mm512_shuffle_f32x4(r2, r3, 0xee));
+    __m512 sums = _mm512_add_ps(_mm512_shuffle_f32x4(r01, r23, 0x88), _mm512_shuffle_f32x4(r01, r23, 0xdd));
+    float* o0 = out;
+    float* o1 = o0 + ldo;
+    float* o2 = o1 + ldo;
+    float* o3 = o2 + ldo;
+    _mm_storeu_ps(o0, _mm_add_ps(_mm_loadu_ps(o0), _mm512_extractf32x4_ps(sums, 0)));
+    _mm_storeu_ps(o1, _mm_add_ps(_mm_loadu_ps(o1), _mm512_extractf32x4_ps(sums, 1)));
+    _mm_storeu_ps(o2, _mm_add_ps(_mm_loadu_ps(o2), _mm512_extractf32x4_ps(sums, 2)));
+    _mm_storeu_ps(o3, _mm_add_ps(_mm_loadu_ps(o3), _mm512_extractf32x4_ps(sums, 3)));
+}
+
+VECTOR_TARGET_POPCNT512 static uint32_t hamming_avx512(const uint64_t* a, const uint64_t* b, size_t words) {
+    __m512i s0 = _mm512_setzero_si512();
+    for (size_t i = 0; i < words; i += 8) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        s0 = _mm512_add_epi64(s0, _mm512_popcnt_epi64(x));
+    }
+    return static_cast<uint32_t>(_mm512_reduce_add_epi64(s0));
+}
+
+// 0: sse only, 1: avx2 and fma, 2: avx512f and avx512bw
+static int x86_level() {
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return 2;
+    }
+    return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? 1 : 0;
+#else
+    int info[4];
+    __cpuid(info, 1);
+    bool fma = (info[2] >> 12) & 1, avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1);
+    if (!avx) {
+        return 0;
+    }
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if ((info[1] >> 16 & 1) && (info[1] >> 30 & 1) && (xcr0 & 0xE6) == 0xE6) {
+        return 2;
+    }
+    return ((info[1] >> 5 & 1) && fma && (xcr0 & 6) == 6) ? 1 : 0;
+#endif
+}
+
+// avx512 vpopcntdq, checked on top of level 2
+static bool x86_popcnt512() {
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("avx512vpopcntdq");
+#else
+    int info[4];
+    __cpuidex(info, 7, 0);
+    return info[2] >> 14 & 1;
+#endif
+}
+#endif // VECTOR_X86
+
+#ifdef VECTOR_NEON
+static float dot_neon(const float* a, const float* b, size_t n) {
+    float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f), s2 = vdupq_n_f32(0.f), s3 = vdupq_n_f32(0.f);
+    for (size_t i = 0; i < n; i += 16) {
+        s0 = vfmaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+        s1 = vfmaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        s2 = vfmaq_f32(s2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+        s3 = vfmaq_f32(s3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+    }
+    return vaddvq_f32(vaddq_f32(vaddq_f32(s0, s1), vaddq_f32(s2, s3)));
+}
+
+static float l2_neon(const float* a, const float* b, size_t n) {
+    float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f), s2 = vdupq_n_f32(0.f), s3 = vdupq_n_f32(0.f);
+    for (size_t i = 0; i < n; i += 16) {
+        float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        float32x4_t d2 = vsubq_f32(vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+        float32x4_t d3 = vsubq_f32(vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+        s0 = vfmaq_f32(s0, d0, d0);
+        s1 = vfmaq_f32(s1, d1, d1);
+        s2 = vfmaq_f32(s2, d2, d2);
+        s3 = vfmaq_f32(s3, d3, d3);
+    }
+    return vaddvq_f32(vaddq_f32(vaddq_f32(s0, s1), vaddq_f32(s2, s3)));
+}
+#endif // VECTOR_NEON
+
+struct DistanceKernels {
+    float (*dot)(const float* a, const float* b, size_t n);
+    float (*l2)(const float* a, const float* b, size_t n);
+    // distances to all columns at once
+    void (*dot_columns)(const float* vector, const float* columns, size_t dim, size_t k, float* out);
+    void (*l2_columns)(const float* vector, const float* columns, size_t dim, size_t k, float* out);
+    size_t (*argmin)(const float* values, size_t k);
+    void (*adc)(const float* table, const uint8_t* codes, size_t m, float* out);
+    // rows of scalar codes
+    float (*dot_f16)(const uint16_t* a, const float* b, size_t n);
+    float (*l2_f16)(const uint16_t* a, const float* b, size_t n);
+    int32_t (*dot_u8s8)(const uint8_t* a, const int8_t* b, size_t n);
+    uint32_t (*hamming)(const uint64_t* a, const uint64_t* b, size_t words);
+    // gemm micro kernel of batched search
+    void (*dot_tile)(const float* const* a, const float* const* b, size_t n, float* out, size_t ldo);
+};
+
+static DistanceKernels select_kernels() {
+#if defined(VECTOR_X86)
+    switch (x86_level()) {
+        case 2:
+            return {dot_avx512, l2_avx512, dot_columns_avx512, l2_columns_avx512, argmin_avx512, adc_avx512,
+                    dot_f16_avx512, l2_f16_avx512, dot_u8s8_avx512, x86_popcnt512() ? hamming_avx512 : hamming_popcnt,
+                    dot_tile_avx512};
+        case 1:
+            return {dot_avx2, l2_avx2, dot_columns_avx2, l2_columns_avx2, argmin_avx2, adc_avx2,
+                    dot_f16_avx2, l2_f16_avx2, dot_u8s8_avx2, hamming_popcnt, dot_tile_avx2};
+        default:
+            break;
+    }
+#elif defined(VECTOR_NEON)
+    // the loops of the generic kernels are vectorized by the compiler, neon has no gather for adc
+    return {dot_neon, l2_neon, dot_columns_generic, l2_columns_generic, argmin_generic, adc_generic,
+            dot_f16_generic, l2_f16_generic, dot_u8s8_generic, hamming_generic, dot_tile_generic};
+#endif
+    return {dot_generic, l2_generic, dot_columns_generic, l2_columns_generic, argmin_generic, adc_generic,
+            dot_f16_generic, l2_f16_generic, dot_u8s8_generic, hamming_generic, dot_tile_generic};
+}
+
+static const DistanceKernels& kernels() {
+    static const DistanceKernels selected = select_kernels();
+    return selected;
+}
+// index of the centroid nearest to `vector`, by `-dot` if `inner_product`, else by l2
+static int nearest_centroid(const VectorMatrix& centroids, const float* vector, bool inner_product) {
+    const auto& kernel = kernels();
+    int best = 0;
+    float best_distance = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < centroids.size(); i++) {
+        float distance = inner_product ? -kernel.dot(vector, centroids.row(i), centroids.stride())
+                                       : kernel.l2(vector, centroids.row(i), centroids.stride());
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+// `centroids` as the columns of a dim x `k` matrix, `k` is padded to 16 by zero columns
+static void centroid_columns(const VectorMatrix& centroids, std::vector<float>& columns, size_t& k) {
+    k = (centroids.size() + 15) / 16 * 16;
+    columns.assign(centroids.dim() * k, 0.f);
+    for (size_t c = 0; c < centroids.size(); c++) {
+        const float* row = centroids.row(c);
+        for (int t = 0; t < centroids.dim(); t++) {
+            columns[t * k + c] = row[t];
+        }
+    }
+}
+
+static void normalize(float* vector, size_t n) {
+    float norm = std::sqrt(kernels().dot(vector, vector, n));
+    if (norm > 0.f) {
+        for (size_t i = 0; i < n; i++) {
+            vector[i] /= norm;
+        }
+    }
+}
+
+// Distance kernels end
+
+// VectorMatrix start
+void VectorMatrix::reset(int dim) {
+    release();
+    dim_ = dim;
+    stride_ = (dim + 15) / 16 * 16;
+}
+
+void VectorMatrix::release() {
+    if (data_ != nullptr && owned_) {
+        ::operator delete(data_, std::align_val_t(kAlign));
+    }
+    data_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+    owned_ = true;
+}
+
+void VectorMatrix::reserve(size_t rows) {
+    if (rows <= capacity_) {
+        return;
+    }
+    size_t capacity = std::max<size_t>(capacity_ * 2, 64);
+    while (capacity < rows) {
+        capacity *= 2;
+    }
+    auto data = static_cast<float*>(::operator new(capacity * stride_ * sizeof(float), std::align_val_t(kAlign)));
+    if (size_ > 0) {
+        ::memcpy(data, data_, size_ * stride_ * sizeof(float));
+    }
+    size_t size = size_;
+    release();
+    data_ = data;
+    size_ = size;
+    capacity_ = capacity;
+}
+
+void VectorMatrix::view(const float* data, size_t n, int dim) {
+    reset(dim);
+    if (n == 0) {
+        return;
+    }
+    // rows are never written in place, and the borrowed capacity is full, so the next append copies them
+    data_ = const_cast<float*>(data);
+    size_ = n;
+    capacity_ = n;
+    owned_ = false;
+}
+
+void VectorMatrix::append(const float* rows, size_t n) {
+    reserve(size_ + n);
+    for (size_t i = 0; i < n; i++) {
+        float* dst = row(size_ + i);
+        ::memcpy(dst, rows + i * dim_, dim_ * sizeof(float));
+        // padding is zero, so kernels may run over whole strides
+        std::fill(dst + dim_, dst + stride_, 0.f);
+    }
+    size_ += n;
+}
+// VectorMatrix end
+
+// Bitset start
+void Bitset::resize(size_t size, bool value) {
+    size_t old_size = size_;
+    size_ = size;
+    words_.resize((size + 63) / 64, 0);
+    if (value) {
+        for (size_t i = old_size; i < size && i % 64; i++) {
+            set(i);
+        }
+        for (size_t w = (old_size + 63) / 64; w < words_.size(); w++) {
+            words_[w] = ~uint64_t(0);
+        }
+    }
+    clear_tail();
+}
+
+void Bitset::clear_tail() {
+    if (size_ % 64) {
+        words_.back() &= (uint64_t(1) << (size_ % 64)) - 1;
+    }
+}
+
+size_t Bitset::count() const {
+    size_t count = 0;
+    for (uint64_t word : words_) {
+        count += popcount64(word);
+    }
+    return count;
+}
+
+size_t Bitset::next(size_t i) const {
+    if (i >= size_) {
+        return npos;
+    }
+    size_t w = i >> 6;
+    uint64_t word = words_[w] & (~uint64_t(0) << (i & 63));
+    while (word == 0) {
+        if (++w == words_.size()) {
+            return npos;
+        }
+        word = words_[w];
+    }
+    return w * 64 + trailing_zeros64(word);
+}
+
+Bitset& Bitset::operator&=(const Bitset& other) {
+    for (size_t w = 0; w < words_.size(); w++) {
+        words_[w] &= w < other.words_.size() ? other.words_[w] : 0;
+    }
+    return *this;
+}
+
+Bitset& Bitset::operator|=(const Bitset& other) {
+    for (size_t w = 0; w < std::min(words_.size(), other.words_.size()); w++) {
+        words_[w] |= other.words_[w];
+    }
+    clear_tail();
+    return *this;
+}
+
+void Bitset::flip() {
+    for (auto& word : words_) {
+        word = ~word;
+    }
+    clear_tail();
+}
+// Bitset end
+
+// Filter start
+struct Filter::Node {
+    Op op;
+    std::string column;
+    // sorted
+    std::vector<int64_t> ints;
+    std::vector<std::string> strings;
+    int64_t lo = 0;
+    int64_t hi = 0;
+    std::shared_ptr<const Node> left;
+    std::shared_ptr<const Node> right;
+};
+
+Filter Filter::range(const std::string& column, int64_t lo, int64_t hi) {
+    auto node = std::make_shared<Node>();
+    node->op = RANGE;
+    node->column = column;
+    node->lo = lo;
+    node->hi = hi;
+    return Filter(node);
+}
+
+Filter Filter::in(const std::string& column, const std::vector<int64_t>& values) {
+    auto node = std::make_shared<Node>();
+    node->op = IN_INTS;
+    node->column = column;
+    node->ints = values;
+    std::sort(node->ints.begin(), node->ints.end());
+    return Filter(node);
+}
+
+Filter Filter::in(const std::string& column, const std::vector<std::string>& values) {
+    auto node = std::make_shared<Node>();
+    node->op = IN_STRINGS;
+    node->column = column;
+    node->strings = values;
+    return Filter(node);
+}
+
+Filter Filter::operator&&(const Filter& other) const {
+    auto node = std::make_shared<Node>();
+    node->op = AND;
+    node->left = node_;
+    node->right = other.node_;
+    return Filter(node);
+}
+
+Filter Filter::operator||(const Filter& other) const {
+    auto node = std::make_shared<Node>();
+    node->op = OR;
+    node->left = node_;
+    node->right = other.node_;
+    return Filter(node);
+}
+
+Filter Filter::operator!() const {
+    auto node = std::make_shared<Node>();
+    node->op = NOT;
+    node->left = node_;
+    return Filter(node);
+}
+// Filter end
+
+// image sections are padded to 8 bytes
+template <typename T>
+static void append_section(std::vector<char>& image, const T* data, size_t count) {
+    const char* bytes = reinterpret_cast<const char*>(data);
+    image.insert(image.end(), bytes, bytes + count * sizeof(T));
+    image.resize((image.size() + 7) / 8 * 8, 0);
+}
+
+template <typename T>
+static const T* view_section(const char* image, size_t size, size_t& offset, size_t count) {
+    size_t bytes = (count * sizeof(T) + 7) / 8 * 8;
+    if (offset > size || bytes > size - offset) {
+        return nullptr;
+    }
+    auto data = reinterpret_cast<const T*>(image + offset);
+    offset += bytes;
+    return data;
+}
+
+// rows of a matrix are saved with their padding, so `stride` floats each
+static void append_matrix(std::vector<char>& image, const VectorMatrix& matrix) {
+    int32_t shape[2] = {static_cast<int32_t>(matrix.size()), matrix.dim()};
+    append_section(image, shape, 2);
+    if (!matrix.empty()) {
+        append_section(image, matrix.row(0), matrix.size() * matrix.stride());
+    }
+}
+
+static bool view_matrix(const char* image, size_t size, size_t& offset, VectorMatrix& matrix) {
+    auto shape = view_section<int32_t>(image, size, offset, 2);
+    if (shape == nullptr || shape[0] < 0 || shape[1] < 0) {
+        return false;
+    }
+    matrix.reset(shape[1]);
+    auto data = view_section<float>(image, size, offset, static_cast<size_t>(shape[0]) * matrix.stride());
+    if (data == nullptr) {
+        return false;
+    }
+    matrix.reserve(shape[0]);
+    for (int32_t i = 0; i < shape[0]; i++) {
+        matrix.append(data + i * matrix.stride(), 1);
+    }
+    return true;
+}
+
+// lloyd k-means of the rows of `data` into `k` centroids, seeded with distinct random rows.
+// `inner_product` assigns by the largest dot product and keeps the centroids normalized.
+static void kmeans(const VectorMatrix& data, int k, int iterations, bool inner_product, VectorMatrix& centroids) {
+    const size_t n = data.size();
+    const size_t stride = data.stride();
+    std::mt19937 rng(1234);
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    k = std::min<int>(k, n);
+    centroids.reset(data.dim());
+    centroids.reserve(k);
+    for (int i = 0; i < k; i++) {
+        std::swap(order[i], order[i + rng() % (n - i)]);
+        centroids.append(data.row(order[i]), 1);
+    }
+    std::vector<int> assign(n);
+    std::vector<size_t> counts(k), offsets(k + 1), members(n);
+    const size_t block = 256;
+    const auto& kernel = kernels();
+    std::vector<float> columns;
+    size_t padded = 0;
+    for (int iter = 0; iter < iterations; iter++) {
+        // distances to all centroids in one pass, so small dims are not dominated by calls
+        centroid_columns(centroids, columns, padded);
+        ThreadPool::shared().parallel_for((n + block - 1) / block, [&](size_t b) {
+            std::vector<float> distances(padded);
+            for (size_t i = b * block; i < std::min(n, (b + 1) * block); i++) {
+                if (inner_product) {
+                    kernel.dot_columns(data.row(i), columns.data(), data.dim(), padded, distances.data());
+                    for (auto& distance : distances) {
+                        distance = -distance;
+                    }
+                } else {
+                    kernel.l2_columns(data.row(i), columns.data(), data.dim(), padded, distances.data());
+                }
+                // the zero columns of padding are never picked
+                std::fill(distances.begin() + k, distances.end(), std::numeric_limits<float>::infinity());
+                assign[i] = static_cast<int>(kernel.argmin(distances.data(), padded));
+            }
+        });
+        // members of every centroid by counting sort
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < n; i++) {
+            counts[assign[i]]++;
+        }
+        for (int c = 0; c < k; c++) {
+            offsets[c + 1] = offsets[c] + counts[c];
+        }
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < n; i++) {
+            members[offsets[assign[i]] + counts[assign[i]]++] = i;
+        }
+        ThreadPool::shared().parallel_for(k, [&](size_t c) {
+            if (counts[c] == 0) {
+                return;
+            }
+            float* centroid = centroids.row(c);
+            std::fill(centroid, centroid + stride, 0.f);
+            for (size_t m = offsets[c]; m < offsets[c + 1]; m++) {
+                const float* row = data.row(members[m]);
+                for (size_t j = 0; j < stride; j++) {
+                    centroid[j] += row[j];
+                }
+            }
+            for (size_t j = 0; j < stride; j++) {
+                centroid[j] /= counts[c];
+            }
+            if (inner_product) {
+                normalize(centroid, stride);
+            }
+        });
+        // an empty centroid splits the largest one in two
+        for (int c = 0; c < k; c++) {
+            if (counts[c] > 0) {
+                continue;
+            }
+            int largest = std::max_element(counts.begin(), counts.end()) - counts.begin();
+            const float eps = 1.f / 1024;
+            float* split = centroids.row(c);
+            float* from = centroids.row(largest);
+            for (int j = 0; j < data.dim(); j++) {
+                split[j] = from[j] * (j % 2 ? 1 + eps : 1 - eps);
+                from[j] = from[j] * (j % 2 ? 1 - eps : 1 + eps);
+            }
+            counts[c] = counts[largest] / 2;
+            counts[largest] -= counts[c];
+        }
+    }
+}
+
+// at most `count` rows of `data` by selection sampling, which keeps their order
+static void sample_rows(const VectorMatrix& data, size_t count, uint32_t seed, VectorMatrix& sample) {
+    const size_t n = data.size();
+    count = std::min(count, n);
+    sample.reset(data.dim());
+    sample.reserve(count);
+    std::mt19937 rng(seed);
+    for (size_t i = 0, picked = 0; i < n && picked < count; i++) {
+        if (rng() % (n - i) < count - picked) {
+            sample.append(data.row(i), 1);
+            picked++;
+        }
+    }
+}
+
+// ProductQuantizer start
+// rows a product quantizer is trained on
+static const size_t kPqTrainRows = ProductQuantizer::kCentroids * 32;
+
+// eigen decomposition of the symmetric n x n `matrix` by householder tridiagonalization and the QL algorithm,
+// as tred2 and tql2 of JAMA. `matrix` is replaced by the eigenvectors in its rows, `values` are their eigenvalues.
+static void symmetric_eigen(std::vector<double>& matrix, int n, std::vector<double>& values) {
+    std::vector<double>& v = matrix;
+    std::vector<double> d(n), e(n);
+    // v[i][j] of JAMA is kept at [j][i], so its column loops run along rows and the eigenvectors end up in rows
+    auto at = [n](int i, int j) { return static_cast<size_t>(j) * n + i; };
+    for (int j = 0; j < n; j++) {
+        d[j] = v[at(n - 1, j)];
+    }
+    // householder reduction to tridiagonal form
+    for (int i = n - 1; i > 0; i--) {
+        double scale = 0.0, h = 0.0;
+        for (int k = 0; k < i; k++) {
+            scale += std::fabs(d[k]);
+        }
+        if (scale == 0.0) {
+            e[i] = d[i - 1];
+            for (int j = 0; j < i; j++) {
+                d[j] = v[at(i - 1, j)];
+                v[at(i, j)] = 0.0;
+                v[at(j, i)] = 0.0;
+            }
+        } else {
+            for (int k = 0; k < i; k++) {
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+            double f = d[i - 1];
+            double g = f > 0 ? -std::sqrt(h) : std::sqrt(h);
+            e[i] = scale * g;
+            h = h - f * g;
+            d[i - 1] = f - g;
+            std::fill(e.begin(), e.begin() + i, 0.0);
+            for (int j = 0; j < i; j++) {
+                f = d[j];
+                v[at(j, i)] = f;
+                g = e[j] + v[at(j, j)] * f;
+                for (int k = j + 1; k <= i - 1; k++) {
+                    g += v[at(k, j)] * d[k];
+                    e[k] += v[at(k, j)] * f;
+                }
+                e[j] = g;
+            }
+            f = 0.0;
+            for (int j = 0; j < i; j++) {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            double hh = f / (h + h);
+            for (int j = 0; j < i; j++) {
+                e[j] -= hh * d[j];
+            }
+            for (int j = 0; j < i; j++) {
+                f = d[j];
+                g = e[j];
+                for (int k = j; k <= i - 1; k++) {
+                    v[at(k, j)] -= (f * e[k] + g * d[k]);
+                }
+                d[j] = v[at(i - 1, j)];
+                v[at(i, j)] = 0.0;
+            }
+        }
+        d[i] = h;
+    }
+    // accumulate the transformations
+    for (int i = 0; i < n - 1; i++) {
+        v[at(n - 1, i)] = v[at(i, i)];
+        v[at(i, i)] = 1.0;
+        double h = d[i + 1];
+        if (h != 0.0) {
+            for (int k = 0; k <= i; k++) {
+                d[k] = v[at(k, i + 1)] / h;
+            }
+            for (int j = 0; j <= i; j++) {
+                double g = 0.0;
+                for (int k = 0; k <= i; k++) {
+                    g += v[at(k, i + 1)] * v[at(k, j)];
+                }
+                for (int k = 0; k <= i; k++) {
+                    v[at(k, j)] -= g * d[k];
+                }
+            }
+        }
+        for (int k = 0; k <= i; k++) {
+            v[at(k, i + 1)] = 0.0;
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        d[j] = v[at(n - 1, j)];
+        v[at(n - 1, j)] = 0.0;
+    }
+    v[at(n - 1, n - 1)] = 1.0;
+    e[0] = 0.0;
+    for (int i = 1; i < n; i++) {
+        e[i - 1] = e[i];
+    }
+    e[n - 1] = 0.0;
+    double f = 0.0, tst1 = 0.0;
+    const double eps = std::numeric_limits<double>::epsilon();
+    for (int l = 0; l < n; l++) {
+        tst1 = std::max(tst1, std::fabs(d[l]) + std::fabs(e[l]));
+        int m = l;
+        while (m < n - 1 && std::fabs(e[m]) > eps * tst1) {
+            m++;
+        }
+        if (m > l) {
+            do {
+                double g = d[l];
+                double p = (d[l + 1] - g) / (2.0 * e[l]);
+                double r = std::hypot(p, 1.0);
+                if (p < 0) {
+                    r = -r;
+                }
+                d[l] = e[l] / (p + r);
+                d[l + 1] = e[l] * (p + r);
+                double dl1 = d[l + 1];
+                double h = g - d[l];
+                for (int i = l + 2; i < n; i++) {
+                    d[i] -= h;
+                }
+                f += h;
+                p = d[m];
+                double c = 1.0, c2 = c, c3 = c;
+                double el1 = e[l + 1];
+                double s = 0.0, s2 = 0.0;
+                for (int i = m - 1; i >= l; i--) {
+                    c3 = c2;
+                    c2 = c;
+                    s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = std::hypot(p, e[i]);
+                    e[i + 1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i + 1] = h + s * (c * g + s * d[i]);
+                    double* row = v.data() + static_cast<size_t>(i) * n;
+                    double* next = row + n;
+                    for (int k = 0; k < n; k++) {
+                        h = next[k];
+                        next[k] = s * row[k] + c * h;
+                        row[k] = c * row[k] - s * h;
+                    }
+                }
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+            } while (std::fabs(e[l]) > eps * tst1);
+        }
+        d[l] = d[l] + f;
+        e[l] = 0.0;
+    }
+    values = d;
+}
+
+// parametric opq of Ge et al.: the principal axes of `data`, grouped so the products of the eigenvalues of the
+// `m` sub spaces of `sub_dim` axes are balanced
+static void opq_rotation(const VectorMatrix& data, int m, int sub_dim, VectorMatrix& rotation) {
+    const int dim = data.dim();
+    const size_t n = std::min<size_t>(data.size(), 4096);
+    std::vector<double> mean(dim, 0.0);
+    for (size_t i = 0; i < n; i++) {
+        for (int t = 0; t < dim; t++) {
+            mean[t] += data.row(i)[t];
+        }
+    }
+    // centered columns, so a covariance is a dot product of two rows
+    VectorMatrix columns(static_cast<int>(n));
+    columns.reserve(dim);
+    std::vector<float> column(n);
+    for (int t = 0; t < dim; t++) {
+        for (size_t i = 0; i < n; i++) {
+            column[i] = static_cast<float>(data.row(i)[t] - mean[t] / n);
+        }
+        columns.append(column.data(), 1);
+    }
+    std::vector<double> covariance(static_cast<size_t>(dim) * dim);
+    ThreadPool::shared().parallel_for(dim, [&](size_t i) {
+        for (size_t j = 0; j <= i; j++) {
+            double c = kernels().dot(columns.row(i), columns.row(j), columns.stride()) / n;
+            covariance[i * dim + j] = c;
+            covariance[j * dim + i] = c;
+        }
+    });
+    std::vector<double> values;
+    symmetric_eigen(covariance, dim, values);
+    std::vector<int> order(dim);
+    for (int i = 0; i < dim; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return values[a] > values[b]; });
+    // the largest eigenvalue left goes to the unfilled sub space of the smallest product
+    std::vector<double> log_products(m, 0.0);
+    std::vector<int> filled(m, 0), axes(dim);
+    for (int axis : order) {
+        int best = -1;
+        for (int j = 0; j < m; j++) {
+            int capacity = std::max(0, std::min(sub_dim, dim - j * sub_dim));
+            if (filled[j] < capacity && (best < 0 || log_products[j] < log_products[best])) {
+                best = j;
+            }
+        }
+        axes[best * sub_dim + filled[best]++] = axis;
+        log_products[best] += std::log(std::max(values[axis], 1e-12));
+    }
+    rotation.reset(dim);
+    rotation.reserve(dim);
+    std::vector<float> row(dim);
+    for (int position = 0; position < dim; position++) {
+        for (int t = 0; t < dim; t++) {
+            row[t] = static_cast<float>(covariance[static_cast<size_t>(axes[position]) * dim + t]);
+        }
+        rotation.append(row.data(), 1);
+    }
+}
+
+void ProductQuantizer::split(const float* vector, float* subs) const {
+    std::fill(subs + dim_, subs + static_cast<size_t>(m_) * sub_dim_, 0.f);
+    if (rotation_.empty()) {
+        ::memcpy(subs, vector, dim_ * sizeof(float));
+        return;
+    }
+    for (int r = 0; r < dim_; r++) {
+        subs[r] = kernels().dot(rotation_.row(r), vector, rotation_.stride());
+    }
+}
+
+void ProductQuantizer::train(const VectorMatrix& data, int m, bool rotate) {
+    const size_t n = data.size();
+    dim_ = data.dim();
+    m_ = n == 0 ? 0 : std::max(1, std::min(m, dim_));
+    if (m_ == 0) {
+        return;
+    }
+    sub_dim_ = (dim_ + m_ - 1) / m_;
+    rotation_.reset(dim_);
+    if (rotate) {
+        opq_rotation(data, m_, sub_dim_, rotation_);
+    }
+    const size_t size = static_cast<size_t>(m_) * sub_dim_;
+    std::vector<float> subs(n * size);
+    ThreadPool::shared().parallel_for(n, [&](size_t i) {
+        split(data.row(i), subs.data() + i * size);
+    });
+    codebooks_.assign(size * kCentroids, 0.f);
+    ThreadPool::shared().parallel_for(m_, [&](size_t j) {
+        VectorMatrix sub(sub_dim_);
+        sub.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            sub.append(subs.data() + i * size + j * sub_dim_, 1);
+        }
+        VectorMatrix centroids;
+        const int iterations = 10;
+        kmeans(sub, kCentroids, iterations, false, centroids);
+        float* columns = codebooks_.data() + j * sub_dim_ * kCentroids;
+        for (int c = 0; c < kCentroids; c++) {
+            // fewer rows than centroids repeat the last one
+            const float* centroid = centroids.row(std::min<size_t>(c, centroids.size() - 1));
+            for (int t = 0; t < sub_dim_; t++) {
+                columns[t * kCentroids + c] = centroid[t];
+            }
+        }
+    });
+}
+
+void ProductQuantizer::lookup_table(const float* query, bool inner_product, float* table) const {
+    const auto& kernel = kernels();
+    std::vector<float> subs(static_cast<size_t>(m_) * sub_dim_);
+    split(query, subs.data());
+    for (int j = 0; j < m_; j++) {
+        const float* sub = subs.data() + j * sub_dim_;
+        const float* columns = codebooks_.data() + j * sub_dim_ * kCentroids;
+        float* out = table + j * kCentroids;
+        if (inner_product) {
+            kernel.dot_columns(sub, columns, sub_dim_, kCentroids, out);
+            for (int c = 0; c < kCentroids; c++) {
+                out[c] = -out[c];
+            }
+        } else {
+            kernel.l2_columns(sub, columns, sub_dim_, kCentroids, out);
+        }
+    }
+}
+
+void ProductQuantizer::encode(const float* vector, uint8_t* code) const {
+    std::vector<float> table(static_cast<size_t>(m_) * kCentroids);
+    lookup_table(vector, false, table.data());
+    for (int j = 0; j < m_; j++) {
+        code[j] = static_cast<uint8_t>(kernels().argmin(table.data() + j * kCentroids, kCentroids));
+    }
+}
+
+void ProductQuantizer::put_code(const uint8_t* code, size_t index, std::vector<uint8_t>& codes) const {
+    codes.resize(std::max(codes.size(), code_size(index + 1)), 0);
+    uint8_t* block = codes.data() + index / kBlock * kBlock * m_;
+    for (int j = 0; j < m_; j++) {
+        block[j * kBlock + index % kBlock] = code[j];
+    }
+}
+
+void ProductQuantizer::block_distances(const float* table, const uint8_t* block, float* out) const {
+    kernels().adc(table, block, m_, out);
+}
+
+void ProductQuantizer::save(std::vector<char>& image) const {
+    int32_t header[3] = {m_, dim_, sub_dim_};
+    append_section(image, header, 3);
+    append_matrix(image, rotation_);
+    append_section(image, codebooks_.data(), codebooks_.size());
+}
+
+bool ProductQuantizer::load(const char* image, size_t size, size_t& offset) {
+    auto header = view_section<int32_t>(image, size, offset, 3);
+    if (header == nullptr || header[0] <= 0 || header[1] <= 0 || header[2] != (header[1] + header[0] - 1) / header[0]) {
+        return false;
+    }
+    m_ = header[0];
+    dim_ = header[1];
+    sub_dim_ = header[2];
+    if (!view_matrix(image, size, offset, rotation_) || rotation_.dim() != dim_ || (!rotation_.empty() && rotation_.size() != static_cast<size_t>(dim_))) {
+        return false;
+    }
+    const size_t count = static_cast<size_t>(m_) * sub_dim_ * kCentroids;
+    auto codebooks = view_section<float>(image, size, offset, count);
+    if (codebooks == nullptr) {
+        return false;
+    }
+    codebooks_.assign(codebooks, codebooks + count);
+    return true;
+}
+
+// pq codes of rows [begin, end) of `store`, `m` bytes each
+static std::vector<uint8_t> encode_rows(const ProductQuantizer& quantizer, const TextVectorStore& store, size_t begin, size_t end) {
+    std::vector<uint8_t> codes((end - begin) * quantizer.m());
+    ThreadPool::shared().parallel_for(end - begin, [&](size_t i) {
+        quantizer.encode(store.vectors().row(begin + i), codes.data() + i * quantizer.m());
+    });
+    return codes;
+}
+
+// push the `candidates` of codes to `top`, by their exact distances if `rerank`
+static void push_candidates(const TextVectorStore& store, const float* query, bool rerank, TopK& candidates, TopK& top) {
+    for (const auto& hit : candidates.sorted()) {
+        top.push(hit.id, rerank ? store.distance(query, store.vectors().row(hit.id)) : hit.distance);
+    }
+}
+// ProductQuantizer end
+
+std::unique_ptr<VectorIndex> VectorIndex::create(Type type) {
+    switch (type) {
+        case IVF:
+            return std::unique_ptr<VectorIndex>(new IvfIndex);
+        case HNSW:
+            return std::unique_ptr<VectorIndex>(new HnswIndex);
+        case PQ:
+            return std::unique_ptr<VectorIndex>(new PqIndex);
+        case IVF_PQ:
+            return std::unique_ptr<VectorIndex>(new IvfIndex(true));
+        case FP16:
+        case SQ8:
+        case BINARY:
+            return std::unique_ptr<VectorIndex>(new ScalarIndex(type));
+        default:
+            return nullptr;
+    }
+}
+
+// IvfIndex start
+void IvfIndex::build(const TextVectorStore& store) {
+    const size_t n = store.size();
+    lists_.clear();
+    codes_.clear();
+    centroids_.reset(store.vectors().dim());
+    if (n == 0) {
+        return;
+    }
+    int nlist = store.ivf_nlist_ > 0 ? store.ivf_nlist_ : static_cast<int>(4 * std::sqrt(n));
+    nlist = std::max(1, std::min<int>(nlist, n));
+    // train on at most 64 rows per list
+    VectorMatrix train;
+    sample_rows(store.vectors(), static_cast<size_t>(nlist) * 64, 4321, train);
+    const int iterations = 10;
+    kmeans(train, nlist, iterations, store.metric_ != TextVectorStore::L2, centroids_);
+    lists_.resize(centroids_.size());
+    if (pq_) {
+        // the codes are of the vectors, not of the residuals to the centroids, so one table serves all lists
+        sample_rows(store.vectors(), kPqTrainRows, 4321, train);
+        quantizer_.train(train, store.pq_m_ > 0 ? store.pq_m_ : std::max(1, train.dim() / 8), store.pq_opq_);
+        codes_.resize(lists_.size());
+    }
+    assign(store, 0, n);
+}
+
+void IvfIndex::add(const TextVectorStore& store, size_t begin, size_t end) {
+    if (centroids_.empty()) {
+        build(store);
+        return;
+    }
+    assign(store, begin, end);
+}
+
+void IvfIndex::assign(const TextVectorStore& store, size_t begin, size_t end) {
+    const bool inner_product = store.metric_ != TextVectorStore::L2;
+    std::vector<int> nearest(end - begin);
+    const size_t block = 256;
+    ThreadPool::shared().parallel_for((nearest.size() + block - 1) / block, [&](size_t b) {
+        for (size_t i = b * block; i < std::min(nearest.size(), (b + 1) * block); i++) {
+            nearest[i] = nearest_centroid(centroids_, store.vectors().row(begin + i), inner_product);
+        }
+    });
+    std::vector<uint8_t> codes;
+    if (pq_) {
+        codes = encode_rows(quantizer_, store, begin, end);
+    }
+    for (size_t i = 0; i < nearest.size(); i++) {
+        auto& list = lists_[nearest[i]];
+        if (pq_) {
+            quantizer_.put_code(codes.data() + i * quantizer_.m(), list.size(), codes_[nearest[i]]);
+        }
+        list.push_back(static_cast<uint32_t>(begin + i));
+    }
+}
+
+void IvfIndex::search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                      TopK& top) const {
+    if (centroids_.empty()) {
+        return;
+    }
+    size_t nprobe = std::max(1, params.nprobe > 0 ? params.nprobe : store.ivf_nprobe_);
+    // a filter keeping a fraction of the rows probes as many more lists, so about as many kept rows are scanned
+    if (filter != nullptr) {
+        nprobe = nprobe * store.size() / std::max<size_t>(filter->count(), 1);
+    }
+    nprobe = std::min(nprobe, centroids_.size());
+    std::vector<std::pair<float, int>> probes(centroids_.size());
+    for (size_t i = 0; i < centroids_.size(); i++) {
+        probes[i] = {store.distance(query, centroids_.row(i)), static_cast<int>(i)};
+    }
+    std::partial_sort(probes.begin(), probes.begin() + nprobe, probes.end());
+    if (pq_) {
+        std::vector<float> table(quantizer_.m() * ProductQuantizer::kCentroids);
+        quantizer_.lookup_table(query, store.metric_ != TextVectorStore::L2, table.data());
+        const int rerank = params.rerank > 0 ? params.rerank : store.rerank_;
+        TopK candidates(rerank > 0 ? std::max(rerank, top.k()) : top.k());
+        std::vector<TopK> tops(nprobe, TopK(candidates.k()));
+        ThreadPool::shared().parallel_for(nprobe, [&](size_t p) {
+            const auto& list = lists_[probes[p].second];
+            const auto& codes = codes_[probes[p].second];
+            const size_t block_size = ProductQuantizer::kBlock * quantizer_.m();
+            float distances[ProductQuantizer::kBlock];
+            for (size_t begin = 0; begin < list.size(); begin += ProductQuantizer::kBlock) {
+                const size_t rows = std::min(ProductQuantizer::kBlock, list.size() - begin);
+                // bits of the rows kept, a block without one is not scored
+                uint32_t kept = (1u << rows) - 1;
+                if (filter != nullptr) {
+                    kept = 0;
+                    for (size_t r = 0; r < rows; r++) {
+                        kept |= static_cast<uint32_t>(filter->test(list[begin + r])) << r;
+                    }
+                    if (kept == 0) {
+                        continue;
+                    }
+                }
+                quantizer_.block_distances(table.data(), codes.data() + begin / ProductQuantizer::kBlock * block_size, distances);
+                for (size_t r = 0; r < rows; r++) {
+                    if (kept >> r & 1) {
+                        tops[p].push(list[begin + r], distances[r]);
+                    }
+                }
+            }
+        });
+        for (const auto& probe_top : tops) {
+            candidates.merge(probe_top);
+        }
+        push_candidates(store, query, rerank > 0, candidates, top);
+        return;
+    }
+    std::vector<TopK> tops(nprobe, TopK(top.k()));
+    ThreadPool::shared().parallel_for(nprobe, [&](size_t p) {
+        for (uint32_t row : lists_[probes[p].second]) {
+            if (filter == nullptr || filter->test(row)) {
+                tops[p].push(row, store.distance(query, store.vectors().row(row)));
+            }
+        }
+    });
+    for (const auto& probe_top : tops) {
+        top.merge(probe_top);
+    }
+}
+
+void IvfIndex::save(std::vector<char>& image) const {
+    append_matrix(image, centroids_);
+    std::vector<uint32_t> sizes(lists_.size());
+    for (size_t i = 0; i < lists_.size(); i++) {
+        sizes[i] = static_cast<uint32_t>(lists_[i].size());
+    }
+    append_section(image, sizes.data(), sizes.size());
+    for (const auto& list : lists_) {
+        append_section(image, list.data(), list.size());
+    }
+    if (pq_) {
+        quantizer_.save(image);
+        for (size_t i = 0; i < lists_.size(); i++) {
+            append_section(image, codes_[i].data(), quantizer_.code_size(lists_[i].size()));
+        }
+    }
+}
+
+bool IvfIndex::load(const TextVectorStore& store, const char* image, size_t size) {
+    size_t offset = 0;
+    if (!view_matrix(image, size, offset, centroids_) || centroids_.dim() != store.vectors().dim()) {
+        return false;
+    }
+    auto sizes = view_section<uint32_t>(image, size, offset, centroids_.size());
+    if (sizes == nullptr) {
+        return false;
+    }
+    // every row is in one list, rows are read without checks while searching
+    lists_.resize(centroids_.size());
+    size_t rows = 0;
+    for (size_t i = 0; i < lists_.size(); i++) {
+        auto ids = view_section<uint32_t>(image, size, offset, sizes[i]);
+        if (ids == nullptr) {
+            return false;
+        }
+        for (uint32_t j = 0; j < sizes[i]; j++) {
+            if (ids[j] >= store.size()) {
+                return false;
+            }
+        }
+        lists_[i].assign(ids, ids + sizes[i]);
+        rows += sizes[i];
+    }
+    if (rows != store.size()) {
+        return false;
+    }
+    if (!pq_) {
+        return true;
+    }
+    if (!quantizer_.load(image, size, offset) || quantizer_.dim() != centroids_.dim()) {
+        return false;
+    }
+    codes_.resize(lists_.size());
+    for (size_t i = 0; i < lists_.size(); i++) {
+        const size_t code_size = quantizer_.code_size(sizes[i]);
+        auto codes = view_section<uint8_t>(image, size, offset, code_size);
+        if (codes == nullptr) {
+            return false;
+        }
+        codes_[i].assign(codes, codes + code_size);
+    }
+    return true;
+}
+// IvfIndex end
+
+// HnswIndex start
+static const int kHnswMaxLevel = 16;
+
+// random level of `node` with P(level >= l) = m^-l, hashed from the node so it does not depend on the insert order
+static int hnsw_level(uint32_t node, int m) {
+    uint64_t x = node + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    // uniform in (0, 1]
+    double u = ((x >> 11) + 1) * (1.0 / 9007199254740992.0);
+    return std::min(static_cast<int>(-std::log(u) / std::log(m)), kHnswMaxLevel);
+}
+
+// nodes visited by the current layer search of this thread, cleared by a new epoch
+struct VisitedSet {
+    std::vector<uint32_t> marks;
+    uint32_t epoch = 0;
+    void reset(size_t n) {
+        if (marks.size() < n) {
+            marks.resize(n, 0);
+        }
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+    }
+    // true at the first visit of `node`
+    bool visit(uint32_t node) {
+        if (marks[node] == epoch) {
+            return false;
+        }
+        marks[node] = epoch;
+        return true;
+    }
+};
+
+static VisitedSet& visited_set() {
+    thread_local VisitedSet visited;
+    return visited;
+}
+
+template <bool kLocked>
+void HnswIndex::neighbors(uint32_t node, int level, std::vector<uint32_t>& out) const {
+    std::unique_lock<std::mutex> guard(lock(node), std::defer_lock);
+    if (kLocked) {
+        guard.lock();
+    }
+    const uint32_t* list = links(node, level);
+    out.assign(list + 1, list + 1 + list[0]);
+}
+
+template <bool kLocked>
+HnswIndex::Candidate HnswIndex::greedy(const TextVectorStore& store, const float* query, Candidate entry, int level) const {
+    std::vector<uint32_t> adjacent;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        neighbors<kLocked>(entry.second, level, adjacent);
+        for (uint32_t node : adjacent) {
+            float distance = store.distance(query, store.vectors().row(node));
+            if (distance < entry.first) {
+                entry = {distance, node};
+                changed = true;
+            }
+        }
+    }
+    return entry;
+}
+
+template <bool kLocked>
+std::vector<HnswIndex::Candidate> HnswIndex::search_layer(const TextVectorStore& store, const float* query, Candidate entry, int ef, int level,
+                                                          const Bitset* filter) const {
+    auto& visited = visited_set();
+    visited.reset(levels_.size());
+    visited.visit(entry.second);
+    // nodes to expand, nearest first
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> frontier;
+    // the `ef` nearest nodes found, farthest first, only those kept by the filter
+    std::priority_queue<Candidate> nearest;
+    frontier.push(entry);
+    if (filter == nullptr || filter->test(entry.second)) {
+        nearest.push(entry);
+    }
+    std::vector<uint32_t> adjacent;
+    while (!frontier.empty()) {
+        Candidate current = frontier.top();
+        if (nearest.size() >= static_cast<size_t>(ef) && current.first > nearest.top().first) {
+            break;
+        }
+        frontier.pop();
+        neighbors<kLocked>(current.second, level, adjacent);
+        for (uint32_t node : adjacent) {
+            if (!visited.visit(node)) {
+                continue;
+            }
+            // nodes filtered out are walked through, but never returned
+            float distance = store.distance(query, store.vectors().row(node));
+            if (nearest.size() < static_cast<size_t>(ef) || distance < nearest.top().first) {
+                frontier.push({distance, node});
+                if (filter == nullptr || filter->test(node)) {
+                    nearest.push({distance, node});
+                }
+                if (nearest.size() > static_cast<size_t>(ef)) {
+                    nearest.pop();
+                }
+            }
+        }
+    }
+    std::vector<Candidate> result(nearest.size());
+    for (size_t i = result.size(); i-- > 0;) {
+        result[i] = nearest.top();
+        nearest.pop();
+    }
+    return result;
+}
+
+void HnswIndex::select_neighbors(const TextVectorStore& store, std::vector<Candidate>& candidates, int m) const {
+    if (candidates.size() <= static_cast<size_t>(m)) {
+        return;
+    }
+    // a candidate nearer to a kept neighbor than to the query is reached through that neighbor
+    std::vector<Candidate> kept;
+    kept.reserve(m);
+    for (const auto& candidate : candidates) {
+        const float* row = store.vectors().row(candidate.second);
+        bool diverse = std::none_of(kept.begin(), kept.end(), [&](const Candidate& other) {
+            return store.distance(row, store.vectors().row(other.second)) < candidate.first;
+        });
+        if (diverse) {
+            kept.push_back(candidate);
+            if (kept.size() == static_cast<size_t>(m)) {
+                break;
+            }
+        }
+    }
+    candidates.swap(kept);
+}
+
+void HnswIndex::insert(const TextVectorStore& store, uint32_t node) {
+    const int level = levels_[node];
+    // a node above the top layer becomes the entry, other inserts wait for it
+    std::unique_lock<std::mutex> entry_lock(entry_mutex_);
+    if (max_level_ < 0) {
+        entry_ = node;
+        max_level_ = level;
+        return;
+    }
+    const int max_level = max_level_;
+    const uint32_t entry = entry_;
+    if (level <= max_level) {
+        entry_lock.unlock();
+    }
+    const float* query = store.vectors().row(node);
+    Candidate nearest = {store.distance(query, store.vectors().row(entry)), entry};
+    for (int l = max_level; l > level; l--) {
+        nearest = greedy<true>(store, query, nearest, l);
+    }
+    for (int l = std::min(level, max_level); l >= 0; l--) {
+        auto candidates = search_layer<true>(store, query, nearest, ef_construction_, l);
+        // a concurrent insert may have linked this node already
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const Candidate& c) { return c.second == node; }), candidates.end());
+        if (candidates.empty()) {
+            continue;
+        }
+        nearest = candidates.front();
+        select_neighbors(store, candidates, m_);
+        {
+            std::lock_guard<std::mutex> guard(lock(node));
+            uint32_t* own = links(node, l);
+            own[0] = static_cast<uint32_t>(candidates.size());
+            for (size_t i = 0; i < candidates.size(); i++) {
+                own[i + 1] = candidates[i].second;
+            }
+        }
+        const uint32_t max_links = l == 0 ? 2 * m_ : m_;
+        for (const auto& candidate : candidates) {
+            std::lock_guard<std::mutex> guard(lock(candidate.second));
+            uint32_t* other = links(candidate.second, l);
+            if (other[0] < max_links) {
+                other[++other[0]] = node;
+                continue;
+            }
+            // a full list is pruned again with the new node
+            const float* row = store.vectors().row(candidate.second);
+            std::vector<Candidate> pruned = {{candidate.first, node}};
+            for (uint32_t i = 1; i <= other[0]; i++) {
+                pruned.push_back({store.distance(row, store.vectors().row(other[i])), other[i]});
+            }
+            std::sort(pruned.begin(), pruned.end());
+            select_neighbors(store, pruned, max_links);
+            other[0] = static_cast<uint32_t>(pruned.size());
+            for (size_t i = 0; i < pruned.size(); i++) {
+                other[i + 1] = pruned[i].second;
+            }
+        }
+    }
+    if (level > max_level) {
+        entry_ = node;
+        max_level_ = level;
+    }
+}
+
+void HnswIndex::build(const TextVectorStore& store) {
+    m_ = std::max(2, store.hnsw_m_);
+    ef_construction_ = std::max(m_, store.hnsw_ef_construction_);
+    levels_.clear();
+    links0_.clear();
+    upper_links_.clear();
+    max_level_ = -1;
+    add(store, 0, store.size());
+}
+
+void HnswIndex::add(const TextVectorStore& store, size_t begin, size_t end) {
+    if (levels_.size() != begin) {
+        build(store);
+        return;
+    }
+    // links are allocated before the inserts, so the lists do not move while they run
+    levels_.resize(end);
+    links0_.resize(end * (2 * m_ + 1), 0);
+    upper_links_.resize(end);
+    for (size_t i = begin; i < end; i++) {
+        levels_[i] = static_cast<uint8_t>(hnsw_level(static_cast<uint32_t>(i), m_));
+        upper_links_[i].assign(levels_[i] * (m_ + 1), 0);
+    }
+    ThreadPool::shared().parallel_for(end - begin, [&](size_t i) {
+        insert(store, static_cast<uint32_t>(begin + i));
+    });
+}
+
+void HnswIndex::search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                       TopK& top) const {
+    if (max_level_ < 0) {
+        return;
+    }
+    int ef = params.ef > 0 ? params.ef : store.hnsw_ef_search_;
+    ef = std::max(ef, top.k());
+    // a filter keeping fewer rows than a search visits is scanned, which is exact and faster,
+    // and a walk through a graph mostly filtered out could miss the rows kept
+    if (filter != nullptr && filter->count() <= static_cast<size_t>(ef) * 2 * m_) {
+        store.scan(query, 0, levels_.size(), top, filter);
+        return;
+    }
+    Candidate nearest = {store.distance(query, store.vectors().row(entry_)), entry_};
+    for (int l = max_level_; l > 0; l--) {
+        nearest = greedy<false>(store, query, nearest, l);
+    }
+    for (const auto& candidate : search_layer<false>(store, query, nearest, ef, 0, filter)) {
+        top.push(candidate.second, candidate.first);
+    }
+}
+
+void HnswIndex::save(std::vector<char>& image) const {
+    int32_t header[5] = {m_, ef_construction_, max_level_, static_cast<int32_t>(entry_), static_cast<int32_t>(levels_.size())};
+    append_section(image, header, 5);
+    append_section(image, levels_.data(), levels_.size());
+    append_section(image, links0_.data(), links0_.size());
+    std::vector<uint32_t> upper_links;
+    for (const auto& links : upper_links_) {
+        upper_links.insert(upper_links.end(), links.begin(), links.end());
+    }
+    append_section(image, upper_links.data(), upper_links.size());
+}
+
+bool HnswIndex::load(const TextVectorStore& store, const char* image, size_t size) {
+    size_t offset = 0;
+    auto header = view_section<int32_t>(image, size, offset, 5);
+    if (header == nullptr || header[0] < 2 || header[2] > kHnswMaxLevel || header[4] < 0 || (header[4] > 0) != (header[2] >= 0)) {
+        return false;
+    }
+    m_ = header[0];
+    ef_construction_ = header[1];
+    max_level_ = header[2];
+    entry_ = header[3];
+    const size_t n = header[4];
+    if (n != store.size() || (n > 0 && entry_ >= n)) {
+        return false;
+    }
+    auto levels = view_section<uint8_t>(image, size, offset, n);
+    auto links0 = view_section<uint32_t>(image, size, offset, n * (2 * m_ + 1));
+    if (levels == nullptr || links0 == nullptr) {
+        return false;
+    }
+    levels_.assign(levels, levels + n);
+    links0_.assign(links0, links0 + n * (2 * m_ + 1));
+    size_t upper_size = 0;
+    for (uint8_t level : levels_) {
+        upper_size += level * (m_ + 1);
+    }
+    auto upper = view_section<uint32_t>(image, size, offset, upper_size);
+    if (upper == nullptr) {
+        return false;
+    }
+    upper_links_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        upper_links_[i].assign(upper, upper + levels_[i] * (m_ + 1));
+        upper += levels_[i] * (m_ + 1);
+    }
+    // links are followed without checks while searching
+    for (uint32_t node = 0; node < n; node++) {
+        if (levels_[node] > max_level_) {
+            return false;
+        }
+        for (int l = 0; l <= levels_[node]; l++) {
+            const uint32_t* list = links(node, l);
+            if (list[0] > static_cast<uint32_t>(l == 0 ? 2 * m_ : m_)) {
+                return false;
+            }
+            for (uint32_t i = 1; i <= list[0]; i++) {
+                if (list[i] >= n || levels_[list[i]] < l) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+// HnswIndex end
+
+// PqIndex start
+void PqIndex::build(const TextVectorStore& store) {
+    VectorMatrix train;
+    sample_rows(store.vectors(), kPqTrainRows, 4321, train);
+    quantizer_.train(train, store.pq_m_ > 0 ? store.pq_m_ : std::max(1, train.dim() / 8), store.pq_opq_);
+    codes_.clear();
+    size_ = 0;
+    if (quantizer_.trained()) {
+        add(store, 0, store.size());
+    }
+}
+
+void PqIndex::add(const TextVectorStore& store, size_t begin, size_t end) {
+    if (!quantizer_.trained() || size_ != begin) {
+        build(store);
+        return;
+    }
+    auto codes = encode_rows(quantizer_, store, begin, end);
+    for (size_t i = begin; i < end; i++) {
+        quantizer_.put_code(codes.data() + (i - begin) * quantizer_.m(), i, codes_);
+    }
+    size_ = end;
+}
+
+void PqIndex::search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                     TopK& top) const {
+    if (size_ == 0) {
+        return;
+    }
+    std::vector<float> table(quantizer_.m() * ProductQuantizer::kCentroids);
+    quantizer_.lookup_table(query, store.metric_ != TextVectorStore::L2, table.data());
+    const int rerank = params.rerank > 0 ? params.rerank : store.rerank_;
+    TopK candidates(rerank > 0 ? std::max(rerank, top.k()) : top.k());
+    const size_t block = ProductQuantizer::kBlock;
+    const size_t blocks = (size_ + block - 1) / block;
+    // slices of 4096 rows, as the flat scan
+    const size_t min_slice = 4096 / block;
+    size_t slices = std::min<size_t>(ThreadPool::shared().thread_num(), (blocks + min_slice - 1) / min_slice);
+    slices = std::max<size_t>(slices, 1);
+    std::vector<TopK> tops(slices, TopK(candidates.k()));
+    ThreadPool::shared().parallel_for(slices, [&](size_t s) {
+        float distances[ProductQuantizer::kBlock];
+        for (size_t b = blocks * s / slices; b < blocks * (s + 1) / slices; b++) {
+            // bits of the rows kept, a block without one is not scored
+            const size_t rows = std::min(block, size_ - b * block);
+            uint32_t kept = filter ? filter->bits16(b * block) : (1u << rows) - 1;
+            if (kept == 0) {
+                continue;
+            }
+            quantizer_.block_distances(table.data(), codes_.data() + b * block * quantizer_.m(), distances);
+            for (size_t r = 0; r < rows; r++) {
+                if (kept >> r & 1) {
+                    tops[s].push(b * block + r, distances[r]);
+                }
+            }
+        }
+    });
+    for (const auto& slice_top : tops) {
+        candidates.merge(slice_top);
+    }
+    push_candidates(store, query, rerank > 0, candidates, top);
+}
+
+void PqIndex::save(std::vector<char>& image) const {
+    quantizer_.save(image);
+    uint64_t size = size_;
+    append_section(image, &size, 1);
+    append_section(image, codes_.data(), codes_.size());
+}
+
+bool PqIndex::load(const TextVectorStore& store, const char* image, size_t size) {
+    size_t offset = 0;
+    if (!quantizer_.load(image, size, offset) || quantizer_.dim() != store.vectors().dim()) {
+        return false;
+    }
+    auto rows = view_section<uint64_t>(image, size, offset, 1);
+    if (rows == nullptr || *rows != store.size()) {
+        return false;
+    }
+    size_ = *rows;
+    auto codes = view_section<uint8_t>(image, size, offset, quantizer_.code_size(size_));
+    if (codes == nullptr) {
+        return false;
+    }
+    codes_.assign(codes, codes + quantizer_.code_size(size_));
+    return true;
+}
+// PqIndex end
+
+// ScalarIndex start
+size_t ScalarIndex::code_size() const {
+    size_t bytes = 0;
+    switch (type_) {
+        case FP16:
+            bytes = stride_ * sizeof(uint16_t);
+            break;
+        case SQ8:
+            bytes = stride_;
+            break;
+        default:
+            bytes = (stride_ + 63) / 64 * sizeof(uint64_t);
+            break;
+    }
+    return (bytes + 63) / 64 * 64;
+}
+
+void ScalarIndex::encode(const float* vector, uint8_t* code) const {
+    if (type_ == FP16) {
+        auto halves = reinterpret_cast<uint16_t*>(code);
+        for (size_t i = 0; i < stride_; i++) {
+            halves[i] = float_to_half(vector[i]);
+        }
+    } else if (type_ == SQ8) {
+        for (size_t i = 0; i < stride_; i++) {
+            float step = steps_[i] > 0.f ? std::round((vector[i] - offsets_[i]) / steps_[i]) : 0.f;
+            code[i] = static_cast<uint8_t>(std::min(std::max(step, 0.f), 255.f));
+        }
+    } else {
+        std::vector<uint64_t> words(code_size() / sizeof(uint64_t), 0);
+        for (size_t i = 0; i < stride_; i++) {
+            words[i / 64] |= static_cast<uint64_t>(vector[i] > offsets_[i]) << (i % 64);
+        }
+        ::memcpy(code, words.data(), code_size());
+    }
+}
+
+void ScalarIndex::build(const TextVectorStore& store) {
+    const size_t n = store.size();
+    const auto& vectors = store.vectors();
+    codes_.clear();
+    norms_.clear();
+    size_ = 0;
+    // an empty store is built again by the first add
+    stride_ = n == 0 ? 0 : vectors.stride();
+    offsets_.assign(stride_, 0.f);
+    steps_.assign(stride_, 0.f);
+    if (n == 0) {
+        return;
+    }
+    if (type_ == SQ8) {
+        std::vector<float> maxs(vectors.row(0), vectors.row(0) + stride_);
+        offsets_.assign(vectors.row(0), vectors.row(0) + stride_);
+        for (size_t i = 1; i < n; i++) {
+            const float* row = vectors.row(i);
+            for (size_t j = 0; j < stride_; j++) {
+                offsets_[j] = std::min(offsets_[j], row[j]);
+                maxs[j] = std::max(maxs[j], row[j]);
+            }
+        }
+        for (size_t j = 0; j < stride_; j++) {
+            steps_[j] = (maxs[j] - offsets_[j]) / 255.f;
+        }
+    } else if (type_ == BINARY) {
+        VectorMatrix sample;
+        sample_rows(vectors, kPqTrainRows, 4321, sample);
+        for (size_t i = 0; i < sample.size(); i++) {
+            for (size_t j = 0; j < stride_; j++) {
+                offsets_[j] += sample.row(i)[j];
+            }
+        }
+        for (auto& offset : offsets_) {
+            offset /= sample.size();
+        }
+    }
+    add(store, 0, n);
+}
+
+void ScalarIndex::add(const TextVectorStore& store, size_t begin, size_t end) {
+    if (stride_ == 0 || stride_ != store.vectors().stride() || size_ != begin) {
+        build(store);
+        return;
+    }
+    const size_t bytes = code_size();
+    codes_.resize(end * bytes);
+    if (type_ == SQ8) {
+        norms_.resize(end);
+    }
+    const size_t block = 256;
+    ThreadPool::shared().parallel_for((end - begin + block - 1) / block, [&](size_t b) {
+        for (size_t i = begin + b * block; i < std::min(end, begin + (b + 1) * block); i++) {
+            uint8_t* code = codes_.data() + i * bytes;
+            encode(store.vectors().row(i), code);
+            if (type_ == SQ8) {
+                float norm = 0.f;
+                for (size_t j = 0; j < stride_; j++) {
+                    float value = offsets_[j] + steps_[j] * code[j];
+                    norm += value * value;
+                }
+                norms_[i] = norm;
+            }
+        }
+    });
+    size_ = end;
+}
+
+void ScalarIndex::search(const TextVectorStore& store, const float* query, const SearchParams& params, const Bitset* filter,
+                         TopK& top) const {
+    if (size_ == 0) {
+        return;
+    }
+    const auto& kernel = kernels();
+    const bool inner_product = store.metric_ != TextVectorStore::L2;
+    const size_t bytes = code_size();
+    // SQ8: q . x = bias + scale * (quantized q * step) . code
+    std::vector<int8_t> quantized;
+    float bias = 0.f, scale = 0.f, query_norm = 0.f;
+    std::vector<uint8_t> query_code;
+    if (type_ == SQ8) {
+        std::vector<float> weights(stride_);
+        float max_weight = 0.f;
+        for (size_t j = 0; j < stride_; j++) {
+            weights[j] = query[j] * steps_[j];
+            max_weight = std::max(max_weight, std::fabs(weights[j]));
+            bias += query[j] * offsets_[j];
+            query_norm += query[j] * query[j];
+        }
+        scale = max_weight / 127.f;
+        quantized.resize(stride_);
+        for (size_t j = 0; j < stride_; j++) {
+            quantized[j] = scale > 0.f ? static_cast<int8_t>(std::round(weights[j] / scale)) : 0;
+        }
+    } else if (type_ == BINARY) {
+        query_code.resize(bytes);
+        encode(query, query_code.data());
+    }
+    auto distance = [&](size_t i) {
+        const uint8_t* code = codes_.data() + i * bytes;
+        switch (type_) {
+            case FP16: {
+                auto halves = reinterpret_cast<const uint16_t*>(code);
+                return inner_product ? -kernel.dot_f16(halves, query, stride_) : kernel.l2_f16(halves, query, stride_);
+            }
+            case SQ8: {
+                float dot = bias + scale * kernel.dot_u8s8(code, quantized.data(), stride_);
+                return inner_product ? -dot : norms_[i] - 2.f * dot + query_norm;
+            }
+            default:
+                return static_cast<float>(kernel.hamming(reinterpret_cast<const uint64_t*>(code),
+                                                         reinterpret_cast<const uint64_t*>(query_code.data()), bytes / sizeof(uint64_t)));
+        }
+    };
+    const int rerank = params.rerank > 0 ? params.rerank : store.rerank_;
+    TopK candidates(rerank > 0 ? std::max(rerank, top.k()) : top.k());
+    // slices of 4096 rows, as the flat scan
+    const size_t min_slice = 4096;
+    size_t slices = std::min<size_t>(ThreadPool::shared().thread_num(), (size_ + min_slice - 1) / min_slice);
+    slices = std::max<size_t>(slices, 1);
+    std::vector<TopK> tops(slices, TopK(candidates.k()));
+    ThreadPool::shared().parallel_for(slices, [&](size_t s) {
+        const size_t begin = size_ * s / slices, end = size_ * (s + 1) / slices;
+        if (filter != nullptr) {
+            for (size_t i = filter->next(begin); i < end; i = filter->next(i + 1)) {
+                tops[s].push(i, distance(i));
+            }
+            return;
+        }
+        for (size_t i = begin; i < end; i++) {
+            tops[s].push(i, distance(i));
+        }
+    });
+    for (const auto& slice_top : tops) {
+        candidates.merge(slice_top);
+    }
+    push_candidates(store, query, rerank > 0, candidates, top);
+}
+
+void ScalarIndex::save(std::vector<char>& image) const {
+    uint64_t header[2] = {stride_, size_};
+    append_section(image, header, 2);
+    append_section(image, offsets_.data(), offsets_.size());
+    append_section(image, steps_.data(), steps_.size());
+    append_section(image, codes_.data(), codes_.size());
+    append_section(image, norms_.data(), norms_.size());
+}
+
+bool ScalarIndex::load(const TextVectorStore& store, const char* image, size_t size) {
+    size_t offset = 0;
+    auto header = view_section<uint64_t>(image, size, offset, 2);
+    // an index of no rows has no stride
+    if (header == nullptr || header[1] != store.size() || header[0] != (header[1] == 0 ? 0 : store.vectors().stride())) {
+        return false;
+    }
+    stride_ = header[0];
+    size_ = header[1];
+    const size_t norms = type_ == SQ8 ? size_ : 0;
+    if (size_ > size / std::max<size_t>(code_size(), 1)) {
+        return false;
+    }
+    auto offsets = view_section<float>(image, size, offset, stride_);
+    auto steps = view_section<float>(image, size, offset, stride_);
+    auto codes = view_section<uint8_t>(image, size, offset, size_ * code_size());
+    auto norm_values = view_section<float>(image, size, offset, norms);
+    if (offsets == nullptr || steps == nullptr || codes == nullptr || norm_values == nullptr) {
+        return false;
+    }
+    offsets_.assign(offsets, offsets + stride_);
+    steps_.assign(steps, steps + stride_);
+    codes_.assign(codes, codes + size_ * code_size());
+    norms_.assign(norm_values, norm_values + norms);
+    return true;
+}
+// ScalarIndex end
+
+// TextVectorStore strat
+// store file, arrays are in host byte order: the header, the rows of the vectors at a 64 byte aligned offset,
+// uint64 offsets[count + 1] of the texts in the blob, the blob, the int32 type and the image of the index,
+// the metadata columns, int64 ids[count] unless every id is its row, and the live words if rows are deleted
+static const char kStoreMagic[4] = {'M', 'V', 'S', 'T'};
+// version 2 adds the metadata section, version 3 the ids and the deleted rows
+static const uint32_t kStoreVersion = 3;
+
+struct StoreHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t metric;
+    int32_t dim;
+    uint64_t count;
+    uint64_t vectors_offset;
+    uint64_t offsets_offset;
+    uint64_t blob_offset;
+    uint64_t blob_size;
+    // 0 size without index
+    uint64_t index_offset;
+    uint64_t index_size;
+    // 0 size without columns
+    uint64_t metadata_offset;
+    uint64_t metadata_size;
+    // id of the next row
+    int64_t next_id;
+    // 0 size if the ids are the rows
+    uint64_t ids_offset;
+    uint64_t ids_size;
+    // 0 size without deleted rows
+    uint64_t live_offset;
+    uint64_t live_size;
+};
+
+// zeros up to `offset` of the file
+static void write_padding(std::ofstream& file, uint64_t offset) {
+    static const char zeros[VectorMatrix::kAlign] = {};
+    file.write(zeros, offset - static_cast<uint64_t>(file.tellp()));
+}
+
+TextVectorStore* TextVectorStore::load(const std::string& path) {
+    StoreHeader header;
+    bool mapped = false;
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.good()) {
+            std::cerr << "Error: can't open vector store file " << path << std::endl;
+            return nullptr;
+        }
+        mapped = file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+                 !::memcmp(header.magic, kStoreMagic, sizeof(kStoreMagic));
+    }
+    std::unique_ptr<TextVectorStore> store(new TextVectorStore);
+    if (!mapped) {
+        return store->load_legacy(path) ? store.release() : nullptr;
+    }
+    if (header.version == 0 || header.version > kStoreVersion) {
+        std::cerr << "Error: vector store version " << header.version << " of " << path << " is not " << kStoreVersion << std::endl;
+        return nullptr;
+    }
+    bool valid = false;
+    store->mapped_.reset(new MappedFile(path));
+    if (store->mapped_->valid()) {
+        valid = store->map_image(store->mapped_->data(), store->mapped_->size(), true);
+    } else {
+        // no mmap, copy the file instead
+        store->mapped_.reset();
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        valid = store->map_image(image.data(), image.size(), false);
+    }
+    if (!valid) {
+        std::cerr << "Error: invalid vector store file " << path << std::endl;
+        return nullptr;
+    }
+    return store.release();
+}
+
+bool TextVectorStore::map_image(const char* image, size_t size, bool borrow) {
+    size_t offset = 0;
+    auto view = view_section<StoreHeader>(image, size, offset, 1);
+    if (view == nullptr) {
+        return false;
+    }
+    StoreHeader header_copy = *view;
+    auto header = &header_copy;
+    if (header->version < 2) {
+        header->metadata_offset = 0;
+        header->metadata_size = 0;
+    }
+    if (header->version < 3) {
+        header->next_id = header->count;
+        header->ids_offset = header->ids_size = 0;
+        header->live_offset = header->live_size = 0;
+    }
+    if (header->dim < 0 || header->metric < L2 || header->metric > COSINE || header->blob_size > size ||
+        header->index_size > size || header->metadata_size > size || header->vectors_offset % VectorMatrix::kAlign ||
+        header->next_id < 0) {
+        return false;
+    }
+    const size_t count = header->count;
+    const size_t stride = (static_cast<size_t>(header->dim) + 15) / 16 * 16;
+    // bounds the sizes of the sections before they are computed
+    if (count >= size / sizeof(uint64_t) || (count > 0 && (stride == 0 || count > size / (stride * sizeof(float))))) {
+        return false;
+    }
+    size_t vectors_offset = header->vectors_offset, offsets_offset = header->offsets_offset;
+    size_t blob_offset = header->blob_offset, index_offset = header->index_offset;
+    auto vectors = view_section<float>(image, size, vectors_offset, count * stride);
+    auto offsets = view_section<uint64_t>(image, size, offsets_offset, count + 1);
+    auto blob = view_section<char>(image, size, blob_offset, header->blob_size);
+    size_t metadata_offset = header->metadata_offset;
+    auto index = view_section<char>(image, size, index_offset, header->index_size);
+    auto metadata = view_section<char>(image, size, metadata_offset, header->metadata_size);
+    size_t ids_offset = header->ids_offset, live_offset = header->live_offset;
+    const size_t live_words = (count + 63) / 64;
+    auto ids = view_section<int64_t>(image, size, ids_offset, header->ids_size > 0 ? count : 0);
+    auto live = view_section<uint64_t>(image, size, live_offset, header->live_size > 0 ? live_words : 0);
+    if (vectors == nullptr || offsets == nullptr || blob == nullptr || index == nullptr || metadata == nullptr ||
+        ids == nullptr || live == nullptr || offsets[count] != header->blob_size ||
+        (header->ids_size > 0 && header->ids_size != count * sizeof(int64_t)) ||
+        (header->live_size > 0 && header->live_size != live_words * sizeof(uint64_t))) {
+        return false;
+    }
+    metric_ = static_cast<Metric>(header->metric);
+    dim_ = header->dim;
+    // rows are borrowed in place, so the image has to be aligned as the file
+    if (borrow && reinterpret_cast<uintptr_t>(vectors) % VectorMatrix::kAlign == 0) {
+        vectors_.view(vectors, count, dim_);
+        text_offsets_ = offsets;
+        text_blob_ = blob;
+        text_blob_size_ = header->blob_size;
+        mapped_texts_ = count;
+    } else {
+        vectors_.reset(dim_);
+        vectors_.reserve(count);
+        texts_.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > header->blob_size) {
+                return false;
+            }
+            vectors_.append(vectors + i * stride, 1);
+            texts_.emplace_back(blob + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+    }
+    live_.resize(count, true);
+    deleted_ = 0;
+    if (header->live_size > 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (!(live[i >> 6] >> (i & 63) & 1)) {
+                live_.reset(i);
+                deleted_++;
+            }
+        }
+    }
+    next_id_ = header->next_id;
+    ids_.clear();
+    rows_.clear();
+    if (header->ids_size > 0) {
+        ids_.assign(ids, ids + count);
+        rows_.reserve(count - deleted_);
+        for (size_t i = 0; i < count; i++) {
+            if (ids_[i] < 0 || ids_[i] >= next_id_) {
+                return false;
+            }
+            if (live_.test(i)) {
+                rows_[ids_[i]] = i;
+            }
+        }
+    }
+    if (header->metadata_size > 0 && !load_metadata(metadata, header->metadata_size)) {
+        return false;
+    }
+    if (header->index_size > 0) {
+        load_index(index, header->index_size);
+    }
+    return true;
+}
+
+bool TextVectorStore::load_legacy(const std::string& path) {
+    auto vars = Variable::load(path.c_str());
+    if (vars.size() < 2) {
+        return false;
+    }
+    std::vector<std::string> texts;
+    for (size_t i = 1; i < vars.size(); i++) {
+        const char* txt = vars[i]->readMap<char>();
+        texts.emplace_back(txt, vars[i]->getInfo()->size);
+    }
+    int num = static_cast<int>(texts.size());
+    dim_ = num > 0 ? vars[0]->getInfo()->size / num : 0;
+    vectors_.reset(dim_);
+    vectors_.reserve(num);
+    append(vars[0]->readMap<float>(), texts.data(), num);
+    return true;
+}
+
+void TextVectorStore::load_index(const char* image, size_t size) {
+    size_t offset = 0;
+    auto type = view_section<int32_t>(image, size, offset, 1);
+    index_ = type ? VectorIndex::create(static_cast<VectorIndex::Type>(*type)) : nullptr;
+    if (index_ == nullptr || !index_->load(*this, image + offset, size - offset)) {
+        std::cerr << "Error: invalid vector index of the store, it is rebuilt" << std::endl;
+        build_index(type ? static_cast<VectorIndex::Type>(*type) : VectorIndex::FLAT);
+    }
+}
+
+void TextVectorStore::save(const std::string& path) {
+    auto lock = read_lock();
+    std::vector<char> index_image;
+    if (index_ != nullptr) {
+        int32_t type = index_->type();
+        append_section(index_image, &type, 1);
+        index_->save(index_image);
+    }
+    const size_t count = vectors_.size();
+    std::vector<uint64_t> offsets(1, 0);
+    offsets.reserve(count + 1);
+    for (size_t i = 0; i < count; i++) {
+        offsets.push_back(offsets.back() + row_text(i).size());
+    }
+    auto align = [](uint64_t offset, uint64_t alignment) { return (offset + alignment - 1) / alignment * alignment; };
+    StoreHeader header;
+    ::memset(&header, 0, sizeof(header));
+    ::memcpy(header.magic, kStoreMagic, sizeof(kStoreMagic));
+    header.version = kStoreVersion;
+    header.metric = metric_;
+    header.dim = dim_;
+    header.count = count;
+    header.vectors_offset = align(sizeof(header), VectorMatrix::kAlign);
+    header.offsets_offset = align(header.vectors_offset + count * vectors_.stride() * sizeof(float), 8);
+    header.blob_offset = align(header.offsets_offset + offsets.size() * sizeof(uint64_t), 8);
+    header.blob_size = offsets.back();
+    header.index_offset = align(header.blob_offset + header.blob_size, 8);
+    header.index_size = index_image.size();
+    std::vector<char> metadata_image;
+    save_metadata(metadata_image);
+    header.metadata_offset = header.index_offset + index_image.size();
+    header.metadata_size = metadata_image.size();
+    header.next_id = next_id_;
+    header.ids_offset = header.metadata_offset + header.metadata_size;
+    header.ids_size = ids_.size() * sizeof(int64_t);
+    header.live_offset = header.ids_offset + header.ids_size;
+    header.live_size = deleted_ > 0 ? live_.words().size() * sizeof(uint64_t) : 0;
+    // the file may be mapped by a loaded store, so it is replaced rather than rewritten
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_padding(file, header.vectors_offset);
+        if (count > 0) {
+            file.write(reinterpret_cast<const char*>(vectors_.row(0)), count * vectors_.stride() * sizeof(float));
+        }
+        write_padding(file, header.offsets_offset);
+        file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        for (size_t i = 0; i < count; i++) {
+            auto str = row_text(i);
+            file.write(str.data(), str.size());
+        }
+        write_padding(file, header.index_offset);
+        file.write(index_image.data(), index_image.size());
+        file.write(metadata_image.data(), metadata_image.size());
+        file.write(reinterpret_cast<const char*>(ids_.data()), header.ids_size);
+        if (header.live_size > 0) {
+            file.write(reinterpret_cast<const char*>(live_.words().data()), header.live_size);
+        }
+        if (!file.good()) {
+            std::cerr << "Error: can't write vector store file " << temp << std::endl;
+            return;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        // windows does not rename over an existing file
+        std::remove(path.c_str());
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::cerr << "Error: can't replace vector store file " << path << std::endl;
+        }
+    }
+}
+
+// metadata: uint64 columns, then per column int32 type and name size, the name, uint64 rows, the valid words,
+// int64 values[rows], and for strings uint64 entries, uint64 offsets[entries + 1] and the blob of the dictionary
+void TextVectorStore::save_metadata(std::vector<char>& image) const {
+    if (columns_.empty()) {
+        return;
+    }
+    uint64_t columns = columns_.size();
+    append_section(image, &columns, 1);
+    for (const auto& item : columns_) {
+        const auto& column = item.second;
+        int32_t header[2] = {column.type, static_cast<int32_t>(item.first.size())};
+        append_section(image, header, 2);
+        append_section(image, item.first.data(), item.first.size());
+        uint64_t rows = column.values.size();
+        append_section(image, &rows, 1);
+        append_section(image, column.valid.words().data(), column.valid.words().size());
+        append_section(image, column.values.data(), column.values.size());
+        if (column.type == MetadataColumn::STRING) {
+            uint64_t entries = column.dictionary.size();
+            std::vector<uint64_t> offsets(1, 0);
+            std::string blob;
+            for (const auto& value : column.dictionary) {
+                blob += value;
+                offsets.push_back(blob.size());
+            }
+            append_section(image, &entries, 1);
+            append_section(image, offsets.data(), offsets.size());
+            append_section(image, blob.data(), blob.size());
+        }
+    }
+}
+
+bool TextVectorStore::load_metadata(const char* image, size_t size) {
+    size_t offset = 0;
+    auto columns = view_section<uint64_t>(image, size, offset, 1);
+    if (columns == nullptr) {
+        return false;
+    }
+    for (uint64_t c = 0; c < *columns; c++) {
+        auto header = view_section<int32_t>(image, size, offset, 2);
+        if (header == nullptr || header[0] < MetadataColumn::INT || header[0] > MetadataColumn::STRING || header[1] < 0) {
+            return false;
+        }
+        auto name = view_section<char>(image, size, offset, header[1]);
+        auto rows = name ? view_section<uint64_t>(image, size, offset, 1) : nullptr;
+        if (rows == nullptr || *rows > vectors_.size()) {
+            return false;
+        }
+        auto words = view_section<uint64_t>(image, size, offset, (*rows + 63) / 64);
+        auto values = words ? view_section<int64_t>(image, size, offset, *rows) : nullptr;
+        if (values == nullptr) {
+            return false;
+        }
+        auto& column = columns_[std::string(name, header[1])];
+        column.type = static_cast<MetadataColumn::Type>(header[0]);
+        column.valid = Bitset(*rows);
+        for (size_t i = 0; i < *rows; i++) {
+            if (words[i / 64] >> (i % 64) & 1) {
+                column.valid.set(i);
+            }
+        }
+        column.values.assign(values, values + *rows);
+        if (column.type == MetadataColumn::STRING) {
+            auto entries = view_section<uint64_t>(image, size, offset, 1);
+            if (entries == nullptr || *entries > size / sizeof(uint64_t)) {
+                return false;
+            }
+            auto offsets = view_section<uint64_t>(image, size, offset, *entries + 1);
+            auto blob = offsets && offsets[*entries] <= size ? view_section<char>(image, size, offset, offsets[*entries]) : nullptr;
+            if (blob == nullptr) {
+                return false;
+            }
+            for (uint64_t e = 0; e < *entries; e++) {
+                if (offsets[e] > offsets[e + 1] || offsets[e + 1] > offsets[*entries]) {
+                    return false;
+                }
+                column.dictionary.emplace_back(blob + offsets[e], offsets[e + 1] - offsets[e]);
+                column.codes[column.dictionary.back()] = e;
+            }
+            // a code outside the dictionary would be read past it
+            for (size_t i = column.valid.next(0); i < *rows; i = column.valid.next(i + 1)) {
+                if (column.values[i] < 0 || static_cast<uint64_t>(column.values[i]) >= *entries) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+MetadataColumn* TextVectorStore::metadata_column(const std::string& name, MetadataColumn::Type type) {
+    auto found = columns_.find(name);
+    if (found == columns_.end()) {
+        found = columns_.emplace(name, MetadataColumn()).first;
+        found->second.type = type;
+    } else if (found->second.type != type) {
+        std::cerr << "Error: metadata column " << name << " has values of the other type" << std::endl;
+        return nullptr;
+    }
+    auto& column = found->second;
+    if (column.values.size() < vectors_.size()) {
+        column.values.resize(vectors_.size(), 0);
+        column.valid.resize(vectors_.size());
+    }
+    return &column;
+}
+
+void TextVectorStore::set_metadata(int64_t id, const std::string& column, int64_t value) {
+    std::lock_guard<std::mutex> write(write_mutex_);
+    auto lock = write_lock();
+    size_t i = row_of(id);
+    if (i == Bitset::npos) {
+        std::cerr << "Error: metadata of id " << id << " not in the store" << std::endl;
+        return;
+    }
+    auto values = metadata_column(column, MetadataColumn::INT);
+    if (values != nullptr) {
+        values->values[i] = value;
+        values->valid.set(i);
+    }
+}
+
+void TextVectorStore::set_metadata(int64_t id, const std::string& column, const std::string& value) {
+    std::lock_guard<std::mutex> write(write_mutex_);
+    auto lock = write_lock();
+    size_t i = row_of(id);
+    if (i == Bitset::npos) {
+        std::cerr << "Error: metadata of id " << id << " not in the store" << std::endl;
+        return;
+    }
+    auto values = metadata_column(column, MetadataColumn::STRING);
+    if (values == nullptr) {
+        return;
+    }
+    auto code = values->codes.find(value);
+    if (code == values->codes.end()) {
+        code = values->codes.emplace(value, static_cast<int64_t>(values->dictionary.size())).first;
+        values->dictionary.push_back(value);
+    }
+    values->values[i] = code->second;
+    values->valid.set(i);
+}
+
+Bitset TextVectorStore::evaluate(const Filter::Node& node) const {
+    if (node.op == Filter::AND || node.op == Filter::OR || node.op == Filter::NOT) {
+        Bitset rows = evaluate(*node.left);
+        if (node.op == Filter::AND) {
+            rows &= evaluate(*node.right);
+        } else if (node.op == Filter::OR) {
+            rows |= evaluate(*node.right);
+        } else {
+            rows.flip();
+        }
+        return rows;
+    }
+    Bitset rows(size());
+    auto found = columns_.find(node.column);
+    const auto type = node.op == Filter::IN_STRINGS ? MetadataColumn::STRING : MetadataColumn::INT;
+    if (found == columns_.end() || found->second.type != type) {
+        return rows;
+    }
+    const auto& column = found->second;
+    // strings are compared by their codes
+    std::vector<int64_t> codes;
+    const std::vector<int64_t>* values = &node.ints;
+    if (type == MetadataColumn::STRING) {
+        for (const auto& value : node.strings) {
+            auto code = column.codes.find(value);
+            if (code != column.codes.end()) {
+                codes.push_back(code->second);
+            }
+        }
+        std::sort(codes.begin(), codes.end());
+        values = &codes;
+    }
+    const size_t end = std::min(size(), column.values.size());
+    for (size_t i = column.valid.next(0); i < end; i = column.valid.next(i + 1)) {
+        const int64_t value = column.values[i];
+        bool kept = node.op == Filter::RANGE ? node.lo <= value && value <= node.hi
+                                             : std::binary_search(values->begin(), values->end(), value);
+        if (kept) {
+            rows.set(i);
+        }
+    }
+    return rows;
+}
+
+size_t TextVectorStore::live_size() const {
+    auto lock = read_lock();
+    return size() - deleted_;
+}
+
+std::string TextVectorStore::text(int64_t id) const {
+    auto lock = read_lock();
+    size_t row = row_of(id);
+    return row == Bitset::npos ? std::string() : std::string(row_text(row));
+}
+
+std::shared_lock<std::shared_mutex> TextVectorStore::read_lock() const {
+    {
+        // waits behind a writer holding the turnstile
+        std::lock_guard<std::mutex> turn(turnstile_);
+    }
+    return std::shared_lock<std::shared_mutex>(mutex_);
+}
+
+std::unique_lock<std::shared_mutex> TextVectorStore::write_lock() {
+    std::lock_guard<std::mutex> turn(turnstile_);
+    return std::unique_lock<std::shared_mutex>(mutex_);
+}
+
+size_t TextVectorStore::row_of(int64_t id) const {
+    if (ids_.empty()) {
+        return id >= 0 && live_.test(static_cast<size_t>(id)) ? static_cast<size_t>(id) : Bitset::npos;
+    }
+    auto found = rows_.find(id);
+    return found == rows_.end() ? Bitset::npos : found->second;
+}
+
+void TextVectorStore::materialize_ids() {
+    if (!ids_.empty() || size() == 0) {
+        return;
+    }
+    ids_.resize(size());
+    rows_.reserve(size() - deleted_);
+    for (size_t row = 0; row < size(); row++) {
+        ids_[row] = row;
+        if (live_.test(row)) {
+            rows_[row] = row;
+        }
+    }
+}
+
+std::string_view TextVectorStore::row_text(size_t i) const {
+    if (i >= mapped_texts_) {
+        return texts_[i - mapped_texts_];
+    }
+    const size_t j = mapped_rows_.empty() ? i : mapped_rows_[i];
+    uint64_t begin = text_offsets_[j], end = text_offsets_[j + 1];
+    if (begin > end || end > text_blob_size_) {
+        return std::string_view();
+    }
+    return std::string_view(text_blob_ + begin, end - begin);
+}
+
+void TextVectorStore::append(const float* vectors, const std::string* texts, size_t n, const int64_t* ids) {
+    if (vectors_.dim() != dim_) {
+        if (!vectors_.empty()) {
+            std::cerr << "Error: vector dim " << dim_ << " mismatch store dim " << vectors_.dim() << std::endl;
+            return;
+        }
+        vectors_.reset(dim_);
+    }
+    // rows keep the ids they are given, so the ids are no longer the rows
+    if (ids != nullptr) {
+        materialize_ids();
+    }
+    size_t begin = vectors_.size();
+    if (ids != nullptr || !ids_.empty()) {
+        ids_.reserve(begin + n);
+        for (size_t i = 0; i < n; i++) {
+            int64_t id = ids != nullptr ? ids[i] : next_id_++;
+            ids_.push_back(id);
+            rows_[id] = begin + i;
+        }
+    } else {
+        next_id_ += n;
+    }
+    live_.resize(begin + n, true);
+    vectors_.append(vectors, n);
+    if (metric_ == COSINE) {
+        for (size_t i = begin; i < vectors_.size(); i++) {
+            normalize(vectors_.row(i), vectors_.stride());
+        }
+    }
+    texts_.insert(texts_.end(), texts, texts + n);
+    if (index_ != nullptr) {
+        index_->add(*this, begin, vectors_.size());
+    }
+}
+
+void TextVectorStore::build_index(VectorIndex::Type type) {
+    std::lock_guard<std::mutex> write(write_mutex_);
+    auto lock = write_lock();
+    index_ = VectorIndex::create(type);
+    if (index_ != nullptr) {
+        index_->build(*this);
+    }
+}
+
+int64_t TextVectorStore::add_text(const std::string& text) {
+    auto ids = add_texts({text});
+    return ids.empty() ? -1 : ids[0];
+}
+
+std::vector<int64_t> TextVectorStore::add_texts(const std::vector<std::string>& texts) {
+    if (texts.empty()) {
+        return {};
+    }
+    // texts are tokenized as one batch and embedded before the store is locked
+    const int dim = embedding_->dim();
+    std::vector<float> vectors(texts.size() * dim);
+    auto embeddings = embedding_->embedding(texts);
+    for (size_t i = 0; i < texts.size(); i++) {
+        ::memcpy(vectors.data() + i * dim, embeddings[i]->readMap<float>(), dim * sizeof(float));
+    }
+    std::lock_guard<std::mutex> write(write_mutex_);
+    auto lock = write_lock();
+    if (!vectors_.empty() && vectors_.dim() != dim) {
+        std::cerr << "Error: embedding dim " << dim << " mismatch store dim " << vectors_.dim() << std::endl;
+        return {};
+    }
+    dim_ = dim;
+    const int64_t first = next_id_;
+    const size_t begin = vectors_.size();
+    vectors_.reserve(vectors_.size() + texts.size());
+    append(vectors.data(), texts.data(), texts.size());
+    if (vectors_.size() == begin) {
+        return {};
+    }
+    std::vector<int64_t> ids(texts.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        ids[i] = first + i;
+    }
+    return ids;
+}
+
+bool TextVectorStore::update_text(int64_t id, const std::string& text) {
+    const int dim = embedding_->dim();
+    auto vector = text2vector(text);
+    bool compact = false;
+    {
+        std::lock_guard<std::mutex> write(write_mutex_);
+        auto lock = write_lock();
+        const size_t row = row_of(id);
+        if (row == Bitset::npos || dim != dim_) {
+            return false;
+        }
+        // the new row takes the id and the metadata, the old one is deleted
+        append(vector->readMap<float>(), &text, 1, &id);
+        const size_t added = size() - 1;
+        for (auto& item : columns_) {
+            auto& column = item.second;
+            if (column.valid.test(row)) {
+                column.values.resize(size(), 0);
+                column.valid.resize(size());
+                column.values[added] = column.values[row];
+                column.valid.set(added);
+            }
+        }
+        live_.reset(row);
+        deleted_++;
+        compact = compact_ratio_ > 0 && deleted_ >= compact_ratio_ * size();
+    }
+    if (compact) {
+        request_compaction();
+    }
+    return true;
+}
+
+bool TextVectorStore::remove_text(int64_t id) {
+    bool compact = false;
+    {
+        std::lock_guard<std::mutex> write(write_mutex_);
+        auto lock = write_lock();
+        const size_t row = row_of(id);
+        if (row == Bitset::npos) {
+            return false;
+        }
+        // the row stays in the vectors and the index until a compaction, searches skip it
+        live_.reset(row);
+        rows_.erase(id);
+        deleted_++;
+        compact = compact_ratio_ > 0 && deleted_ >= compact_ratio_ * size();
+    }
+    if (compact) {
+        request_compaction();
+    }
+    return true;
+}
+
+void TextVectorStore::compact() {
+    std::lock_guard<std::mutex> write(write_mutex_);
+    if (deleted_ == 0) {
+        return;
+    }
+    // no writer runs until the swap, so the rows are read without locking out the readers
+    TextVectorStore compacted;
+    compacted.metric_ = metric_;
+    compacted.ivf_nlist_ = ivf_nlist_;
+    compacted.ivf_nprobe_ = ivf_nprobe_;
+    compacted.hnsw_m_ = hnsw_m_;
+    compacted.hnsw_ef_construction_ = hnsw_ef_construction_;
+    compacted.hnsw_ef_search_ = hnsw_ef_search_;
+    compacted.pq_m_ = pq_m_;
+    compacted.pq_opq_ = pq_opq_;
+    compacted.rerank_ = rerank_;
+    compacted.dim_ = dim_;
+    compacted.next_id_ = next_id_;
+    const size_t live = size() - deleted_;
+    compacted.vectors_.reset(vectors_.dim());
+    compacted.vectors_.reserve(live);
+    compacted.ids_.reserve(live);
+    compacted.rows_.reserve(live);
+    std::vector<size_t> kept;
+    kept.reserve(live);
+    for (size_t row = live_.next(0); row < size(); row = live_.next(row + 1)) {
+        // rows are already normalized, so they are copied rather than appended
+        compacted.vectors_.append(vectors_.row(row), 1);
+        // mapped texts stay in the file, the mapped rows kept are still the first ones
+        if (row < mapped_texts_) {
+            compacted.mapped_rows_.push_back(mapped_rows_.empty() ? row : mapped_rows_[row]);
+        } else {
+            compacted.texts_.emplace_back(row_text(row));
+        }
+        compacted.rows_[id_of(row)] = kept.size();
+        compacted.ids_.push_back(id_of(row));
+        kept.push_back(row);
+    }
+    compacted.live_.resize(kept.size(), true);
+    for (const auto& item : columns_) {
+        const auto& column = item.second;
+        auto& values = compacted.columns_[item.first];
+        values.type = column.type;
+        values.dictionary = column.dictionary;
+        values.codes = column.codes;
+        values.values.resize(kept.size(), 0);
+        values.valid.resize(kept.size());
+        for (size_t i = 0; i < kept.size(); i++) {
+            if (column.valid.test(kept[i])) {
+                values.values[i] = column.values[kept[i]];
+                values.valid.set(i);
+            }
+        }
+    }
+    if (index_ != nullptr) {
+        compacted.index_ = VectorIndex::create(index_->type());
+        compacted.index_->build(compacted);
+    }
+    auto lock = write_lock();
+    vectors_.swap(compacted.vectors_);
+    texts_.swap(compacted.texts_);
+    const size_t mapped = compacted.mapped_rows_.size();
+    if (mapped == mapped_texts_ && mapped_rows_.empty()) {
+        // every row of the file is kept in place
+        compacted.mapped_rows_.clear();
+    }
+    mapped_rows_.swap(compacted.mapped_rows_);
+    mapped_texts_ = mapped;
+    if (mapped == 0) {
+        // the mapped file and the old rows are released with `compacted`
+        mapped_.swap(compacted.mapped_);
+        text_offsets_ = nullptr;
+        text_blob_ = nullptr;
+        text_blob_size_ = 0;
+    }
+    columns_.swap(compacted.columns_);
+    ids_.swap(compacted.ids_);
+    rows_.swap(compacted.rows_);
+    std::swap(live_, compacted.live_);
+    deleted_ = 0;
+    index_.swap(compacted.index_);
+}
+
+void TextVectorStore::request_compaction() {
+    std::lock_guard<std::mutex> guard(compact_mutex_);
+    compact_pending_ = true;
+    if (!compactor_.joinable()) {
+        compactor_ = std::thread([this]() {
+            // loops of the rebuild run on this thread, so searches never queue behind them on the pool
+            ThreadPool::InlineScope scope;
+            std::unique_lock<std::mutex> lock(compact_mutex_);
+            while (true) {
+                compact_cv_.wait(lock, [this]() { return compact_pending_ || compact_stop_; });
+                if (compact_stop_) {
+                    return;
+                }
+                compact_pending_ = false;
+                lock.unlock();
+                compact();
+                lock.lock();
+            }
+        });
+    }
+    compact_cv_.notify_one();
+}
+
+TextVectorStore::~TextVectorStore() {
+    {
+        std::lock_guard<std::mutex> guard(compact_mutex_);
+        compact_stop_ = true;
+    }
+    compact_cv_.notify_one();
+    if (compactor_.joinable()) {
+        compactor_.join();
+    }
+}
+
+void TextVectorStore::prepare_query(const float* query, VectorMatrix& prepared, size_t n) const {
+    prepared.reset(dim_);
+    prepared.append(query, n);
+    if (metric_ == COSINE) {
+        for (size_t i = 0; i < n; i++) {
+            normalize(prepared.row(i), prepared.stride());
+        }
+    }
+}
+
+float TextVectorStore::distance(const float* query, const float* row) const {
+    if (metric_ == L2) {
+        return kernels().l2(query, row, vectors_.stride());
+    }
+    return -kernels().dot(query, row, vectors_.stride());
+}
+
+void TextVectorStore::scan(const float* query, size_t begin, size_t end, TopK& top, const Bitset* filter) const {
+    const auto& kernel = kernels();
+    const size_t stride = vectors_.stride();
+    if (filter != nullptr) {
+        for (size_t i = filter->next(begin); i < end; i = filter->next(i + 1)) {
+            top.push(i, distance(query, vectors_.row(i)));
+        }
+        return;
+    }
+    if (metric_ == L2) {
+        for (size_t i = begin; i < end; i++) {
+            top.push(i, kernel.l2(query, vectors_.row(i), stride));
+        }
+    } else {
+        for (size_t i = begin; i < end; i++) {
+            top.push(i, -kernel.dot(query, vectors_.row(i), stride));
+        }
+    }
+}
+
+const Bitset* TextVectorStore::compile_rows(const Filter& filter, Bitset& rows) const {
+    if (filter.empty()) {
+        return deleted_ == 0 ? nullptr : &live_;
+    }
+    rows = evaluate(*filter.node_);
+    if (deleted_ > 0) {
+        rows &= live_;
+    }
+    return &rows;
+}
+
+std::vector<VectorHit> TextVectorStore::search(const float* query, int topk, const SearchParams& params) const {
+    auto lock = read_lock();
+    auto hits = search_rows(query, topk, params);
+    for (auto& hit : hits) {
+        hit.id = id_of(hit.id);
+    }
+    return hits;
+}
+
+std::vector<VectorHit> TextVectorStore::search_rows(const float* query, int topk, const SearchParams& params) const {
+    // deleted rows are filtered out like the rows of a filter
+    Bitset rows;
+    const Bitset* filter = compile_rows(params.filter, rows);
+    VectorMatrix prepared;
+    prepare_query(query, prepared);
+    if (index_ != nullptr) {
+        TopK top(topk);
+        index_->search(*this, prepared.row(0), params, filter, top);
+        return top.sorted();
+    }
+    const size_t size = vectors_.size();
+    // every thread scans a slice into its own heap, small stores are scanned inline
+    const size_t min_slice = 4096;
+    size_t slices = std::min<size_t>(ThreadPool::shared().thread_num(), (size + min_slice - 1) / min_slice);
+    slices = std::max<size_t>(slices, 1);
+    std::vector<TopK> tops(slices, TopK(topk));
+    ThreadPool::shared().parallel_for(slices, [&](size_t i) {
+        scan(prepared.row(0), size * i / slices, size * (i + 1) / slices, tops[i], filter);
+    });
+    for (size_t i = 1; i < slices; i++) {
+        tops[0].merge(tops[i]);
+    }
+    return tops[0].sorted();
+}
+
+// queries and rows of a gemm block, and floats of a slab of their depth.
+// The queries of a slab stay in l1 while the rows of a slab stream from l2.
+static const size_t kQueryBlock = 32;
+static const size_t kRowBlock = 256;
+static const size_t kDepthBlock = 256;
+
+std::vector<std::vector<VectorHit>> TextVectorStore::search_batch(const float* queries, size_t count, int topk, const SearchParams& params) const {
+    auto lock = read_lock();
+    auto results = search_batch_rows(queries, count, topk, params);
+    for (auto& hits : results) {
+        for (auto& hit : hits) {
+            hit.id = id_of(hit.id);
+        }
+    }
+    return results;
+}
+
+std::vector<std::vector<VectorHit>> TextVectorStore::search_batch_rows(const float* queries, size_t count, int topk, const SearchParams& params) const {
+    Bitset rows;
+    const Bitset* filter = compile_rows(params.filter, rows);
+    VectorMatrix prepared;
+    prepare_query(queries, prepared, count);
+    std::vector<std::vector<VectorHit>> results(count);
+    if (index_ != nullptr) {
+        ThreadPool::shared().parallel_for(count, [&](size_t q) {
+            TopK top(topk);
+            index_->search(*this, prepared.row(q), params, filter, top);
+            results[q] = top.sorted();
+        });
+        return results;
+    }
+    const size_t size = vectors_.size();
+    const size_t stride = vectors_.stride();
+    if (size == 0 || count == 0) {
+        return results;
+    }
+    const auto& kernel = kernels();
+    const bool l2 = metric_ == L2;
+    // |q - x|^2 = |q|^2 + |x|^2 - 2 q.x, so a block is one gemm and the norms
+    std::vector<float> row_norms(l2 ? size : 0), query_norms(l2 ? count : 0);
+    if (l2) {
+        const size_t chunk = 4096;
+        ThreadPool::shared().parallel_for((size + chunk - 1) / chunk, [&](size_t c) {
+            for (size_t i = c * chunk; i < std::min(size, (c + 1) * chunk); i++) {
+                if (filter == nullptr || filter->test(i)) {
+                    row_norms[i] = kernel.dot(vectors_.row(i), vectors_.row(i), stride);
+                }
+            }
+        });
+        for (size_t q = 0; q < count; q++) {
+            query_norms[q] = kernel.dot(prepared.row(q), prepared.row(q), stride);
+        }
+    }
+    // few query blocks split the rows too, so every thread has a task
+    const size_t blocks = (count + kQueryBlock - 1) / kQueryBlock;
+    const size_t min_slice = 4096;
+    size_t slices = std::min<size_t>((ThreadPool::shared().thread_num() + blocks - 1) / blocks, (size + min_slice - 1) / min_slice);
+    slices = std::max<size_t>(slices, 1);
+    std::vector<TopK> tops(slices * count, TopK(topk));
+    ThreadPool::shared().parallel_for(blocks * slices, [&](size_t task) {
+        const size_t q0 = task / slices * kQueryBlock, slice = task % slices;
+        const size_t queries_n = std::min(kQueryBlock, count - q0);
+        const size_t begin = size * slice / slices, end = size * (slice + 1) / slices;
+        std::vector<float> dots(kQueryBlock * kRowBlock);
+        // rows of a block, the next ones kept by the filter
+        size_t ids[kRowBlock];
+        const float* a[kTile];
+        const float* b[kTile];
+        size_t r0 = filter ? filter->next(begin) : begin;
+        while (r0 < end) {
+            size_t rows = 0;
+            if (filter != nullptr) {
+                for (; rows < kRowBlock && r0 < end; r0 = filter->next(r0 + 1)) {
+                    ids[rows++] = r0;
+                }
+            } else {
+                for (; rows < kRowBlock && r0 < end; r0++) {
+                    ids[rows++] = r0;
+                }
+            }
+            std::fill(dots.begin(), dots.end(), 0.f);
+            for (size_t k0 = 0; k0 < stride; k0 += kDepthBlock) {
+                const size_t depth = std::min(kDepthBlock, stride - k0);
+                for (size_t j0 = 0; j0 < rows; j0 += kTile) {
+                    // a tile past the last query or row repeats it, and those products are not read
+                    for (size_t t = 0; t < kTile; t++) {
+                        b[t] = vectors_.row(ids[std::min(j0 + t, rows - 1)]) + k0;
+                    }
+                    for (size_t i0 = 0; i0 < queries_n; i0 += kTile) {
+                        for (size_t t = 0; t < kTile; t++) {
+                            a[t] = prepared.row(q0 + std::min(i0 + t, queries_n - 1)) + k0;
+                        }
+                        kernel.dot_tile(a, b, depth, dots.data() + i0 * kRowBlock + j0, kRowBlock);
+                    }
+                }
+            }
+            for (size_t i = 0; i < queries_n; i++) {
+                TopK& top = tops[slice * count + q0 + i];
+                const float* row_dots = dots.data() + i * kRowBlock;
+                if (l2) {
+                    for (size_t j = 0; j < rows; j++) {
+                        top.push(ids[j], std::max(query_norms[q0 + i] + row_norms[ids[j]] - 2.f * row_dots[j], 0.f));
+                    }
+                } else {
+                    for (size_t j = 0; j < rows; j++) {
+                        top.push(ids[j], -row_dots[j]);
+                    }
+                }
+            }
+        }
+    });
+    for (size_t q = 0; q < count; q++) {
+        for (size_t slice = 1; slice < slices; slice++) {
+            tops[q].merge(tops[slice * count + q]);
+        }
+        results[q] = tops[q].sorted();
+    }
+    return results;
+}
+
+std::vector<std::string> TextVectorStore::search_similar_texts(const std::string& txt, const Filter& filter, int topk) {
+    auto vector = text2vector(txt);
+    auto lock = read_lock();
+    SearchParams params;
+    params.filter = filter;
+    std::vector<std::string> res;
+    for (auto& hit : search_rows(vector->readMap<float>(), topk, params)) {
+        res.emplace_back(row_text(hit.id));
+    }
+    return res;
+}
+
+std::vector<std::vector<std::string>> TextVectorStore::search_similar_texts(const std::vector<std::string>& txts, int topk) {
+    const int dim = embedding_->dim();
+    std::vector<float> queries(txts.size() * dim);
+    auto embeddings = embedding_->embedding(txts);
+    for (size_t i = 0; i < txts.size(); i++) {
+        ::memcpy(queries.data() + i * dim, embeddings[i]->readMap<float>(), dim * sizeof(float));
+    }
+    std::vector<std::vector<std::string>> res(txts.size());
+    auto lock = read_lock();
+    auto hits = search_batch_rows(queries.data(), txts.size(), topk, SearchParams());
+    for (size_t i = 0; i < txts.size(); i++) {
+        for (auto& hit : hits[i]) {
+            res[i].emplace_back(row_text(hit.id));
+        }
+    }
+    return res;
+}
+
+std::vector<std::string> TextVectorStore::search_similar_texts(const std::string& txt, int topk) {
+    auto vector = text2vector(txt);
+    std::vector<std::string> res;
+    auto lock = read_lock();
+    for (auto& hit : search_rows(vector->readMap<float>(), topk, SearchParams())) {
+        res.emplace_back(row_text(hit.id));
+    }
+    return res;
+}
+
+void TextVectorStore::bench() {
+    const int n = 50000;
+    const int d = 1024;
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    std::vector<float> data(static_cast<size_t>(n) * d), query(d);
+    for (auto& v : data) {
+        v = uniform(rng);
+    }
+    for (auto& v : query) {
+        v = uniform(rng);
+    }
+    std::vector<std::string> texts(1);
+    TextVectorStore store;
+    store.dim_ = d;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < n; i++) {
+        store.append(data.data() + static_cast<size_t>(i) * d, texts.data(), 1);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    std::cout << "append took " << duration.count() << " milliseconds." << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    auto hits = store.search(query.data(), 5);
+    end = std::chrono::high_resolution_clock::now();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::cout << "search took " << us / 1000.f << " milliseconds, " << n * (d * sizeof(float)) / (us * 1e3f) << " GB/s." << std::endl;
+    for (auto& hit : hits) {
+        printf("index: %d, distance: %f\n", static_cast<int>(hit.id), std::sqrt(hit.distance));
+    }
+    const int batch = 64;
+    std::vector<float> queries(static_cast<size_t>(batch) * d);
+    for (auto& v : queries) {
+        v = uniform(rng);
+    }
+    start = std::chrono::high_resolution_clock::now();
+    store.search_batch(queries.data(), batch, 5);
+    end = std::chrono::high_resolution_clock::now();
+    us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::cout << "search batch of " << batch << " took " << us / 1000.f << " milliseconds, " << 2.f * n * d * batch / (us * 1e3f) << " GFLOP/s." << std::endl;
+    store.ivf_nlist_ = 256;
+    start = std::chrono::high_resolution_clock::now();
+    store.build_index(VectorIndex::IVF);
+    end = std::chrono::high_resolution_clock::now();
+    duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    std::cout << "ivf build took " << duration.count() << " milliseconds." << std::endl;
+    for (int nprobe : {1, 8, 32}) {
+        SearchParams params;
+        params.nprobe = nprobe;
+        start = std::chrono::high_resolution_clock::now();
+        auto ivf_hits = store.search(query.data(), 5, params);
+        end = std::chrono::high_resolution_clock::now();
+        us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        int recall = 0;
+        for (auto& hit : ivf_hits) {
+            recall += std::any_of(hits.begin(), hits.end(), [&](const VectorHit& h) { return h.id == hit.id; });
+        }
+        std::cout << "ivf nprobe " << nprobe << " search took " << us / 1000.f << " milliseconds, recall " << recall << "/5." << std::endl;
+    }
+    start = std::chrono::high_resolution_clock::now();
+    store.build_index(VectorIndex::HNSW);
+    end = std::chrono::high_resolution_clock::now();
+    duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    std::cout << "hnsw build took " << duration.count() << " milliseconds." << std::endl;
+    for (int ef : {16, 64, 256}) {
+        SearchParams params;
+        params.ef = ef;
+        start = std::chrono::high_resolution_clock::now();
+        auto hnsw_hits = store.search(query.data(), 5, params);
+        end = std::chrono::high_resolution_clock::now();
+        us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        int recall = 0;
+        for (auto& hit : hnsw_hits) {
+            recall += std::any_of(hits.begin(), hits.end(), [&](const VectorHit& h) { return h.id == hit.id; });
+        }
+        std::cout << "hnsw ef " << ef << " search took " << us / 1000.f << " milliseconds, recall " << recall << "/5." << std::endl;
+    }
+    for (auto type : {VectorIndex::PQ, VectorIndex::IVF_PQ}) {
+        const char* name = type == VectorIndex::PQ ? "pq" : "ivf-pq";
+        start = std::chrono::high_resolution_clock::now();
+        store.build_index(type);
+        end = std::chrono::high_resolution_clock::now();
+        duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        std::cout << name << " build took " << duration.count() << " milliseconds, " << d / 8 << " bytes per vector." << std::endl;
+        for (int rerank : {16, 64, 256}) {
+            SearchParams params;
+            params.rerank = rerank;
+            start = std::chrono::high_resolution_clock::now();
+            auto pq_hits = store.search(query.data(), 5, params);
+            end = std::chrono::high_resolution_clock::now();
+            us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            int recall = 0;
+            for (auto& hit : pq_hits) {
+                recall += std::any_of(hits.begin(), hits.end(), [&](const VectorHit& h) { return h.id == hit.id; });
+            }
+            std::cout << name << " rerank " << rerank << " search took " << us / 1000.f << " milliseconds, recall " << recall << "/5." << std::endl;
+        }
+    }
+    for (auto type : {VectorIndex::FP16, VectorIndex::SQ8, VectorIndex::BINARY}) {
+        const char* name = type == VectorIndex::FP16 ? "fp16" : (type == VectorIndex::SQ8 ? "sq8" : "binary");
+        start = std::chrono::high_resolution_clock::now();
+        store.build_index(type);
+        end = std::chrono::high_resolution_clock::now();
+        duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        std::cout << name << " build took " << duration.count() << " milliseconds." << std::endl;
+        for (int rerank : {5, 64, 256}) {
+            SearchParams params;
+            params.rerank = rerank;
+            start = std::chrono::high_resolution_clock::now();
+            auto scalar_hits = store.search(query.data(), 5, params);
+            end = std::chrono::high_resolution_clock::now();
+            us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            int recall = 0;
+            for (auto& hit : scalar_hits) {
+                recall += std::any_of(hits.begin(), hits.end(), [&](const VectorHit& h) { return h.id == hit.id; });
+            }
+            std::cout << name << " rerank " << rerank << " search took " << us / 1000.f << " milliseconds, recall " << recall << "/5." << std::endl;
+        }
+    }
+    store.compact_ratio_ = 0.f;
+    for (int i = 0; i < n; i += 10) {
+        store.remove_text(i);
+    }
+    start = std::chrono::high_resolution_clock::now();
+    store.compact();
+    end = std::chrono::high_resolution_clock::now();
+    duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    std::cout << "compact of " << n / 10 << " deleted rows took " << duration.count() << " milliseconds." << std::endl;
+}
+
+VARP TextVectorStore::text2vector(const std::string& text) {
+    auto vector = embedding_->embedding(text);
+    return vector;
+}
+
+// TextVectorStore end